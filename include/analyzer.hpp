@@ -0,0 +1,132 @@
+/*######################################################################################################
+# Experiment: General
+# Description: Streaming reordering metrics for captured probe bursts, RFC 4737 reorder ratio and
+#              extent and RFC 5236 reorder density, per burst and cumulative in constant memory
+# #####################################################################################################*/
+
+#pragma once
+
+#include <deque>
+#include <optional>
+#include <ostream>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "capture.hpp"
+#include "default.hpp"
+
+namespace Analyzer {
+    inline constexpr std::string_view LOG_TAG = "[Analyzer]";
+
+    // What one burst looked like on the sender: probe1, then `spoofed` packets with seq
+    // advancing by delta_seq, then probe2. Packets are told apart by source port, spoofed ones
+    // by their seq offset from the seq the sender gave slot 1 (arrival order if delta_seq is 0
+    // and they all look alike). That seq comes from Stream::expect(), else for out-of-connection
+    // bursts from attacker_seq or the lowest attacker seq of all bursts so far, else the lowest
+    // spoofed seq of the burst stands in for it.
+    struct BurstLayout {
+        uint16_t probe1_port = PacketBuilder::Defaults::probe_config(1).src_port;
+        uint16_t probe2_port = PacketBuilder::Defaults::probe_config(2).src_port;
+        uint16_t spoof_port = PacketBuilder::Defaults::spoof_config().src_port;        // in connection
+        uint16_t spoof_ports = 1;       // spoof_port onwards, one per connection spoofed into
+        uint16_t attacker_port = PacketBuilder::Defaults::probe_config().src_port;     // out of connection
+        size_t spoofed = 16;
+        uint32_t delta_seq = 3;
+        // Slot 1 seq of every out-of-connection burst if known, the attacker's seq never moves
+        std::optional<uint32_t> attacker_seq = std::nullopt;
+        // Bursts are sent milliseconds apart while reordering happens within microseconds:
+        // an arrival gap larger than this starts the next burst
+        uint64_t burst_gap_ns = 1000000;
+
+        size_t size() const { return spoofed + 2; }
+    };
+
+    struct BurstResult {
+        uint64_t index = 0;
+        uint64_t first_ns = 0;          // arrival of the first packet
+        size_t received = 0;            // distinct packets
+        size_t lost = 0;
+        size_t duplicates = 0;
+        size_t reordered = 0;           // RFC 4737 Type-P-Reordered
+        size_t max_extent = 0;          // RFC 4737 reordering extent, in packets
+        uint64_t extent_sum = 0;
+        size_t displaced = 0;           // RFC 5236 packets with non-zero displacement
+        bool probe2_before_probe1 = false;
+        size_t overtaken = 0;           // spoofed packets that arrived after probe2
+
+        double reorder_ratio() const { return received ? static_cast<double>(reordered) / received : 0; }
+    };
+
+    struct Totals {
+        uint64_t bursts = 0;
+        uint64_t received = 0;
+        uint64_t lost = 0;
+        uint64_t duplicates = 0;
+        uint64_t unmatched = 0;         // captured but not part of any burst layout
+        uint64_t reordered = 0;
+        uint64_t extent_sum = 0;
+        size_t max_extent = 0;
+        uint64_t probe2_before_probe1 = 0;
+        uint64_t probe2_overtook = 0;   // bursts where probe2 passed at least one spoofed packet
+        // RFC 5236 frequency of displacement d at [d + threshold], |d| <= threshold
+        std::vector<uint64_t> displacement;
+
+        double reorder_ratio() const { return received ? static_cast<double>(reordered) / received : 0; }
+        // Reorder density: displacement frequencies normalised to sum to 1
+        std::vector<double> density() const;
+    };
+
+    std::ostream& operator<<(std::ostream& os, const BurstResult& result);
+    std::ostream& operator<<(std::ostream& os, const Totals& totals);
+
+    // Consumes capture records in arrival order. Only the burst in flight is buffered
+    // (bounded by the layout), everything else is folded into Totals as bursts close.
+    class Stream {
+        public:
+            explicit Stream(const BurstLayout& p_layout = {}, size_t p_displacement_threshold = 8);
+
+            // Seq the sender put in slot 1 of its next burst, in send order. Bursts lost as a
+            // whole are skipped over by matching the spoofed seqs against these.
+            void expect(uint32_t p_first_seq);
+            // Returns the previous burst when p_record starts a new one
+            std::optional<BurstResult> add(const Capture::Record& p_record);
+            // Close the burst in flight, e.g. at the end of a capture
+            std::optional<BurstResult> flush();
+
+            const Totals& totals() const { return m_totals; }
+            const BurstLayout& layout() const { return m_layout; }
+
+        private:
+            struct Arrival {
+                uint8_t kind;           // 0 probe1, 1 spoofed, 2 probe2
+                uint32_t seq;
+                uint64_t timestamp_ns;
+            };
+
+            BurstResult close();
+            // Sent seq of slot 1 for the burst in m_arrivals, nullopt if unknown
+            std::optional<uint32_t> expected_base();
+            bool fits(uint32_t p_base) const;
+
+            // Bursts the sender may run ahead of the capture before the oldest hint is dropped
+            static constexpr size_t max_expected = 4096;
+
+            BurstLayout m_layout;
+            size_t m_threshold;
+            std::vector<Arrival> m_arrivals;        // capacity fixed at construction
+            // Scratch for close(), sized once
+            std::vector<size_t> m_order;            // send position of each distinct arrival
+            std::vector<size_t> m_rank;             // send position among the received ones
+            std::vector<uint8_t> m_seen;
+            bool m_has_probe1 = false;
+            bool m_attacker = false;                // out-of-connection spoofed packets in flight
+            std::deque<uint32_t> m_expected;        // from expect(), oldest first
+            // Lowest out-of-connection seq of all bursts so far, attacker_seq when that is unset
+            std::optional<uint32_t> m_attacker_base;
+            uint64_t m_last_ns = 0;
+            uint64_t m_next_index = 0;
+            Totals m_totals;
+    };
+
+} // namespace Analyzer
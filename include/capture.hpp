@@ -0,0 +1,144 @@
+/*######################################################################################################
+# Experiment: General
+# Description: In-process packet capture on a TPACKET_V3 memory-mapped ring with classic BPF filtering
+# #####################################################################################################*/
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <chrono>
+#include <cstdint>
+#include <linux/filter.h>
+#include <linux/if_packet.h>
+
+namespace Capture {
+    inline constexpr std::string_view LOG_TAG = "[Capture]";
+
+    // Compact per-packet record, parsed in place from the ring
+    struct Record {
+        uint64_t timestamp_ns;
+        uint32_t src_ip;        // network order
+        uint32_t dst_ip;        // network order
+        uint16_t src_port;
+        uint16_t dst_port;
+        uint32_t seq;
+        uint32_t ack;
+        uint16_t payload_len;
+        uint8_t flags;          // raw TCP flag byte (TH_FIN, TH_SYN, ...)
+        uint8_t outgoing;       // 1 if the packet was sent by this host
+    };
+
+    // IPv4/TCP match compiled to classic BPF for SOCK_DGRAM packet sockets
+    // (offsets start at the IP header). Unset fields match anything, symmetric
+    // also accepts packets with source and destination swapped (both halves of a flow).
+    struct Filter {
+        enum class Direction {
+            INCOMING,
+            OUTGOING,
+            BOTH
+        } direction = Direction::INCOMING;
+
+        std::optional<uint32_t> src_ip = std::nullopt;    // network order
+        std::optional<uint32_t> dst_ip = std::nullopt;    // network order
+        std::optional<uint16_t> src_port = std::nullopt;
+        std::optional<uint16_t> dst_port = std::nullopt;
+        bool symmetric = false;
+        uint8_t flags_mask = 0;
+        uint8_t flags_value = 0;
+        uint32_t snap_len = 0xFFFF;
+
+        std::vector<sock_filter> compile() const;
+    };
+
+    // Packet socket (SOCK_DGRAM) with p_filter attached before it is bound to the
+    // interface, so it never queues unfiltered packets. Empty p_iface binds to all.
+    int open_socket(const Filter& p_filter);
+    bool bind_socket(int p_fd, const std::string& p_iface);
+
+    // Parse an IPv4/TCP packet starting at its IP header
+    bool parse(const uint8_t* p_packet, size_t p_len, uint64_t p_timestamp_ns, Record& p_record);
+
+    struct RingConfig {
+        std::string iface;
+        Filter filter;
+        // 64 MiB of locked kernel memory per ring by default, callers capturing long
+        // line-rate bursts raise these explicitly
+        uint32_t block_size = 1U << 20;     // 1 MiB, multiple of the page size
+        uint32_t block_count = 64;
+        uint32_t frame_size = 2048;
+        uint32_t block_timeout_ms = 10;     // retire partially filled blocks after this long
+    };
+
+    struct Stats {
+        uint64_t packets = 0;
+        uint64_t drops = 0;
+        uint64_t freezes = 0;
+    };
+
+    class Ring {
+        public:
+            explicit Ring(const RingConfig& p_config);
+            ~Ring();
+            Ring(const Ring&) = delete;
+            Ring& operator=(const Ring&) = delete;
+
+            bool valid() const { return m_map != nullptr; }
+            int fd() const { return m_fd; }
+
+            // Hand every record of the retired blocks to p_handler, waiting up to p_timeout
+            // for the first one. Returns the number of records delivered.
+            template <typename Handler>
+            size_t poll(Handler&& p_handler, std::chrono::milliseconds p_timeout);
+
+            // Cumulative kernel counters (PACKET_STATISTICS)
+            Stats stats();
+
+        private:
+            tpacket_block_desc* next_block(std::chrono::milliseconds p_timeout);
+            void release_block(tpacket_block_desc* p_block);
+
+            int m_fd = -1;
+            uint8_t* m_map = nullptr;
+            size_t m_map_len = 0;
+            uint32_t m_block_size;
+            uint32_t m_block_count;
+            uint32_t m_block_index = 0;
+            Stats m_stats;
+    };
+
+    template <typename Handler>
+    size_t Ring::poll(Handler&& p_handler, std::chrono::milliseconds p_timeout) {
+        size_t delivered = 0;
+        tpacket_block_desc* block = next_block(p_timeout);
+
+        while (block) {
+            auto* hdr = reinterpret_cast<const tpacket3_hdr*>(
+                reinterpret_cast<const uint8_t*>(block) + block->hdr.bh1.offset_to_first_pkt);
+
+            for (uint32_t i = 0; i < block->hdr.bh1.num_pkts; i++) {
+                const uint8_t* packet = reinterpret_cast<const uint8_t*>(hdr) + hdr->tp_net;
+                const size_t len = hdr->tp_snaplen - (hdr->tp_net - hdr->tp_mac);
+                const uint64_t ts = static_cast<uint64_t>(hdr->tp_sec) * 1000000000ULL + hdr->tp_nsec;
+
+                Record record;
+                if (parse(packet, len, ts, record)) {
+                    const auto* ll = reinterpret_cast<const sockaddr_ll*>(
+                        reinterpret_cast<const uint8_t*>(hdr) + TPACKET_ALIGN(sizeof(tpacket3_hdr)));
+                    record.outgoing = ll->sll_pkttype == PACKET_OUTGOING;
+                    p_handler(record);
+                    delivered++;
+                }
+                hdr = reinterpret_cast<const tpacket3_hdr*>(
+                    reinterpret_cast<const uint8_t*>(hdr) + hdr->tp_next_offset);
+            }
+
+            release_block(block);
+            block = next_block(std::chrono::milliseconds(0));
+        }
+        return delivered;
+    }
+
+} // namespace Capture
@@ -0,0 +1,46 @@
+/*######################################################################################################
+# Experiment: General
+# Description: Internet checksum (RFC 1071) with 64-bit scalar, SSE2 and AVX2 kernels chosen at runtime
+# #####################################################################################################*/
+
+#pragma once
+
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+namespace Checksum {
+    inline constexpr std::string_view LOG_TAG = "[Checksum]";
+
+    // One's complement sum of p_data as big-endian 16-bit words (odd tail zero padded), added
+    // to p_initial and folded to 16 bits. Partial sums of even-length pieces combine by
+    // passing one as p_initial of the next, matching PacketBuilder::checksum_partial.
+    uint32_t partial(const void* p_data, size_t p_len, uint32_t p_initial = 0);
+
+    // Final checksum in host order: ~fold(p_sum)
+    inline uint16_t finish(uint32_t p_sum) {
+        p_sum = (p_sum >> 16) + (p_sum & 0xFFFF);
+        p_sum += p_sum >> 16;
+        return static_cast<uint16_t>(~p_sum);
+    }
+
+    inline uint16_t compute(const void* p_data, size_t p_len, uint32_t p_initial = 0) {
+        return finish(partial(p_data, p_len, p_initial));
+    }
+
+    // Individual kernels, exposed for benchmarks and equivalence checks. The SIMD ones
+    // must only be called when supported() says so.
+    enum class Kernel {
+        SCALAR,
+        SSE2,
+        AVX2
+    };
+
+    bool supported(Kernel p_kernel);
+    uint32_t partial(Kernel p_kernel, const void* p_data, size_t p_len, uint32_t p_initial = 0);
+
+    // Kernel picked via CPUID on first use
+    Kernel active();
+    std::string_view name(Kernel p_kernel);
+
+} // namespace Checksum
@@ -7,40 +7,83 @@
 
 #include <string>
 #include <cstdint>
-#include <mutex>
+#include <atomic>
+#include <memory>
 #include <ostream>
+#include <chrono>
 #include <thread>
-#include <cstdarg>
-#include <condition_variable>
+#include <utility>
 #include "default.hpp"
 
+namespace Capture {
+    class Ring;
+}
+
 namespace Connection {
     inline constexpr std::string_view LOG_TAG = "[Connection]";
 
+    // Sequence-space comparison (RFC 1982), true if p_a lies after p_b
+    inline bool seq_after(uint32_t p_a, uint32_t p_b) {
+        return static_cast<int32_t>(p_a - p_b) > 0;
+    }
+
+    inline uint32_t seq_max(uint32_t p_a, uint32_t p_b) {
+        return seq_after(p_a, p_b) ? p_a : p_b;
+    }
+
     struct State {
         private:
-            uint32_t m_seq;
-            uint32_t m_ack;
-            mutable std::mutex m_state_mutex;
+            // seq in the upper, ack in the lower half: one load yields a consistent pair
+            std::atomic<uint64_t> m_packed{0};
+            static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+            static constexpr uint64_t pack(uint32_t p_seq, uint32_t p_ack) {
+                return (static_cast<uint64_t>(p_seq) << 32) | p_ack;
+            }
+
+            template <typename Update>
+            void update(Update&& p_update) {
+                uint64_t current = m_packed.load(std::memory_order_relaxed);
+                uint64_t next;
+                do {
+                    next = p_update(current);
+                    if (next == current) return;
+                } while (!m_packed.compare_exchange_weak(current, next, std::memory_order_release,
+                                                         std::memory_order_relaxed));
+            }
 
         public:
-            uint32_t seq() const {
-                std::lock_guard<std::mutex> lock(m_state_mutex);
-                return m_seq;
+            std::pair<uint32_t, uint32_t> load() const {
+                const uint64_t packed = m_packed.load(std::memory_order_acquire);
+                return { static_cast<uint32_t>(packed >> 32), static_cast<uint32_t>(packed) };
             }
-            
-            uint32_t ack() const {
-                std::lock_guard<std::mutex> lock(m_state_mutex);
-                return m_ack;
+
+            uint32_t seq() const { return load().first; }
+            uint32_t ack() const { return load().second; }
+
+            void store(uint32_t p_seq, uint32_t p_ack) {
+                m_packed.store(pack(p_seq, p_ack), std::memory_order_release);
             }
+
             void set_seq(uint32_t s) {
-                std::lock_guard<std::mutex> lock(m_state_mutex);
-                m_seq = s;
+                update([s](uint64_t p_packed) { return pack(s, static_cast<uint32_t>(p_packed)); });
             }
-            
+
             void set_ack(uint32_t a) {
-                std::lock_guard<std::mutex> lock(m_state_mutex);
-                m_ack = a;
+                update([a](uint64_t p_packed) { return pack(static_cast<uint32_t>(p_packed >> 32), a); });
+            }
+
+            // Move seq/ack forward in sequence space, older values are ignored
+            void advance_seq(uint32_t s) {
+                update([s](uint64_t p_packed) {
+                    return pack(seq_max(static_cast<uint32_t>(p_packed >> 32), s), static_cast<uint32_t>(p_packed));
+                });
+            }
+
+            void advance_ack(uint32_t a) {
+                update([a](uint64_t p_packed) {
+                    return pack(static_cast<uint32_t>(p_packed >> 32), seq_max(static_cast<uint32_t>(p_packed), a));
+                });
             }
 
             enum class Type {
@@ -48,14 +91,15 @@ namespace Connection {
                 DISCONNECTED
             } type;
 
-            State() : m_seq(0), m_ack(0), type(Type::DISCONNECTED) {}
+            State() : type(Type::DISCONNECTED) {}
             State(const State&) = delete;
             State& operator=(const State&) = delete;
 
 
             friend std::ostream& operator<<(std::ostream& os, const State& state) {
+                auto [seq, ack] = state.load();
                 os << (state.type == State::Type::CONNECTED ? "CONNECTED" : "DISCONNECTED")
-                << ", SEQ: " << state.seq() << ", ACK: " << state.ack();
+                << ", SEQ: " << seq << ", ACK: " << ack;
                 return os;
             }
     };
@@ -63,11 +107,15 @@ namespace Connection {
     class TCPClient {
         private:
             bool init_socket();
-            void sniff_syn_ack();
-            std::jthread m_sniff_thread;
-            mutable std::mutex m_sniff_mutex;
-            mutable std::condition_variable m_sniff_cv;
-            bool m_sniff_done = false;
+            bool arm_sniffer();
+            bool sniff_syn_ack(std::chrono::milliseconds p_timeout);
+            void disarm_sniffer();
+            int m_sniff_fd = -1;
+
+            void track();
+            std::unique_ptr<Capture::Ring> m_tracker_ring;
+            std::thread m_tracker;
+            std::atomic<bool> m_tracking{false};
 
             std::string m_src_ip, m_dst_ip;
             uint16_t m_src_port, m_dst_port;
@@ -86,10 +134,18 @@ namespace Connection {
                 return extended_connect(Defaults::server_ip.data(), Defaults::dst_port);
             }
             void disconnect();
+
+            // Follow our own connection on the wire in a background thread and keep the
+            // server state current: seq from outgoing segments and incoming ACKs, ack from
+            // incoming segments. Readers never block the tracker or each other.
+            bool start_tracking();
+            void stop_tracking();
+
             friend std::ostream& operator<<(std::ostream& os, const TCPClient& conn);
 
+            // Single atomic load, safe to call from the hot path while tracking
             std::pair<uint32_t, uint32_t> server_state() const {
-                return std::make_pair(m_server_state.seq(), m_server_state.ack());
+                return m_server_state.load();
             }
     };
 
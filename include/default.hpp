@@ -27,6 +27,9 @@ namespace MultiQAttacker::Defaults {
     inline constexpr uint16_t queue0_port = 65011;
     inline constexpr uint16_t queue1_port = 65030;
     inline constexpr uint16_t queue1_port2 = 65040;
+
+    // Source port steering traffic to rx queue i
+    inline constexpr std::array<uint16_t, 2> queue_ports = { queue0_port, queue1_port };
 }
 
 namespace PacketBuilder::Defaults {
@@ -35,10 +38,10 @@ namespace PacketBuilder::Defaults {
     inline constexpr uint32_t base_seq = 1000;
     inline constexpr uint32_t base_ack = 5000;
 
-    inline Config probe_config(int id = 0) {
+    inline constexpr Config probe_config(int id = 0) {
         return Config{
-            .src_ip = std::string(SingleQAttacker::Defaults::attacker_ip),
-            .dst_ip = std::string(Connection::Defaults::server_ip),
+            .src_ip = ipv4(SingleQAttacker::Defaults::attacker_ip),
+            .dst_ip = ipv4(Connection::Defaults::server_ip),
             .src_port = [&id]{
                 switch (id) {
                     case 1: return SingleQAttacker::Defaults::probe1_port;
@@ -55,9 +58,9 @@ namespace PacketBuilder::Defaults {
         };
     }
 
-    inline Config spoof_config() {
+    inline constexpr Config spoof_config() {
         Config cfg = probe_config();
-        cfg.src_ip = std::string(Connection::Defaults::client_ip);
+        cfg.src_ip = ipv4(Connection::Defaults::client_ip);
         cfg.src_port = Connection::Defaults::client_port;
         cfg.syn = false;
         cfg.ack_flag = true;
@@ -65,4 +68,8 @@ namespace PacketBuilder::Defaults {
         cfg.payload = "";
         return cfg;
     }
+
+    // Probes never change during a run, their frames are built by the compiler
+    template <int Id>
+    inline constexpr StaticPacket<probe_config(Id).flags()> probe_packet{ probe_config(Id).fields() };
 }
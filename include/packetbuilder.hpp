@@ -5,16 +5,21 @@
 
 #pragma once
 
+#include <array>
+#include <span>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <cstdint>
 #include <sys/socket.h>
+#include <netinet/in.h>
+#include "packetlayout.hpp"
 
 namespace PacketBuilder {
 
     struct Config {
-        std::string src_ip;
-        std::string dst_ip;
+        Ipv4Address src_ip;
+        Ipv4Address dst_ip;
         uint16_t src_port;
         uint16_t dst_port;
         uint32_t seq = 0;
@@ -29,9 +34,20 @@ namespace PacketBuilder {
         uint16_t window = 65535;
 
         // Optional payload
-        std::string payload = "";
+        std::string payload{};
+
+        constexpr uint8_t flags() const {
+            return (syn ? TcpFlags::SYN : 0) | (ack_flag ? TcpFlags::ACK : 0) |
+                   (rst ? TcpFlags::RST : 0) | (psh ? TcpFlags::PSH : 0);
+        }
+
+        constexpr Fields fields() const {
+            return Fields{ src_ip, dst_ip, src_port, dst_port, seq, ack, window };
+        }
     };
 
+    using MacAddress = std::array<uint8_t, 6>;
+
     struct PacketBatch {
         std::vector<char> probe1;
         std::vector<std::vector<char>> spoofed;
@@ -43,6 +59,115 @@ namespace PacketBuilder {
         static mmsghdr make_msg(iovec& iov);
     };
 
+    // Pre-rendered IPv4/TCP packet whose header fields can be patched in place.
+    // The packet is built once via build_packet; every setter rewrites the affected
+    // 16-bit words and updates the IP/TCP checksums incrementally (RFC 1624), so
+    // producing the next packet of a batch costs a handful of stores.
+    class PacketTemplate {
+        public:
+            explicit PacketTemplate(const Config& p_config);
+            // Ethernet framed variant, patching works the same on the embedded IP packet
+            PacketTemplate(const Config& p_config, const MacAddress& p_src_mac, const MacAddress& p_dst_mac);
+
+            bool valid() const { return !m_packet.empty(); }
+            size_t size() const { return m_packet.size(); }
+            const char* data() const { return m_packet.data(); }
+
+            uint32_t seq() const;
+            void set_seq(uint32_t p_seq);
+            void set_ack(uint32_t p_ack);
+            void set_src_port(uint16_t p_port);
+            void set_dst_port(uint16_t p_port);
+            void set_flags(bool p_syn, bool p_ack, bool p_rst, bool p_psh);
+            void set_window(uint16_t p_window);
+            void set_ip_id(uint16_t p_id);
+
+            // Copy the current packet to p_dst (at least size() bytes), returns bytes written
+            size_t render(char* p_dst) const;
+            std::vector<char> packet() const { return m_packet; }
+
+        private:
+            char* l3() { return m_packet.data() + m_l3_offset; }
+            const char* l3() const { return m_packet.data() + m_l3_offset; }
+            void patch_ip(size_t p_offset, uint16_t p_word);
+            void patch_tcp(size_t p_offset, uint16_t p_word);
+            void patch_tcp32(size_t p_offset, uint32_t p_dword);
+
+            std::vector<char> m_packet;
+            size_t m_l3_offset = 0;
+    };
+
+    // Fixed-stride packet slots in one cache-line aligned (optionally hugepage backed)
+    // slab. The iovec/mmsghdr arrays are built once at construction and keep pointing
+    // at the slots, so refilling a batch only rewrites packet bytes and lengths.
+    class BatchSlab {
+        public:
+            static constexpr size_t cache_line = 64;
+            static constexpr size_t default_stride = 1600; // IP + TCP + 1500 B payload, rounded to cache lines
+
+            BatchSlab(size_t p_slots, size_t p_stride = default_stride, bool p_hugepages = false);
+            ~BatchSlab();
+            BatchSlab(const BatchSlab&) = delete;
+            BatchSlab& operator=(const BatchSlab&) = delete;
+
+            bool valid() const { return m_slab != nullptr; }
+            bool hugepages() const { return m_hugepages; }
+            size_t capacity() const { return m_iovecs.size(); }
+            size_t stride() const { return m_stride; }
+
+            // Number of slots handed to sendmmsg, defaults to capacity()
+            size_t size() const { return m_size; }
+            void resize(size_t p_size);
+
+            char* slot(size_t p_index) { return m_slab + p_index * m_stride; }
+            const char* slot(size_t p_index) const { return m_slab + p_index * m_stride; }
+            size_t length(size_t p_index) const { return m_iovecs[p_index].iov_len; }
+            // Writes through slot() end with set_length(), which marks the slot as changed
+            void set_length(size_t p_index, size_t p_length) {
+                m_iovecs[p_index].iov_len = p_length;
+                m_versions[p_index]++;
+            }
+
+            // Unique per slab for the life of the process, and a per-slot counter bumped on every
+            // rewrite: backends keeping their own copy of a slot skip it while both still match
+            uint64_t id() const { return m_id; }
+            uint32_t version(size_t p_index) const { return m_versions[p_index]; }
+
+            // Copy a packet into a slot, returns bytes written (0 if it does not fit)
+            size_t put(size_t p_index, const PacketTemplate& p_tmpl);
+            size_t put(size_t p_index, std::span<const char> p_packet);
+
+            // Fill p_count consecutive slots from p_tmpl with seq advancing by p_delta_seq
+            void put_sequence(size_t p_first, PacketTemplate& p_tmpl, uint32_t p_seq,
+                              uint32_t p_delta_seq, size_t p_count);
+
+            void set_destination(const sockaddr_in& p_addr);
+
+            // Attach an SCM_TXTIME control message to every slot, the socket needs SO_TXTIME.
+            // Launch times are absolute, in the clock the socket was set up with.
+            void enable_txtime();
+            bool txtime() const { return !m_control.empty(); }
+            void set_txtime(size_t p_index, uint64_t p_time_ns);
+
+            mmsghdr* msgs() { return m_msgs.data(); }
+
+        private:
+            char* m_slab = nullptr;
+            size_t m_slab_bytes = 0;
+            size_t m_stride;
+            size_t m_size;
+            bool m_hugepages = false;
+            sockaddr_in m_dest{};
+            std::vector<iovec> m_iovecs;
+            std::vector<mmsghdr> m_msgs;
+            std::vector<uint64_t> m_control;    // one cmsg per slot, uint64_t keeps cmsghdr alignment
+            uint64_t m_id;
+            std::vector<uint32_t> m_versions;
+    };
+
     std::vector<char> build_packet(const Config& config);
+    // Ethernet II (IPv4) header and full L2 frame for packet-socket based senders
+    std::array<char, 14> build_ethernet_header(const MacAddress& src_mac, const MacAddress& dst_mac);
+    std::vector<char> build_frame(const Config& config, const MacAddress& src_mac, const MacAddress& dst_mac);
     std::vector<std::vector<char>> build_packet_batch(const Config& base_config, size_t packet_count);
 }
@@ -0,0 +1,196 @@
+/*######################################################################################################
+# Experiment: General
+# Description: Compile-time IPv4/TCP packet layouts, pre-parsed addresses and constexpr checksums
+# #####################################################################################################*/
+
+#pragma once
+
+#include <array>
+#include <bit>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+namespace PacketBuilder {
+
+    // IPv4 address parsed once, kept in host order
+    struct Ipv4Address {
+        uint32_t value = 0;
+
+        // Byte order of in_addr::s_addr / iphdr::saddr
+        constexpr uint32_t network() const {
+            if constexpr (std::endian::native == std::endian::little) {
+                return __builtin_bswap32(value);
+            } else {
+                return value;
+            }
+        }
+
+        constexpr bool operator==(const Ipv4Address&) const = default;
+    };
+
+    // Dotted quad to address, nullopt for anything inet_pton(AF_INET) would reject
+    constexpr std::optional<Ipv4Address> parse_ipv4(std::string_view p_text) {
+        uint32_t value = 0;
+        size_t octets = 0;
+        size_t i = 0;
+        while (octets < 4) {
+            if (i >= p_text.size() || p_text[i] < '0' || p_text[i] > '9') return std::nullopt;
+            uint32_t octet = 0;
+            const size_t start = i;
+            while (i < p_text.size() && p_text[i] >= '0' && p_text[i] <= '9') {
+                octet = octet * 10 + static_cast<uint32_t>(p_text[i] - '0');
+                if (i - start >= 3 || octet > 255) return std::nullopt;
+                i++;
+            }
+            if (i - start > 1 && p_text[start] == '0') return std::nullopt;
+            value = (value << 8) | octet;
+            if (++octets < 4) {
+                if (i >= p_text.size() || p_text[i] != '.') return std::nullopt;
+                i++;
+            }
+        }
+        if (i != p_text.size()) return std::nullopt;
+        return Ipv4Address{ value };
+    }
+
+    // Literal address, a malformed one fails to compile
+    consteval Ipv4Address ipv4(std::string_view p_text) {
+        return parse_ipv4(p_text).value();
+    }
+
+    namespace TcpFlags {
+        inline constexpr uint8_t FIN = 0x01;
+        inline constexpr uint8_t SYN = 0x02;
+        inline constexpr uint8_t RST = 0x04;
+        inline constexpr uint8_t PSH = 0x08;
+        inline constexpr uint8_t ACK = 0x10;
+    }
+
+    // One's complement sum over big-endian 16-bit words, an odd trailing byte is zero padded
+    constexpr uint32_t checksum_partial(std::span<const char> p_data, uint32_t p_sum = 0) {
+        size_t i = 0;
+        for (; i + 1 < p_data.size(); i += 2) {
+            p_sum += (static_cast<uint32_t>(static_cast<uint8_t>(p_data[i])) << 8) |
+                     static_cast<uint8_t>(p_data[i + 1]);
+        }
+        if (i < p_data.size()) {
+            p_sum += static_cast<uint32_t>(static_cast<uint8_t>(p_data[i])) << 8;
+        }
+        return p_sum;
+    }
+
+    constexpr uint16_t checksum_fold(uint32_t p_sum) {
+        p_sum = (p_sum >> 16) + (p_sum & 0xFFFF);
+        p_sum += p_sum >> 16;
+        return static_cast<uint16_t>(~p_sum);
+    }
+
+    // Header fields of one packet, ports/seq/ack in host order
+    struct Fields {
+        Ipv4Address src_ip;
+        Ipv4Address dst_ip;
+        uint16_t src_port = 0;
+        uint16_t dst_port = 0;
+        uint32_t seq = 0;
+        uint32_t ack = 0;
+        uint16_t window = 65535;
+    };
+
+    // IPv4/TCP packet whose flags and payload length are part of the type. The frame is
+    // a fixed-size array laid out at fixed offsets, so construction and the seq/ack
+    // setters compile to straight-line stores and can run at compile time.
+    template <uint8_t Flags, size_t PayloadLen = 0>
+    class StaticPacket {
+        public:
+            static constexpr size_t ip_header = 20;
+            static constexpr size_t tcp_header = 20;
+            static constexpr size_t size = ip_header + tcp_header + PayloadLen;
+            static_assert(PayloadLen <= 1500, "Payload too large for typical MTU");
+
+            constexpr explicit StaticPacket(const Fields& p_fields) requires (PayloadLen == 0) {
+                build(p_fields, {});
+            }
+
+            // The payload is a string literal of exactly PayloadLen characters, any other length
+            // does not compile instead of being cut off or zero padded
+            constexpr StaticPacket(const Fields& p_fields, const char (&p_payload)[PayloadLen + 1]) {
+                build(p_fields, std::string_view(p_payload, PayloadLen));
+            }
+
+            constexpr std::span<const char, size> view() const { return m_frame; }
+            constexpr const char* data() const { return m_frame.data(); }
+            constexpr const std::array<char, size>& frame() const { return m_frame; }
+
+            constexpr uint32_t seq() const { return get32(tcp + 4); }
+
+            // RFC 1624 incremental update of the TCP checksum, no branches on the values
+            constexpr void set_seq(uint32_t p_seq) { patch32(tcp + 4, p_seq); }
+            constexpr void set_ack(uint32_t p_ack) { patch32(tcp + 8, p_ack); }
+
+        private:
+            static constexpr size_t tcp = ip_header;
+
+            constexpr void build(const Fields& p_fields, std::string_view p_payload) {
+                put16(2, static_cast<uint16_t>(size));
+                m_frame[0] = 0x45;                                 // version 4, ihl 5
+                m_frame[8] = 64;                                   // ttl
+                m_frame[9] = 6;                                    // IPPROTO_TCP
+                put32(12, p_fields.src_ip.value);
+                put32(16, p_fields.dst_ip.value);
+                put16(10, checksum_fold(checksum_partial(std::span<const char>(m_frame).first(ip_header))));
+
+                put16(tcp + 0, p_fields.src_port);
+                put16(tcp + 2, p_fields.dst_port);
+                put32(tcp + 4, p_fields.seq);
+                put32(tcp + 8, p_fields.ack);
+                m_frame[tcp + 12] = 0x50;                          // doff 5
+                m_frame[tcp + 13] = static_cast<char>(Flags);
+                put16(tcp + 14, p_fields.window);
+                for (size_t i = 0; i < PayloadLen; i++) {
+                    m_frame[ip_header + tcp_header + i] = p_payload[i];
+                }
+
+                // Pseudo header: addresses, protocol and TCP length
+                uint32_t sum = (p_fields.src_ip.value >> 16) + (p_fields.src_ip.value & 0xFFFF) +
+                               (p_fields.dst_ip.value >> 16) + (p_fields.dst_ip.value & 0xFFFF) +
+                               6 + tcp_header + PayloadLen;
+                sum = checksum_partial(std::span<const char>(m_frame).subspan(tcp), sum);
+                put16(tcp + 16, checksum_fold(sum));
+            }
+
+            constexpr void put16(size_t p_offset, uint16_t p_value) {
+                m_frame[p_offset] = static_cast<char>(p_value >> 8);
+                m_frame[p_offset + 1] = static_cast<char>(p_value);
+            }
+
+            constexpr void put32(size_t p_offset, uint32_t p_value) {
+                put16(p_offset, static_cast<uint16_t>(p_value >> 16));
+                put16(p_offset + 2, static_cast<uint16_t>(p_value));
+            }
+
+            constexpr uint16_t get16(size_t p_offset) const {
+                return static_cast<uint16_t>((static_cast<uint8_t>(m_frame[p_offset]) << 8) |
+                                             static_cast<uint8_t>(m_frame[p_offset + 1]));
+            }
+
+            constexpr uint32_t get32(size_t p_offset) const {
+                return (static_cast<uint32_t>(get16(p_offset)) << 16) | get16(p_offset + 2);
+            }
+
+            // HC' = ~(~HC + ~m + m') over both 16-bit halves
+            constexpr void patch32(size_t p_offset, uint32_t p_value) {
+                const uint32_t old_value = get32(p_offset);
+                const uint32_t sum = static_cast<uint16_t>(~get16(tcp + 16)) +
+                                     static_cast<uint16_t>(~(old_value >> 16)) + static_cast<uint16_t>(~old_value) +
+                                     (p_value >> 16) + (p_value & 0xFFFF);
+                put32(p_offset, p_value);
+                put16(tcp + 16, checksum_fold(sum));
+            }
+
+            std::array<char, size> m_frame{};
+    };
+
+} // namespace PacketBuilder
@@ -0,0 +1,97 @@
+/*######################################################################################################
+# Experiment: General
+# Description: Memory-mapped pcapng writer for rendering generated batches to a file instead of the wire,
+#              and a zero-copy pcap/pcapng reader for replaying them
+# #####################################################################################################*/
+
+#pragma once
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "packetbuilder.hpp"
+
+namespace Pcap {
+    inline constexpr std::string_view LOG_TAG = "[Pcap]";
+
+    // Link types (https://www.tcpdump.org/linktypes.html)
+    inline constexpr uint16_t LINKTYPE_ETHERNET = 1;
+    inline constexpr uint16_t LINKTYPE_RAW = 101;      // bare IPv4/IPv6 packets, what the generators build
+    inline constexpr uint16_t LINKTYPE_LINUX_SLL = 113;
+    inline constexpr uint16_t LINKTYPE_IPV4 = 228;
+
+    // pcapng file with one section and one interface (nanosecond timestamps), written
+    // through a shared mapping that grows by doubling. Enhanced Packet Blocks are laid
+    // down with plain stores, the file is truncated to its real length on close().
+    class Writer {
+        public:
+            explicit Writer(const std::string& p_path, uint16_t p_linktype = LINKTYPE_RAW,
+                            size_t p_initial_bytes = 64UL << 20);
+            ~Writer();
+            Writer(const Writer&) = delete;
+            Writer& operator=(const Writer&) = delete;
+
+            bool valid() const { return m_map != nullptr; }
+            uint64_t packets() const { return m_packets; }
+            size_t bytes() const { return m_offset; }
+
+            // One packet stamped p_timestamp_ns (CLOCK_REALTIME ns)
+            bool write(uint64_t p_timestamp_ns, std::span<const char> p_packet);
+
+            // Batch in send order (probe1, spoofed..., probe2), packet i stamped
+            // p_timestamp_ns + i * p_gap_ns. Returns packets written.
+            size_t write(const PacketBuilder::PacketBatch& p_batch, uint64_t p_timestamp_ns, uint64_t p_gap_ns = 0);
+            size_t write(const PacketBuilder::BatchSlab& p_batch, uint64_t p_timestamp_ns, uint64_t p_gap_ns = 0);
+
+            // Unmap and cut the file to the bytes written, false if anything failed
+            bool close();
+
+        private:
+            bool reserve(size_t p_bytes);
+            void put_header(uint16_t p_linktype);
+
+            std::string m_path;
+            int m_fd = -1;
+            char* m_map = nullptr;
+            size_t m_capacity = 0;
+            size_t m_offset = 0;
+            uint64_t m_packets = 0;
+    };
+
+    // IPv4 packet inside a Reader's mapping, link-layer header already stripped
+    struct Frame {
+        uint64_t timestamp_ns;
+        std::span<const char> packet;
+    };
+
+    // Maps a classic pcap (either byte order, us or ns) or pcapng file read-only and
+    // indexes its IPv4 packets in file order. Frames point into the mapping and stay
+    // valid for the Reader's lifetime. Truncated and non-IPv4 frames are skipped.
+    class Reader {
+        public:
+            explicit Reader(const std::string& p_path);
+            ~Reader();
+            Reader(const Reader&) = delete;
+            Reader& operator=(const Reader&) = delete;
+
+            bool valid() const { return m_map != nullptr; }
+            const std::vector<Frame>& frames() const { return m_frames; }
+            size_t skipped() const { return m_skipped; }
+            size_t file_bytes() const { return m_size; }
+
+        private:
+            bool parse_pcap();
+            bool parse_pcapng();
+            void add(uint16_t p_linktype, uint64_t p_timestamp_ns, const char* p_data,
+                     uint32_t p_captured, uint32_t p_original);
+
+            const char* m_map = nullptr;
+            size_t m_size = 0;
+            std::vector<Frame> m_frames;
+            size_t m_skipped = 0;
+    };
+
+} // namespace Pcap
@@ -0,0 +1,132 @@
+/*######################################################################################################
+# Experiment: Single Queue
+# Description: Ahead-of-time experiment plans: every batch of a run, its scenario drawn from a seeded
+#              xoshiro256** generator, rendered into one file that the send loop maps and walks
+# #####################################################################################################*/
+
+#pragma once
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "packetbuilder.hpp"
+
+namespace Plan {
+    inline constexpr std::string_view LOG_TAG = "[Plan]";
+
+    // xoshiro256** (Blackman/Vigna), state seeded from splitmix64 so any 64-bit seed works.
+    // Fixed algorithm, unlike std::rand or the std distributions, so a seed means the same
+    // sequence with every compiler and library.
+    class Xoshiro256 {
+        public:
+            explicit Xoshiro256(uint64_t p_seed) {
+                for (auto& word : m_state) {
+                    p_seed += 0x9e3779b97f4a7c15ULL;
+                    uint64_t z = p_seed;
+                    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+                    word = z ^ (z >> 31);
+                }
+            }
+
+            uint64_t next() {
+                const uint64_t result = rotl(m_state[1] * 5, 7) * 9;
+                const uint64_t t = m_state[1] << 17;
+                m_state[2] ^= m_state[0];
+                m_state[3] ^= m_state[1];
+                m_state[1] ^= m_state[2];
+                m_state[0] ^= m_state[3];
+                m_state[2] ^= t;
+                m_state[3] = rotl(m_state[3], 45);
+                return result;
+            }
+
+            // Uniform in [0, 1) from the top 53 bits
+            double uniform() { return static_cast<double>(next() >> 11) * 0x1.0p-53; }
+            bool bernoulli(double p_probability) { return uniform() < p_probability; }
+
+        private:
+            static uint64_t rotl(uint64_t p_x, int p_k) { return (p_x << p_k) | (p_x >> (64 - p_k)); }
+
+            uint64_t m_state[4];
+    };
+
+    // Single queue run: [probe1 | seq_length spoofed | probe2] per batch, the spoofed packets
+    // in the connection (spoof, seq advancing) or out of it (non_spoof, seq fixed)
+    struct Spec {
+        uint64_t seed = 1;
+        size_t iterations = 1000;
+        size_t seq_length = 16;
+        double in_connection_ratio = 0.5;
+        double batch_rate = 100.0;              // batches per second
+        PacketBuilder::Config spoof;
+        PacketBuilder::Config non_spoof;
+        std::span<const char> probe1;
+        std::span<const char> probe2;
+    };
+
+    // On-disk layout, host byte order, all sections 64-byte aligned:
+    //   Header | Batch[iterations] | uint16_t length[frames] | frames at a fixed stride
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t stride;
+        uint64_t seed;
+        uint64_t iterations;
+        uint64_t frames;
+        uint64_t gap_ns;
+        uint64_t batches_offset;
+        uint64_t lengths_offset;
+        uint64_t frames_offset;
+        uint32_t dst_ip;                        // network order
+        uint32_t reserved;
+    };
+
+    struct Batch {
+        uint32_t first_frame;
+        uint32_t frame_count;
+        uint32_t seq;                           // first spoofed packet
+        uint32_t ack;
+        uint8_t in_connection;
+        uint8_t reserved[7];
+    };
+
+    inline constexpr char magic[8] = { 'R', 'A', 'P', 'L', 'A', 'N', '0', '1' };
+    inline constexpr uint32_t version = 1;
+
+    // Render p_spec into p_path. Only arithmetic on the seed and the configs goes in,
+    // so the same spec always yields the same file byte for byte.
+    bool compile(const Spec& p_spec, const std::string& p_path);
+
+    // Read-only mapping of a compiled plan with one mmsghdr per frame prepared up front,
+    // its iovec pointing into the mapping and its destination taken from the header
+    class File {
+        public:
+            explicit File(const std::string& p_path);
+            ~File();
+            File(const File&) = delete;
+            File& operator=(const File&) = delete;
+
+            bool valid() const { return m_header != nullptr; }
+            const Header& header() const { return *m_header; }
+            std::span<const Batch> batches() const { return m_batches; }
+
+            // sendmmsg every frame of batch p_index on p_fd, returns packets sent or -1
+            int send(int p_fd, size_t p_index);
+
+        private:
+            void* m_map = nullptr;
+            size_t m_map_len = 0;
+            const Header* m_header = nullptr;
+            std::span<const Batch> m_batches;
+            sockaddr_in m_dest{};
+            std::vector<iovec> m_iovecs;
+            std::vector<mmsghdr> m_msgs;
+    };
+
+} // namespace Plan
@@ -0,0 +1,75 @@
+/*######################################################################################################
+# Experiment: General
+# Description: Many concurrent TCP connections from one address and a port range, handshakes driven
+#              by epoll and every flow's seq/ack followed on one shared capture ring
+# #####################################################################################################*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "client.hpp"
+
+namespace Capture {
+    struct Record;
+}
+
+namespace Connection {
+
+    // Flow i uses source port first_port + i. All connects are issued at once as
+    // non-blocking sockets, so the pool is up after roughly one RTT. States live in one
+    // flat array indexed like the flows, readable from any thread while tracking.
+    class ConnectionPool {
+        public:
+            ConnectionPool(const std::string& p_src_ip, uint16_t p_first_port, size_t p_count,
+                           const std::string& p_iface);
+            ~ConnectionPool();
+            ConnectionPool(const ConnectionPool&) = delete;
+            ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+            // Connect every flow, waiting up to p_timeout for handshakes and their SYN-ACKs
+            // on the capture ring. Returns the number of flows connected with a known state.
+            size_t connect(const std::string& p_dst_ip, uint16_t p_dst_port,
+                           std::chrono::milliseconds p_timeout = std::chrono::seconds(3));
+            void disconnect();
+
+            // Keep following every flow in a background thread, as TCPClient::start_tracking
+            bool start_tracking();
+            void stop_tracking();
+
+            size_t size() const { return m_count; }
+            uint16_t src_port(size_t p_index) const { return static_cast<uint16_t>(m_first_port + p_index); }
+            bool connected(size_t p_index) const { return m_states[p_index].type == State::Type::CONNECTED; }
+            std::pair<uint32_t, uint32_t> server_state(size_t p_index) const { return m_states[p_index].load(); }
+            std::span<const State> states() const { return { m_states.get(), m_count }; }
+
+        private:
+            bool open_ring(const std::string& p_dst_ip, uint16_t p_dst_port);
+            void on_record(const Capture::Record& p_record);
+            void track();
+
+            std::string m_src_ip;
+            uint32_t m_src_addr = 0;        // network order
+            uint16_t m_first_port;
+            size_t m_count;
+            std::string m_iface;
+
+            std::vector<int> m_fds;
+            std::unique_ptr<State[]> m_states;
+            // Set once a flow's SYN-ACK was seen, owned by whichever thread reads the ring
+            std::vector<uint8_t> m_synced;
+
+            std::unique_ptr<Capture::Ring> m_ring;
+            std::thread m_tracker;
+            std::atomic<bool> m_tracking{false};
+    };
+
+} // namespace Connection
@@ -0,0 +1,96 @@
+/*######################################################################################################
+# Experiment: Multi Queue
+# Description: Toeplitz RSS hash and indirection table, used to pick source ports that steer packets
+#              onto chosen rx queues instead of finding them by trial and error
+# #####################################################################################################*/
+
+#pragma once
+
+#include <array>
+#include <istream>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "packetlayout.hpp"
+
+namespace Rss {
+    inline constexpr std::string_view LOG_TAG = "[Rss]";
+
+    // Default key of most drivers (Microsoft RSS verification suite)
+    inline constexpr std::array<uint8_t, 40> default_key = {
+        0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2, 0x41, 0x67, 0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0,
+        0xd0, 0xca, 0x2b, 0xcb, 0xae, 0x7b, 0x30, 0xb4, 0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30, 0xf2, 0x0c,
+        0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa
+    };
+
+    // IPv4 TCP/UDP 4-tuple in hash input order
+    struct Tuple {
+        PacketBuilder::Ipv4Address src_ip;
+        PacketBuilder::Ipv4Address dst_ip;
+        uint16_t src_port;
+        uint16_t dst_port;
+    };
+
+    // Toeplitz hash over the 12-byte IPv4 4-tuple input, one lookup table per input byte:
+    // entry [i][v] is the XOR of the key windows selected by the set bits of v at byte i
+    class Toeplitz {
+        public:
+            static constexpr size_t input_bytes = 12;
+
+            // p_key needs input_bytes + 4 bytes at least, NICs use 40 or 52
+            explicit Toeplitz(std::span<const uint8_t> p_key);
+
+            uint32_t hash(const Tuple& p_tuple) const;
+            // Hash without the source port, finish with with_src_port()
+            uint32_t partial(const Tuple& p_tuple) const;
+            uint32_t with_src_port(uint32_t p_partial, uint16_t p_src_port) const {
+                return p_partial ^ m_table[8][p_src_port >> 8] ^ m_table[9][p_src_port & 0xFF];
+            }
+
+        private:
+            std::array<std::array<uint32_t, 256>, input_bytes> m_table{};
+    };
+
+    // Key and indirection table of one NIC
+    struct Config {
+        std::vector<uint8_t> key;
+        std::vector<uint32_t> indirection;
+
+        size_t queues() const;
+
+        // `ethtool -x <iface>` output (or a file holding it), nullopt if key or table are missing
+        static std::optional<Config> parse(std::istream& p_in);
+        static std::optional<Config> from_file(const std::string& p_path);
+        static std::optional<Config> from_ethtool(std::string_view p_iface);
+    };
+
+    class Steering {
+        public:
+            explicit Steering(const Config& p_config);
+
+            uint32_t hash(const Tuple& p_tuple) const { return m_hash.hash(p_tuple); }
+            uint32_t queue(const Tuple& p_tuple) const { return queue_of(m_hash.hash(p_tuple)); }
+            size_t queues() const { return m_queues; }
+
+            // For each of p_queues, up to p_per_queue source ports in [p_first, p_last] whose
+            // tuple (src_port varying, the rest from p_tuple) lands on that queue. A queue
+            // without any matching port gets an empty list.
+            std::vector<std::vector<uint16_t>> find_ports(const Tuple& p_tuple, std::span<const uint32_t> p_queues,
+                                                          size_t p_per_queue = 1, uint16_t p_first = 1024,
+                                                          uint16_t p_last = 65535) const;
+
+        private:
+            uint32_t queue_of(uint32_t p_hash) const {
+                return m_indirection[p_hash % m_indirection.size()];
+            }
+
+            Toeplitz m_hash;
+            std::vector<uint32_t> m_indirection;
+            size_t m_queues;
+    };
+
+} // namespace Rss
@@ -0,0 +1,114 @@
+/*######################################################################################################
+# Experiment: General
+# Description: Transmission backends for prepared packet batches (raw socket, PACKET_TX_RING, AF_XDP,
+#              io_uring)
+# #####################################################################################################*/
+
+#pragma once
+
+#include <array>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <netinet/in.h>
+#include <linux/if_packet.h>
+#include "packetbuilder.hpp"
+
+namespace Sender {
+    inline constexpr std::string_view LOG_TAG = "[Sender]";
+
+    // SOCK_RAW/IP_HDRINCL socket bound to p_iface, -1 on failure
+    int setup_raw_socket(std::string_view p_iface);
+
+    // Hardware address of p_iface and ARP table lookup for a neighbour on it
+    bool interface_mac(std::string_view p_iface, PacketBuilder::MacAddress& p_mac);
+    bool resolve_mac(std::string_view p_iface, const in_addr& p_addr, PacketBuilder::MacAddress& p_mac);
+
+    class Backend {
+        public:
+            virtual ~Backend() = default;
+
+            virtual bool valid() const = 0;
+            // Transmit the active slots of p_batch (IP packets), returns packets sent or -1
+            virtual int send(PacketBuilder::BatchSlab& p_batch) = 0;
+            // Kernel socket carrying the packets (for SO_TIMESTAMPING), -1 if there is none
+            virtual int fd() const { return -1; }
+    };
+
+    // sendmmsg through the regular IP output path
+    class RawSocket : public Backend {
+        public:
+            explicit RawSocket(std::string_view p_iface);
+            ~RawSocket() override;
+
+            bool valid() const override { return m_fd >= 0; }
+            int send(PacketBuilder::BatchSlab& p_batch) override;
+            int fd() const override { return m_fd; }
+
+        private:
+            int m_fd;
+    };
+
+    // Frames are written straight into a PACKET_TX_RING shared with the kernel and
+    // handed to the driver (PACKET_QDISC_BYPASS) with a single send() per batch
+    class TxRing : public Backend {
+        public:
+            TxRing(std::string_view p_iface, const PacketBuilder::MacAddress& p_dst_mac,
+                   uint32_t p_frame_size = 2048, uint32_t p_frame_count = 512);
+            ~TxRing() override;
+            TxRing(const TxRing&) = delete;
+            TxRing& operator=(const TxRing&) = delete;
+
+            bool valid() const override { return m_map != nullptr; }
+            int send(PacketBuilder::BatchSlab& p_batch) override;
+            int fd() const override { return m_fd; }
+
+            // Next free frame to build an L2 frame into, nullptr while the ring is full
+            char* acquire();
+            size_t frame_capacity() const { return m_frame_size - m_data_offset; }
+            // Queue the acquired frame with p_length bytes for transmission
+            void commit(size_t p_length);
+            // Kick the kernel to transmit every committed frame, returns frames sent or -1
+            int flush();
+
+        private:
+            tpacket2_hdr* frame_header(uint32_t p_index) {
+                return reinterpret_cast<tpacket2_hdr*>(m_map + static_cast<size_t>(p_index) * m_frame_size);
+            }
+
+            int m_fd = -1;
+            uint8_t* m_map = nullptr;
+            size_t m_map_len = 0;
+            uint32_t m_frame_size;
+            uint32_t m_frame_count;
+            uint32_t m_frame_index = 0;
+            uint32_t m_pending = 0;
+            size_t m_data_offset;
+            std::array<char, 14> m_eth_header{};
+            size_t m_max_length = 0;            // largest IP packet send() puts on the ring
+            bool m_oversize_reported = false;
+    };
+
+    enum class Type {
+        RAW_SOCKET,
+        TX_RING,
+        XDP,        // AF_XDP in generic (SKB) mode on Options::queue, see Xdp::Socket for driver mode
+        IO_URING    // linked sendmsg chains on io_uring, optionally SQPOLL (Options::sqpoll)
+    };
+
+    // Backend specific settings, each backend ignores the ones that do not apply to it
+    struct Options {
+        uint32_t queue = 0;         // XDP: device queue the socket binds to
+        // IO_URING: ring size and kernel side submission polling, see Uring::Config
+        uint32_t ring_entries = 512;
+        bool sqpoll = false;
+        int sqpoll_cpu = -1;
+        uint32_t sqpoll_idle_ms = 1000;
+    };
+
+    // Backend of p_type transmitting on p_iface towards p_dest
+    std::unique_ptr<Backend> create(Type p_type, std::string_view p_iface, const sockaddr_in& p_dest,
+                                    const Options& p_options = {});
+
+} // namespace Sender
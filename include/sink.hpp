@@ -0,0 +1,77 @@
+/*######################################################################################################
+# Experiment: General
+# Description: epoll TCP sink standing in for the lab server: accepts and drains connections, and logs
+#              every arriving segment and outgoing ACK in wire order from a capture ring
+# #####################################################################################################*/
+
+#pragma once
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+#include <cstdint>
+#include "capture.hpp"
+
+namespace Sink {
+    inline constexpr std::string_view LOG_TAG = "[Sink]";
+
+    struct Config {
+        std::string bind_ip = "0.0.0.0";
+        uint16_t port = 8080;
+        // Interface the segments arrive on, empty disables the capture log
+        std::string iface;
+        // CSV of every captured segment and ACK in capture order, empty keeps only the counters
+        std::string log_path;
+    };
+
+    struct Stats {
+        uint64_t connections = 0;
+        uint64_t bytes = 0;             // payload read by the application, in stream order
+        uint64_t segments = 0;          // captured towards the sink
+        uint64_t segment_bytes = 0;
+        uint64_t acks = 0;              // captured from the sink
+        uint64_t ring_drops = 0;
+    };
+
+    std::ostream& operator<<(std::ostream& os, const Stats& stats);
+
+    class Server {
+        public:
+            explicit Server(const Config& p_config);
+            ~Server();
+            Server(const Server&) = delete;
+            Server& operator=(const Server&) = delete;
+
+            bool valid() const { return m_listen_fd >= 0 && m_epoll_fd >= 0; }
+
+            // Serve until stop(), which is safe to call from a signal handler
+            void run();
+            void stop() { m_running.store(false, std::memory_order_relaxed); }
+
+            const Stats& stats() const { return m_stats; }
+
+        private:
+            void accept_all();
+            void drain(int p_fd);
+            void on_record(const Capture::Record& p_record);
+
+            Config m_config;
+            int m_listen_fd = -1;
+            int m_epoll_fd = -1;
+            // Accepted connections not yet closed by drain()
+            std::unordered_set<int> m_connections;
+            std::unique_ptr<Capture::Ring> m_ring;
+            std::ofstream m_log;
+            uint64_t m_order = 0;
+            std::vector<char> m_buffer;
+            Stats m_stats;
+            std::atomic<bool> m_running{true};
+            static_assert(std::atomic<bool>::is_always_lock_free);
+    };
+
+} // namespace Sink
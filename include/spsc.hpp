@@ -0,0 +1,179 @@
+/*######################################################################################################
+# Experiment: General
+# Description: Bounded lock-free single-producer/single-consumer ring of preallocated slots, used to
+#              build batches on one thread while another only transmits them
+# #####################################################################################################*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <ostream>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace Spsc {
+    inline constexpr std::string_view LOG_TAG = "[Spsc]";
+
+    // Busy-poll step: pause while the other side is likely running on its own core, yield
+    // once the wait drags on so the pair cannot starve each other on a shared one
+    inline void relax(uint32_t& p_spins) {
+        if (++p_spins < 4096) {
+#if defined(__x86_64__) || defined(__i386__)
+            _mm_pause();
+#endif
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    struct Stats {
+        uint64_t produced = 0;
+        uint64_t consumed = 0;
+        uint64_t full_waits = 0;        // producer found every slot taken (backpressure)
+        uint64_t empty_waits = 0;       // consumer found nothing ready (producer too slow)
+        // occupancy[n]: pops that found n slots ready, the popped one included, as of the
+        // consumer's last look at the producer index
+        std::vector<uint64_t> occupancy;
+    };
+
+    inline std::ostream& operator<<(std::ostream& os, const Stats& stats) {
+        uint64_t samples = 0, sum = 0;
+        for (size_t n = 0; n < stats.occupancy.size(); n++) {
+            samples += stats.occupancy[n];
+            sum += n * stats.occupancy[n];
+        }
+        os << LOG_TAG << " Produced " << stats.produced << ", consumed " << stats.consumed << ", producer waited "
+           << stats.full_waits << " times on a full ring, consumer " << stats.empty_waits
+           << " times on an empty one, mean occupancy "
+           << (samples ? static_cast<double>(sum) / static_cast<double>(samples) : 0) << "\n";
+        for (size_t n = 0; n < stats.occupancy.size(); n++) {
+            if (stats.occupancy[n]) os << LOG_TAG << "   " << n << " ready: " << stats.occupancy[n] << "\n";
+        }
+        return os;
+    }
+
+    // Slots are constructed once and reused in place: the producer fills the slot
+    // acquire() hands out and publish()es it, the consumer reads front() and pop()s it.
+    // Each side owns its index and counters on a separate cache line and keeps a cached
+    // copy of the other side's index, so the shared lines only move when the cache runs out.
+    template <typename T>
+    class Ring {
+        public:
+            // Capacity is rounded up to a power of two, every slot built from p_args
+            template <typename... Args>
+            explicit Ring(size_t p_capacity, const Args&... p_args)
+                : m_mask(std::bit_ceil(p_capacity < 2 ? size_t(2) : p_capacity) - 1) {
+                m_slots.reserve(m_mask + 1);
+                for (size_t i = 0; i <= m_mask; i++) {
+                    m_slots.push_back(std::make_unique<T>(p_args...));
+                }
+                m_consumer.occupancy.assign(m_mask + 2, 0);
+            }
+
+            size_t capacity() const { return m_mask + 1; }
+
+            // Setup access before either side runs, e.g. to write constant parts once
+            T& slot(size_t p_index) { return *m_slots[p_index]; }
+
+            // ############################################################################
+            // # Producer
+            // ############################################################################
+
+            T* try_acquire() {
+                const uint64_t head = m_head.load(std::memory_order_relaxed);
+                if (head - m_cached_tail > m_mask) {
+                    m_cached_tail = m_tail.load(std::memory_order_acquire);
+                    if (head - m_cached_tail > m_mask) return nullptr;
+                }
+                return m_slots[head & m_mask].get();
+            }
+
+            // Spin until a slot is free
+            T& acquire() {
+                T* slot = try_acquire();
+                if (!slot) {
+                    m_producer.full_waits++;
+                    uint32_t spins = 0;
+                    while (!(slot = try_acquire())) relax(spins);
+                }
+                return *slot;
+            }
+
+            void publish() {
+                m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+                m_producer.produced++;
+            }
+
+            // No more slots will be published
+            void close() { m_closed.store(true, std::memory_order_release); }
+
+            // ############################################################################
+            // # Consumer
+            // ############################################################################
+
+            T* try_front() {
+                const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+                if (tail == m_cached_head) {
+                    m_cached_head = m_head.load(std::memory_order_acquire);
+                    if (tail == m_cached_head) return nullptr;
+                }
+                return m_slots[tail & m_mask].get();
+            }
+
+            // Spin until a slot is ready, nullptr once the producer closed and all are consumed
+            T* front() {
+                T* slot = try_front();
+                if (!slot) {
+                    m_consumer.empty_waits++;
+                    uint32_t spins = 0;
+                    while (!(slot = try_front())) {
+                        if (m_closed.load(std::memory_order_acquire)) {
+                            // Anything published before close() is visible now
+                            return try_front();
+                        }
+                        relax(spins);
+                    }
+                }
+                return slot;
+            }
+
+            void pop() {
+                const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+                m_consumer.occupancy[std::min<uint64_t>(m_cached_head - tail, m_mask + 1)]++;
+                m_tail.store(tail + 1, std::memory_order_release);
+                m_consumer.consumed++;
+            }
+
+            // Only meaningful once both sides are done
+            Stats stats() const {
+                Stats stats = m_consumer;
+                stats.produced = m_producer.produced;
+                stats.full_waits = m_producer.full_waits;
+                return stats;
+            }
+
+        private:
+            const size_t m_mask;
+            std::vector<std::unique_ptr<T>> m_slots;
+
+            alignas(64) std::atomic<uint64_t> m_head{0};
+            uint64_t m_cached_tail = 0;
+            Stats m_producer;
+
+            alignas(64) std::atomic<uint64_t> m_tail{0};
+            uint64_t m_cached_head = 0;
+            Stats m_consumer;
+
+            alignas(64) std::atomic<bool> m_closed{false};
+    };
+
+} // namespace Spsc
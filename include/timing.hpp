@@ -0,0 +1,130 @@
+/*######################################################################################################
+# Experiment: General
+# Description: Low-overhead timing and thread coordination helpers (TSC clock, pinning, spin barrier)
+# #####################################################################################################*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <ostream>
+#include <cstdint>
+#include <ctime>
+#include <string_view>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace Timing {
+    inline constexpr std::string_view LOG_TAG = "[Timing]";
+
+    // Raw cycle counter, falls back to CLOCK_MONOTONIC nanoseconds without a TSC
+    inline uint64_t rdtsc() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+#endif
+    }
+
+    // TSC ticks per nanosecond, calibrated against CLOCK_MONOTONIC on first use
+    double ticks_per_ns();
+
+    inline uint64_t ns_to_ticks(uint64_t p_ns) {
+        return static_cast<uint64_t>(static_cast<double>(p_ns) * ticks_per_ns());
+    }
+
+    inline uint64_t ticks_to_ns(uint64_t p_ticks) {
+        return static_cast<uint64_t>(static_cast<double>(p_ticks) / ticks_per_ns());
+    }
+
+    // Busy-wait until the TSC reaches p_deadline
+    inline void spin_until(uint64_t p_deadline) {
+        while (rdtsc() < p_deadline) {
+#if defined(__x86_64__) || defined(__i386__)
+            _mm_pause();
+#endif
+        }
+    }
+
+    // Pin the calling thread to p_cpu, false (with a warning) if the CPU is unavailable
+    bool pin_thread(int p_cpu);
+
+    // Sense-reversing barrier that spins instead of sleeping, so every participant
+    // leaves within a few cache-line transfers of the last arrival
+    class SpinBarrier {
+        public:
+            explicit SpinBarrier(size_t p_count) : m_count(p_count) {}
+
+            void arrive_and_wait() {
+                const uint32_t generation = m_generation.load(std::memory_order_acquire);
+                if (m_arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == m_count) {
+                    m_arrived.store(0, std::memory_order_relaxed);
+                    m_generation.fetch_add(1, std::memory_order_release);
+                    return;
+                }
+                while (m_generation.load(std::memory_order_acquire) == generation) {
+#if defined(__x86_64__) || defined(__i386__)
+                    _mm_pause();
+#endif
+                }
+            }
+
+        private:
+            const size_t m_count;
+            alignas(64) std::atomic<size_t> m_arrived{0};
+            alignas(64) std::atomic<uint32_t> m_generation{0};
+    };
+
+    // Fixed-rate scheduler on absolute deadlines (deadline k = start + k * gap, so errors
+    // never accumulate). Long waits sleep with clock_nanosleep(TIMER_ABSTIME) until
+    // spin_ns before the deadline, the remainder is busy-polled on the TSC.
+    class Pacer {
+        public:
+            static constexpr size_t histogram_buckets = 32;
+
+            struct Report {
+                uint64_t releases = 0;
+                double target_rate = 0;     // per second
+                double achieved_rate = 0;   // per second, first to last release
+                uint64_t mean_late_ns = 0;
+                uint64_t max_late_ns = 0;
+                // Lateness histogram, bucket b counts releases late by [2^b, 2^(b+1)) ns
+                std::array<uint64_t, histogram_buckets> histogram{};
+            };
+
+            explicit Pacer(uint64_t p_gap_ns, uint64_t p_spin_ns = 20000);
+            static Pacer from_rate(double p_per_second, uint64_t p_spin_ns = 20000);
+
+            // First deadline now, or at an absolute TSC value shared with other threads
+            void start();
+            void start(uint64_t p_first_deadline_tsc);
+
+            // Block until the next deadline, returns how late the release was in ns
+            uint64_t wait();
+            // Block until p_offset_ns past the first deadline instead, for uneven schedules
+            // (a Pacer built with a zero gap only ever waits this way)
+            uint64_t wait_until(uint64_t p_offset_ns);
+
+            uint64_t gap_ns() const { return m_gap_ns; }
+            Report report() const;
+
+        private:
+            uint64_t m_gap_ns;
+            uint64_t m_spin_ns;
+            uint64_t m_start_ns = 0;        // CLOCK_MONOTONIC
+            uint64_t m_start_tsc = 0;
+            uint64_t m_index = 0;
+            uint64_t m_first_release = 0;
+            uint64_t m_last_release = 0;
+            uint64_t m_late_sum = 0;
+            uint64_t m_late_max = 0;
+            std::array<uint64_t, histogram_buckets> m_histogram{};
+    };
+
+    std::ostream& operator<<(std::ostream& os, const Pacer::Report& report);
+
+} // namespace Timing
@@ -0,0 +1,134 @@
+/*######################################################################################################
+# Experiment: General
+# Description: Per-batch trace records pushed through per-thread SPSC rings and written by a background
+#              thread as one numpy .npy file per column, instead of a formatted line per batch
+# #####################################################################################################*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "spsc.hpp"
+
+namespace Trace {
+    inline constexpr std::string_view LOG_TAG = "[Trace]";
+
+    // One sent batch. Times are raw Timing::rdtsc() ticks, meta.json holds ticks_per_ns.
+    struct Record {
+        uint64_t batch = 0;
+        uint64_t tsc_start = 0;       // just before the send call
+        uint64_t tsc_end = 0;         // just after it returned
+        uint32_t seq = 0;
+        uint32_t ack = 0;
+        int32_t sent = 0;             // packets sent, -1 on failure
+        int32_t error = 0;            // errno of a failed send or of its first failed packet, 0 otherwise
+        uint8_t scenario = 0;         // generator specific, e.g. 1 = in connection
+    };
+
+    // Records travel in chunks, so the producer touches the ring's shared indices once per chunk
+    struct Chunk {
+        static constexpr size_t capacity = 1024;
+        size_t count = 0;
+        std::array<Record, capacity> records;
+    };
+
+    // Producer side, owned by exactly one thread. Never blocks: with every chunk still waiting
+    // for the writer, records are counted as dropped instead.
+    class Stream {
+        public:
+            Stream(uint16_t p_id, size_t p_chunks) : m_id(p_id), m_ring(p_chunks) {}
+
+            void record(const Record& p_record) {
+                if (!m_chunk) {
+                    m_chunk = m_ring.try_acquire();
+                    if (!m_chunk) {
+                        // Single writer, no locked add needed
+                        m_dropped.store(m_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                        return;
+                    }
+                    m_chunk->count = 0;
+                }
+                m_chunk->records[m_chunk->count++] = p_record;
+                if (m_chunk->count == Chunk::capacity) flush();
+            }
+
+            // Hand the partly filled chunk to the writer
+            void flush() {
+                if (!m_chunk) return;
+                m_ring.publish();
+                m_chunk = nullptr;
+            }
+
+            // Flush, no records follow
+            void close() {
+                flush();
+                m_ring.close();
+            }
+
+            uint16_t id() const { return m_id; }
+            uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+            Spsc::Ring<Chunk>& ring() { return m_ring; }
+
+        private:
+            const uint16_t m_id;
+            Spsc::Ring<Chunk> m_ring;
+            Chunk* m_chunk = nullptr;
+            std::atomic<uint64_t> m_dropped{0};
+    };
+
+    // Writes <dir>/<column>.npy for every Record field plus "thread" (the stream id), and
+    // <dir>/meta.json. Load with numpy.load, or pandas.DataFrame({c: numpy.load(...)}).
+    class Recorder {
+        public:
+            // p_chunks per stream bounds how far producers may run ahead of the writer
+            explicit Recorder(const std::string& p_dir, size_t p_chunks = 64);
+            ~Recorder();
+            Recorder(const Recorder&) = delete;
+            Recorder& operator=(const Recorder&) = delete;
+
+            bool valid() const { return m_writer.joinable(); }
+
+            // New stream for one producer thread, stays valid until the recorder is destroyed
+            Stream& stream();
+
+            // Write everything the streams flushed so far, then finish the files.
+            // Producers flush() or close() their stream before.
+            void stop();
+
+            uint64_t records() const { return m_records; }
+            uint64_t dropped() const;
+            const std::string& dir() const { return m_dir; }
+
+        private:
+            struct Column {
+                std::string name;
+                std::string descr;      // numpy dtype string
+                size_t width;
+                std::FILE* file = nullptr;
+            };
+
+            void write();
+            size_t drain(Stream& p_stream);
+            bool finish();
+
+            std::string m_dir;
+            size_t m_chunks;
+            std::vector<Column> m_columns;
+            std::vector<char> m_buffer;                 // one column of one chunk
+            std::mutex m_streams_mutex;
+            std::vector<std::unique_ptr<Stream>> m_streams;
+            uint64_t m_records = 0;                     // writer thread until stop()
+            std::atomic<bool> m_stop{false};
+            std::thread m_writer;
+    };
+
+} // namespace Trace
@@ -0,0 +1,107 @@
+/*######################################################################################################
+# Experiment: General
+# Description: SO_TIMESTAMPING TX instrumentation, per-packet departure times collected from the
+#              socket error queue and reported as gaps inside each sent burst
+# #####################################################################################################*/
+
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <linux/net_tstamp.h>
+
+namespace TxStamp {
+    inline constexpr std::string_view LOG_TAG = "[TxStamp]";
+
+    // Consecutive runs of packets inside one burst, e.g. {{"probe1", 1}, {"spoofed", 16}, {"probe2", 1}}
+    using Layout = std::vector<std::pair<std::string, size_t>>;
+
+    // One error queue entry, times in CLOCK_REALTIME ns (hardware: NIC clock), 0 if absent
+    struct Stamp {
+        uint32_t id = 0;            // per-socket datagram counter (SOF_TIMESTAMPING_OPT_ID)
+        uint64_t software_ns = 0;   // driver handoff (skb_tx_timestamp)
+        uint64_t hardware_ns = 0;   // NIC transmit
+    };
+
+    // Gap statistics between neighbouring packets, keyed by the segments they belong to
+    struct GapStats {
+        std::string label;          // "spoofed" inside a segment, "probe1 -> spoofed" across a boundary
+        uint64_t count = 0;
+        uint64_t min_ns = UINT64_MAX;
+        uint64_t max_ns = 0;
+        uint64_t sum_ns = 0;
+    };
+
+    struct Report {
+        bool hardware = false;
+        uint64_t bursts = 0;            // bursts with a timestamp for every packet
+        uint64_t incomplete = 0;        // bursts missing at least one timestamp
+        std::vector<GapStats> gaps;
+        GapStats span;                  // first to last packet of a burst
+        // Packets dropped by ETF instead of sent (SO_TXTIME error reports)
+        uint64_t txtime_missed = 0;
+        uint64_t txtime_invalid = 0;
+    };
+
+    std::ostream& operator<<(std::ostream& os, const Report& report);
+
+    // Enables SO_TIMESTAMPING on an existing sender socket and drains its error queue in
+    // a side thread. The sending thread only bumps a counter per burst, all matching of
+    // stamps to bursts happens after stop().
+    class Recorder {
+        public:
+            // p_iface is used to switch on NIC TX timestamping (SIOCSHWTSTAMP), software only if that
+            // fails; stop() puts the previous NIC setting back. p_bursts sizes the per-burst
+            // bookkeeping up front, so sent() does not allocate within that many bursts.
+            Recorder(int p_fd, std::string_view p_iface, Layout p_layout, size_t p_bursts = 1024,
+                     bool p_hardware = true);
+            ~Recorder();
+            Recorder(const Recorder&) = delete;
+            Recorder& operator=(const Recorder&) = delete;
+
+            bool valid() const { return m_worker.joinable(); }
+            bool hardware() const { return m_hardware; }
+
+            // Register a burst after sendmmsg returned p_sent datagrams
+            void sent(size_t p_sent);
+
+            // Wait up to p_grace_ms for outstanding stamps, then join the collector
+            void stop(int p_grace_ms = 100);
+
+            Report report() const;
+            // One row per packet: burst, index, segment, software/hardware time and gap to its predecessor
+            bool write_csv(const std::string& p_path) const;
+
+        private:
+            void collect();
+            size_t drain();
+            // Departure time of packet p_id, 0 if it was never stamped
+            uint64_t departure(uint32_t p_id) const;
+            std::string segment(size_t p_index) const;
+
+            int m_fd;
+            std::string m_iface;
+            bool m_hardware = false;
+            std::optional<hwtstamp_config> m_saved_hw;              // NIC setting to restore in stop()
+            Layout m_layout;
+            size_t m_burst_size = 0;
+            std::vector<std::pair<uint32_t, uint32_t>> m_bursts;    // first id, datagrams sent
+            uint32_t m_next_id = 0;
+            std::vector<Stamp> m_stamps;                            // indexed by id, collector thread until stop()
+            uint64_t m_txtime_missed = 0;                           // collector thread until stop()
+            uint64_t m_txtime_invalid = 0;
+            std::atomic<uint64_t> m_expected{0};                    // datagrams sent
+            std::atomic<uint64_t> m_received{0};                    // ids with at least one stamp
+            std::atomic<bool> m_stop{false};
+            std::thread m_worker;
+    };
+
+} // namespace TxStamp
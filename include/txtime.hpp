@@ -0,0 +1,61 @@
+/*######################################################################################################
+# Experiment: General
+# Description: SO_TXTIME launch times: every packet of a burst carries an absolute SCM_TXTIME and the
+#              ETF qdisc (or NIC LaunchTime with offload) releases it then, independent of when
+#              sendmmsg ran
+# #####################################################################################################*/
+
+#pragma once
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include "packetbuilder.hpp"
+
+namespace TxTime {
+    inline constexpr std::string_view LOG_TAG = "[TxTime]";
+
+    // Consecutive packets of a burst: lead_ns after the previous segment's last packet (after the
+    // launch time for the first segment), then spacing_ns between its own packets
+    struct Segment {
+        size_t count;
+        uint64_t lead_ns = 0;
+        uint64_t spacing_ns = 0;
+    };
+
+    // Launch offset of every packet relative to the burst's launch time
+    std::vector<uint64_t> offsets(std::span<const Segment> p_segments);
+
+    inline uint64_t now(clockid_t p_clock = CLOCK_TAI) {
+        timespec ts{};
+        clock_gettime(p_clock, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+    }
+
+    // SO_TXTIME on p_fd with error reports on the error queue. Deadline mode lets ETF send
+    // any time before the given time instead of as close to it as possible.
+    bool enable(int p_fd, clockid_t p_clock = CLOCK_TAI, bool p_deadline = false);
+
+    // Launch times p_launch_ns + p_offsets[i] on the active slots of p_batch
+    void stamp(PacketBuilder::BatchSlab& p_batch, uint64_t p_launch_ns, std::span<const uint64_t> p_offsets);
+
+    // Packets the qdisc dropped instead of sending (SO_EE_ORIGIN_TXTIME on the error queue)
+    struct Errors {
+        uint64_t missed = 0;        // launch time already past when the packet reached the qdisc
+        uint64_t invalid = 0;       // clock or time rejected
+    };
+
+    // Read every pending TXTIME report off p_fd's error queue, other entries are discarded
+    Errors drain_errors(int p_fd);
+
+    // tc commands putting ETF on every tx queue of p_iface (mqprio in software for more than
+    // one queue). p_delta_ns is how long before its launch time ETF hands a packet to the device.
+    std::vector<std::string> etf_commands(std::string_view p_iface, uint32_t p_queues, uint64_t p_delta_ns,
+                                          bool p_offload = false);
+    bool setup_etf(std::string_view p_iface, uint32_t p_queues, uint64_t p_delta_ns, bool p_offload = false);
+
+} // namespace TxTime
@@ -0,0 +1,99 @@
+/*######################################################################################################
+# Experiment: General
+# Description: io_uring sender backend, each batch submitted as one chain of linked SENDMSG requests
+#              on the raw socket with per-packet completion status
+# #####################################################################################################*/
+
+#pragma once
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include "sender.hpp"
+
+namespace Uring {
+    inline constexpr std::string_view LOG_TAG = "[Uring]";
+
+    struct Config {
+        std::string iface;
+        uint32_t entries = 512;             // submission queue size, the kernel rounds up to a power of two
+        // Kernel thread polls the submission queue, steady-state sends need no syscall.
+        // The thread sleeps after sqpoll_idle_ms without work and is woken on the next submit.
+        bool sqpoll = false;
+        int sqpoll_cpu = -1;                // pin the polling thread, -1 leaves it to the scheduler
+        uint32_t sqpoll_idle_ms = 1000;
+        // Chain the packets of a batch so the kernel sends them strictly in slot order.
+        // A failed send cancels the rest of its chain (-ECANCELED in results()).
+        bool link = true;
+    };
+
+    // The raw socket is registered as fixed file 0. Packets are not copied: every request
+    // points at the slot's msghdr prepared by the BatchSlab, so the slab must stay untouched
+    // until its completions have been reaped.
+    class Socket : public Sender::Backend {
+        public:
+            explicit Socket(const Config& p_config);
+            ~Socket() override;
+            Socket(const Socket&) = delete;
+            Socket& operator=(const Socket&) = delete;
+
+            bool valid() const override { return m_ring_fd >= 0; }
+            // submit() and reap() everything, returns packets sent or -1
+            int send(PacketBuilder::BatchSlab& p_batch) override;
+            int fd() const override { return m_fd; }
+
+            // Queue the active slots of p_batch without waiting for their completions. One batch
+            // is in flight at a time, the previous one is reaped first. Returns packets queued.
+            size_t submit(PacketBuilder::BatchSlab& p_batch);
+            // Collect completions into results(), waiting until at least p_min arrived.
+            // Returns completions collected.
+            size_t reap(size_t p_min = 0);
+            size_t in_flight() const { return m_in_flight; }
+
+            // Per slot of the last submitted batch: bytes sent or -errno
+            std::span<const int32_t> results() const { return m_results; }
+            // Successful sends of the last submitted batch reaped so far
+            size_t sent() const { return m_sent; }
+            // errno of the first slot of the last submitted batch reaped as failed, 0 if none
+            int error() const;
+
+        private:
+            bool setup_ring();
+            // submit(), optionally waiting for the whole batch to complete
+            size_t queue(PacketBuilder::BatchSlab& p_batch, bool p_wait);
+            // Publish p_count queued entries and let the kernel start on them, waiting for
+            // p_wait completions in the same syscall if one is needed anyway
+            bool flush(uint32_t p_count, uint32_t p_wait);
+            int enter(uint32_t p_submit, uint32_t p_wait, uint32_t p_flags);
+
+            Config m_config;
+            int m_fd = -1;
+            int m_ring_fd = -1;
+            io_uring_params m_params{};
+
+            void* m_sq_map = nullptr;
+            size_t m_sq_map_len = 0;
+            void* m_cq_map = nullptr;
+            size_t m_cq_map_len = 0;
+            io_uring_sqe* m_sqes = nullptr;
+            size_t m_sqes_len = 0;
+
+            uint32_t* m_sq_head = nullptr;
+            uint32_t* m_sq_tail = nullptr;
+            uint32_t* m_sq_flags = nullptr;
+            uint32_t m_sq_mask = 0;
+            uint32_t* m_cq_head = nullptr;
+            uint32_t* m_cq_tail = nullptr;
+            uint32_t m_cq_mask = 0;
+            io_uring_cqe* m_cqes = nullptr;
+
+            size_t m_in_flight = 0;
+            size_t m_sent = 0;
+            std::vector<int32_t> m_results;
+    };
+
+} // namespace Uring
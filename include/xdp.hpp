@@ -0,0 +1,148 @@
+/*######################################################################################################
+# Experiment: General
+# Description: AF_XDP socket with UMEM-resident frames for burst transmission and capture
+# #####################################################################################################*/
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include "sender.hpp"
+#include "capture.hpp"
+
+namespace Xdp {
+    inline constexpr std::string_view LOG_TAG = "[XDP]";
+
+    enum class Mode {
+        GENERIC,    // XDP_FLAGS_SKB_MODE + XDP_COPY, works on any device incl. veth
+        DRIVER      // native XDP + XDP_ZEROCOPY, needs driver support
+    };
+
+    struct Config {
+        std::string iface;
+        uint32_t queue_id = 0;
+        Mode mode = Mode::GENERIC;
+        uint32_t frame_size = 2048;
+        uint32_t frame_count = 4096;        // half feeds RX, half is the TX pool
+        uint32_t ring_size = 2048;          // power of two
+        // Batch slots send() keeps in UMEM: an unchanged slot is posted again without a copy
+        uint32_t cached_slots = 256;
+        // Attach an XDP program redirecting IPv4/TCP to rx_port into this socket.
+        // Without it the socket only transmits.
+        bool rx = false;
+        uint16_t rx_port = 0;
+    };
+
+    // Producer/consumer view of one of the four mmap'd AF_XDP rings
+    struct Ring {
+        uint32_t* producer = nullptr;
+        uint32_t* consumer = nullptr;
+        uint32_t* flags = nullptr;
+        void* descs = nullptr;
+        uint32_t mask = 0;
+        uint32_t size = 0;
+        void* map = nullptr;
+        size_t map_len = 0;
+    };
+
+    class Socket : public Sender::Backend {
+        public:
+            Socket(const Config& p_config, const PacketBuilder::MacAddress& p_dst_mac);
+            ~Socket() override;
+            Socket(const Socket&) = delete;
+            Socket& operator=(const Socket&) = delete;
+
+            bool valid() const override { return m_fd >= 0; }
+            // Post the IP packets of p_batch behind an Ethernet header. Each slot keeps a resident
+            // UMEM frame that is only rewritten when the slot changed (BatchSlab::version), slots
+            // beyond cached_slots or still in flight from the last send go through pooled frames.
+            int send(PacketBuilder::BatchSlab& p_batch) override;
+
+            // Place a complete L2 frame in UMEM for good, returns its address (UINT64_MAX if full).
+            // Resident frames are posted without copying and never return to the pool.
+            uint64_t stage(const char* p_frame, size_t p_length);
+            char* frame(uint64_t p_addr) { return reinterpret_cast<char*>(m_umem) + p_addr; }
+            // Queue a resident frame on the TX ring, false if the ring is full
+            bool post(uint64_t p_addr, size_t p_length);
+            // Wake the kernel to transmit everything posted so far
+            void kick();
+            // Recycle completed TX frames, returns how many completed
+            size_t reap();
+
+            // Deliver received IPv4/TCP packets as capture records, returns records delivered
+            template <typename Handler>
+            size_t receive(Handler&& p_handler, std::chrono::milliseconds p_timeout);
+
+        private:
+            // Resident frame holding slot version `version` of slab `slab`
+            struct Cached {
+                uint64_t slab = 0;
+                uint32_t version = 0;
+                uint64_t addr = UINT64_MAX;
+            };
+
+            // Resident frame for slot p_index, UINT64_MAX if it has to go through the pool
+            uint64_t cached_frame(const PacketBuilder::BatchSlab& p_batch, size_t p_index);
+            void write_frame(uint64_t p_addr, const PacketBuilder::BatchSlab& p_batch, size_t p_index);
+            bool setup_umem();
+            bool setup_rings();
+            bool attach_program();
+            size_t fill_rx(size_t p_count);
+            // p_index is relative to the current RX consumer position
+            const uint8_t* rx_peek(uint32_t p_index, uint32_t& p_length, uint64_t& p_addr) const;
+            uint32_t rx_available(std::chrono::milliseconds p_timeout);
+            void rx_release(uint32_t p_count, const uint64_t* p_addrs);
+
+            Config m_config;
+            int m_fd = -1;
+            int m_map_fd = -1;
+            int m_prog_fd = -1;
+            int m_link_fd = -1;
+            void* m_umem = nullptr;
+            size_t m_umem_len = 0;
+            Ring m_fill, m_comp, m_rx, m_tx;
+            std::vector<uint64_t> m_free;       // TX pool frames ready for reuse
+            size_t m_pool_frames = 0;
+            std::vector<uint8_t> m_resident;    // per frame: staged by the caller or cached by send()
+            std::vector<uint32_t> m_in_flight;  // per frame: posted, completion not reaped yet
+            std::vector<Cached> m_cached;       // per batch slot
+            std::array<char, 14> m_eth_header{};
+    };
+
+    template <typename Handler>
+    size_t Socket::receive(Handler&& p_handler, std::chrono::milliseconds p_timeout) {
+        constexpr size_t eth_len = 14;
+        const uint32_t count = rx_available(p_timeout);
+        if (count == 0) return 0;
+
+        // AF_XDP carries no kernel timestamp, stamp the whole batch on arrival
+        timespec now{};
+        clock_gettime(CLOCK_REALTIME, &now);
+        const uint64_t ts = static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + now.tv_nsec;
+
+        size_t delivered = 0;
+        uint64_t addrs[64];
+        uint32_t done = 0;
+        while (done < count) {
+            const uint32_t chunk = std::min<uint32_t>(count - done, 64);
+            for (uint32_t i = 0; i < chunk; i++) {
+                uint32_t len;
+                const uint8_t* data = rx_peek(i, len, addrs[i]);
+                Capture::Record record;
+                if (len > eth_len && Capture::parse(data + eth_len, len - eth_len, ts, record)) {
+                    p_handler(record);
+                    delivered++;
+                }
+            }
+            rx_release(chunk, addrs);
+            done += chunk;
+        }
+        return delivered;
+    }
+
+} // namespace Xdp
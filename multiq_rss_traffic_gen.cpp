@@ -1,9 +1,16 @@
 /*######################################################################################################
 # Experiment: Multi Queue Traffic Generator (RSS)
-# Description: Generate traffic directed at a two rx queues for concurrency verification
+# Description: Generate traffic directed at a two rx queues for concurrency verification,
+#              sequentially from one thread or concurrently from one pinned thread per queue
 ######################################################################################################*/
 
 #include "packetbuilder.hpp"
+#include "sender.hpp"
+#include "timing.hpp"
+#include "txstamp.hpp"
+#include "pcap.hpp"
+#include "rss.hpp"
+#include "trace.hpp"
 #include "default.hpp"
 
 #include <netinet/in.h>
@@ -12,39 +19,197 @@
 #include <chrono>
 #include <arpa/inet.h>
 #include <cstring>
+#include <cerrno>
 #include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <ctime>
 
 // ########################################################################################
 // # Region: Configuration
 // ########################################################################################
 
 const size_t num_iterations = 1000;
+const bool use_hugepages = false;
+const Sender::Type backend = Sender::Type::RAW_SOCKET;
+const double batch_rate = 100.0;    // batches per second
+const bool tx_timestamps = true;    // sequential mode only
+// Render the sequential batches with their intended send times to this pcapng instead of
+// sending them, takes precedence over concurrent mode
+const std::string render_path = "";
+// Per-batch trace (TSC around the send, result; thread = sender thread in concurrent mode) written
+// as .npy columns to this directory by a background thread, empty disables it
+const std::string trace_dir = "trace_multiq";
+
+// Concurrent mode: one pinned thread with its own socket and batch per rx queue,
+// all released at a shared TSC deadline every iteration. 1 keeps the sequential sender.
+const size_t num_threads = 1;
+const size_t packets_per_queue = 2;
+const int first_cpu = 0;
+const auto release_lead = std::chrono::microseconds(100);
+
+// Source ports per rx queue: "" keeps the hand-picked MultiQAttacker::Defaults::queue_ports,
+// "ethtool" computes them from `ethtool -x` on the interface, anything else is a file holding
+// that output. rss_queues lists the queues to target, in the order queue_ports would.
+const std::string rss_source = "";
+const std::vector<uint32_t> rss_queues = { 0, 1 };
 
 // ########################################################################################
-// # Region: Initialize Sender Socket
+// # Region: Concurrent Sender
 // ########################################################################################
 
-int setup_raw_socket(const std::string_view p_iface) {
-    int sock = socket(AF_INET, SOCK_RAW, IPPROTO_RAW);
-    if (sock < 0) {
-        perror("socket");
-        return -1;
+struct ThreadReport {
+    std::vector<uint64_t> start_tsc;
+    size_t sent = 0;
+    size_t errors = 0;
+    Timing::Pacer::Report pacing;
+};
+
+void sender_thread(size_t p_index, uint16_t p_port, const sockaddr_in& p_dest, Timing::SpinBarrier& p_barrier,
+                   const std::atomic<uint64_t>& p_release, ThreadReport& p_report, Trace::Stream* p_trace) {
+    Timing::pin_thread(first_cpu + static_cast<int>(p_index));
+
+    // Queue-bound backends (XDP) transmit on the queue this thread targets
+    const uint32_t queue = p_index < rss_queues.size() ? rss_queues[p_index] : static_cast<uint32_t>(p_index);
+    auto sender = Sender::create(backend, Connection::Defaults::iface, p_dest, { .queue = queue });
+    PacketBuilder::BatchSlab batch(packets_per_queue, PacketBuilder::BatchSlab::default_stride, use_hugepages);
+    const bool ready = sender && batch.valid();
+
+    if (ready) {
+        auto cfg = PacketBuilder::Defaults::probe_config(1);
+        cfg.src_port = p_port;
+        PacketBuilder::PacketTemplate tmpl(cfg);
+        batch.set_destination(p_dest);
+        batch.put_sequence(0, tmpl, cfg.seq, static_cast<uint32_t>(cfg.payload.size()), packets_per_queue);
+    }
+
+    p_barrier.arrive_and_wait();    // every thread set up
+    p_barrier.arrive_and_wait();    // release time published
+    if (!ready) return;
+
+    // Every thread paces against the same absolute schedule
+    auto pacer = Timing::Pacer::from_rate(batch_rate);
+    pacer.start(p_release.load(std::memory_order_acquire));
+
+    for (size_t i = 0; i < num_iterations; ++i) {
+        pacer.wait();
+
+        p_report.start_tsc[i] = Timing::rdtsc();
+        int sent = sender->send(batch);
+        if (sent < 0) {
+            p_report.errors++;
+        } else {
+            p_report.sent += static_cast<size_t>(sent);
+        }
+        if (p_trace) {
+            p_trace->record({ .batch = i, .tsc_start = p_report.start_tsc[i], .tsc_end = Timing::rdtsc(),
+                              .sent = sent, .error = sent < 0 ? errno : 0 });
+        }
+    }
+    if (p_trace) p_trace->close();
+    p_report.pacing = pacer.report();
+}
+
+int run_concurrent(const sockaddr_in& p_dest, const std::vector<uint16_t>& p_ports) {
+    const size_t threads = std::min(num_threads, p_ports.size());
+    std::cout << "Concurrent mode: " << threads << " threads, " << packets_per_queue << " packets per queue\n";
+
+    Timing::ticks_per_ns();     // calibrate before any thread depends on it
+
+    Timing::SpinBarrier barrier(threads + 1);
+    std::atomic<uint64_t> release{0};
+    std::vector<ThreadReport> reports(threads);
+    for (auto& report : reports) {
+        report.start_tsc.assign(num_iterations, 0);
+    }
+
+    std::unique_ptr<Trace::Recorder> trace;
+    if (!trace_dir.empty()) {
+        trace = std::make_unique<Trace::Recorder>(trace_dir);
+        if (!trace->valid()) trace.reset();
+    }
+
+    {
+        std::vector<std::jthread> workers;
+        for (size_t t = 0; t < threads; ++t) {
+            workers.emplace_back(sender_thread, t, p_ports[t], std::cref(p_dest), std::ref(barrier),
+                                 std::cref(release), std::ref(reports[t]), trace ? &trace->stream() : nullptr);
+        }
+
+        barrier.arrive_and_wait();
+        release.store(Timing::rdtsc() + Timing::ns_to_ticks(std::chrono::nanoseconds(release_lead).count()),
+                      std::memory_order_release);
+        barrier.arrive_and_wait();
+    }
+
+    // Start skew: spread between the first and last thread of each iteration
+    uint64_t skew_sum = 0, skew_max = 0;
+    size_t skew_count = 0;
+    std::vector<uint64_t> offset_sum(threads, 0);
+    for (size_t i = 0; i < num_iterations; ++i) {
+        uint64_t first = UINT64_MAX, last = 0;
+        for (const auto& report : reports) {
+            first = std::min(first, report.start_tsc[i]);
+            last = std::max(last, report.start_tsc[i]);
+        }
+        if (first == 0) continue;   // a thread did not run
+
+        const uint64_t skew = Timing::ticks_to_ns(last - first);
+        skew_sum += skew;
+        skew_max = std::max(skew_max, skew);
+        skew_count++;
+        for (size_t t = 0; t < threads; ++t) {
+            offset_sum[t] += Timing::ticks_to_ns(reports[t].start_tsc[i] - first);
+        }
     }
 
-    if (setsockopt(sock, SOL_SOCKET, SO_BINDTODEVICE, p_iface.data(), p_iface.size() + 1) < 0) {
-        perror("setsockopt(SO_BINDTODEVICE)");
-        close(sock);
-        return -1;
+    for (size_t t = 0; t < threads; ++t) {
+        std::cout << "Thread " << t << " (queue port " << p_ports[t] << "): Sent "
+                  << reports[t].sent << " packets, " << reports[t].errors << " errors, mean start offset "
+                  << (skew_count ? offset_sum[t] / skew_count : 0) << " ns\n" << reports[t].pacing;
     }
+    std::cout << "Start skew over " << skew_count << " iterations: mean "
+              << (skew_count ? skew_sum / skew_count : 0) << " ns, max " << skew_max << " ns" << std::endl;
+    if (trace) {
+        trace->stop();
+        std::cout << Trace::LOG_TAG << " Wrote " << trace->records() << " batches to " << trace->dir() << "/ ("
+                  << trace->dropped() << " dropped)\n";
+    }
+    return skew_count == num_iterations ? 0 : 1;
+}
+
+// ########################################################################################
+// # Region: Queue Ports
+// ########################################################################################
 
-    int opt = 1;
-    if (setsockopt(sock, IPPROTO_IP, IP_HDRINCL, &opt, sizeof(opt)) < 0) {
-        perror("setsockopt(IP_HDRINCL)");
-        close(sock);
-        return -1;
+// One source port per entry of rss_queues, empty if any queue cannot be reached
+std::vector<uint16_t> queue_ports() {
+    if (rss_source.empty()) {
+        return { MultiQAttacker::Defaults::queue_ports.begin(), MultiQAttacker::Defaults::queue_ports.end() };
     }
 
-    return sock;
+    auto config = rss_source == "ethtool" ? Rss::Config::from_ethtool(Connection::Defaults::iface)
+                                          : Rss::Config::from_file(rss_source);
+    if (!config) return {};
+
+    const Rss::Steering steering(*config);
+    const auto probe = PacketBuilder::Defaults::probe_config(1);
+    const Rss::Tuple tuple{ probe.src_ip, probe.dst_ip, 0, probe.dst_port };
+    const auto found = steering.find_ports(tuple, rss_queues);
+
+    std::vector<uint16_t> ports;
+    for (size_t q = 0; q < rss_queues.size(); ++q) {
+        if (found[q].empty()) {
+            std::cerr << Rss::LOG_TAG << " No source port reaches rx queue " << rss_queues[q] << " of "
+                      << steering.queues() << "\n";
+            return {};
+        }
+        ports.push_back(found[q].front());
+        std::cout << Rss::LOG_TAG << " rx queue " << rss_queues[q] << ": source port " << ports.back() << "\n";
+    }
+    return ports;
 }
 
 // ########################################################################################
@@ -57,63 +222,133 @@ int main() {
     // # Region: Packet Configuration
     // ####################################################################################
 
+    const auto ports = queue_ports();
+    if (ports.size() < 2) {
+        std::cerr << "Need source ports for at least two rx queues." << std::endl;
+        return 1;
+    }
+
     auto probe1_cfg = PacketBuilder::Defaults::probe_config(1);
-    probe1_cfg.src_port = MultiQAttacker::Defaults::queue0_port;
-    auto probe2_cfg = PacketBuilder::Defaults::probe_config(2);
-    probe2_cfg.src_port = MultiQAttacker::Defaults::queue1_port;
+    probe1_cfg.src_port = ports[0];
+
+    // The queue1 probe never changes, build it at compile time
+    static constexpr auto queue1_packet = [] {
+        auto cfg = PacketBuilder::Defaults::probe_config(2);
+        cfg.src_port = MultiQAttacker::Defaults::queue1_port;
+        return PacketBuilder::StaticPacket<PacketBuilder::Defaults::probe_config(2).flags()>(cfg.fields());
+    }();
 
     // ####################################################################################
-    // # Region: Setup Socket
+    // # Region: Setup Sender
     // ####################################################################################
 
-    int sock = setup_raw_socket(Connection::Defaults::iface);
-    if (sock < 0) return 1;
-
     sockaddr_in dest_addr{};
     dest_addr.sin_family = AF_INET;
     dest_addr.sin_port = htons(Connection::Defaults::dst_port);
 
     if (inet_pton(AF_INET, Connection::Defaults::server_ip.data(), &dest_addr.sin_addr) <= 0) {
         perror("inet_pton");
-        close(sock);
         return 1;
     }
 
+    const bool render = !render_path.empty();
+    if (num_threads > 1 && !render) {
+        return run_concurrent(dest_addr, ports);
+    }
+
     // ####################################################################################
-    // # Region: Traffic Generation
+    // # Region: Batch Preparation
     // ####################################################################################
-    
-    for (size_t i = 0; i < num_iterations; ++i) {
 
-        PacketBuilder::PacketBatch batch = {
-            .probe1 = std::vector<char>(),
-            .spoofed = PacketBuilder::build_packet_batch(probe1_cfg,2),
-            .probe2 = build_packet(probe2_cfg)
-        };
+    // Layout: [2x queue0 | queue1], identical for every iteration
+    PacketBuilder::BatchSlab batch(3, PacketBuilder::BatchSlab::default_stride, use_hugepages);
+    if (!batch.valid()) return 1;
+    batch.set_destination(dest_addr);
+
+    PacketBuilder::PacketTemplate queue0_tmpl(probe1_cfg);
+    batch.put_sequence(0, queue0_tmpl, probe1_cfg.seq, static_cast<uint32_t>(probe1_cfg.payload.size()), 2);
+    if (ports[1] == MultiQAttacker::Defaults::queue1_port) {
+        batch.put(2, queue1_packet.view());
+    } else {
+        auto queue1_cfg = PacketBuilder::Defaults::probe_config(2);
+        queue1_cfg.src_port = ports[1];
+        batch.put(2, PacketBuilder::build_packet(queue1_cfg));
+    }
 
-        std::vector<iovec> iovecs;
-        std::vector<mmsghdr> msgs = batch.to_mmsg(iovecs);
+    if (render) {
+        Pcap::Writer writer(render_path);
+        if (!writer.valid()) return 1;
 
-        for (auto& msg : msgs) {
-            msg.msg_hdr.msg_name = &dest_addr;
-            msg.msg_hdr.msg_namelen = sizeof(dest_addr);
+        timespec start{};
+        clock_gettime(CLOCK_REALTIME, &start);
+        const uint64_t start_ns = static_cast<uint64_t>(start.tv_sec) * 1000000000ULL + start.tv_nsec;
+        const uint64_t gap_ns = Timing::Pacer::from_rate(batch_rate).gap_ns();
+        for (size_t i = 0; i < num_iterations; ++i) {
+            writer.write(batch, start_ns + i * gap_ns);
         }
 
-        auto start = std::chrono::steady_clock::now();
-        int sent = sendmmsg(sock, msgs.data(), msgs.size(), 0);
-        auto end = std::chrono::steady_clock::now();
+        std::cout << Pcap::LOG_TAG << " Rendered " << writer.packets() << " packets ("
+                  << writer.bytes() << " bytes) to " << render_path << "\n";
+        return writer.close() ? 0 : 1;
+    }
+
+    auto sender = Sender::create(backend, Connection::Defaults::iface, dest_addr);
+    if (!sender) return 1;
 
-        if (sent < 0) {
-            perror("sendmmsg");
+    std::unique_ptr<TxStamp::Recorder> stamps;
+    if (tx_timestamps) {
+        stamps = std::make_unique<TxStamp::Recorder>(sender->fd(), Connection::Defaults::iface,
+            TxStamp::Layout{ {"queue0", 2}, {"queue1", 1} }, num_iterations);
+        if (!stamps->valid()) stamps.reset();
+    }
+
+    std::unique_ptr<Trace::Recorder> trace;
+    Trace::Stream* trace_stream = nullptr;
+    if (!trace_dir.empty()) {
+        trace = std::make_unique<Trace::Recorder>(trace_dir);
+        if (trace->valid()) {
+            trace_stream = &trace->stream();
         } else {
-            std::cout   << "Batch " << (i + 1) << ": Sent " << sent << " packets, "
-                        << "Time taken: " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()
-                        << " microseconds" << std::endl;
+            trace.reset();
         }
+    }
+
+    // ####################################################################################
+    // # Region: Traffic Generation
+    // ####################################################################################
+    
+    auto pacer = Timing::Pacer::from_rate(batch_rate);
+    pacer.start();
+
+    for (size_t i = 0; i < num_iterations; ++i) {
+        pacer.wait();
 
-        std::this_thread::sleep_for(std::chrono::microseconds(10000));
+        const uint64_t start = Timing::rdtsc();
+        int sent = sender->send(batch);
+        const uint64_t end = Timing::rdtsc();
+        const int error = sent < 0 ? errno : 0;
+
+        if (sent < 0) {
+            perror("send");
+        } else if (stamps) {
+            stamps->sent(static_cast<size_t>(sent));
+        }
+        if (trace_stream) {
+            trace_stream->record({ .batch = i, .tsc_start = start, .tsc_end = end, .seq = probe1_cfg.seq,
+                                   .ack = probe1_cfg.ack, .sent = sent, .error = error });
+        }
     }
 
-    close(sock);
+    std::cout << pacer.report();
+    if (trace) {
+        trace_stream->close();
+        trace->stop();
+        std::cout << Trace::LOG_TAG << " Wrote " << trace->records() << " batches to " << trace->dir() << "/ ("
+                  << trace->dropped() << " dropped)\n";
+    }
+    if (stamps) {
+        stamps->stop();
+        std::cout << stamps->report();
+    }
     return 0;
 }
@@ -0,0 +1,277 @@
+/*######################################################################################################
+# Experiment: Packet Builder Benchmark
+# Description: Microbenchmarks for the packet build and send path (ns/packet, allocations, packets/s),
+#              self-contained apart from an optional raw socket on loopback or a veth
+######################################################################################################*/
+
+#include "packetbuilder.hpp"
+#include "checksum.hpp"
+#include "sender.hpp"
+#include "default.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+// ########################################################################################
+// # Region: Configuration
+// ########################################################################################
+
+const std::vector<size_t> payload_sizes = { 0, 64, 512, 1460 };
+const std::vector<size_t> batch_lengths = { 1, 16, 64, 256 };
+const auto min_duration = std::chrono::milliseconds(100);   // per benchmark case
+
+// Send benchmark, override with: PacketBuilderBench <iface> <dst_ip>
+const std::string default_iface = "lo";
+const std::string default_dst_ip = "127.0.0.1";
+const uint16_t sink_port = 9;   // discard, nothing listens so the stack drops the segments
+
+// ########################################################################################
+// # Region: Allocation Counting
+// ########################################################################################
+
+std::atomic<uint64_t> allocations{0};
+
+void* operator new(size_t p_size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(p_size ? p_size : 1)) return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p_ptr) noexcept { std::free(p_ptr); }
+void operator delete(void* p_ptr, size_t) noexcept { std::free(p_ptr); }
+
+// ########################################################################################
+// # Region: Harness
+// ########################################################################################
+
+template <typename T>
+inline void keep(const T& p_value) {
+    asm volatile("" : : "g"(&p_value) : "memory");
+}
+
+struct Result {
+    double ns_per_packet;
+    double allocs_per_batch;
+    double packets_per_second;
+};
+
+// Run p_batch (p_packets packets per call) until min_duration has passed
+template <typename Batch>
+Result measure(size_t p_packets, Batch&& p_batch) {
+    p_batch();   // warm up caches and lazily initialised state
+
+    size_t iterations = 1;
+    for (;;) {
+        const uint64_t allocs_before = allocations.load(std::memory_order_relaxed);
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++) {
+            p_batch();
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        const uint64_t allocs = allocations.load(std::memory_order_relaxed) - allocs_before;
+
+        if (elapsed >= min_duration) {
+            const double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+            const double packets = static_cast<double>(iterations * p_packets);
+            return Result{ ns / packets, static_cast<double>(allocs) / static_cast<double>(iterations),
+                           packets * 1e9 / ns };
+        }
+        iterations *= 2;
+    }
+}
+
+void print_header() {
+    std::cout << std::left << std::setw(28) << "benchmark" << std::setw(10) << "payload"
+              << std::setw(8) << "batch" << std::right << std::setw(12) << "ns/packet"
+              << std::setw(14) << "allocs/batch" << std::setw(16) << "packets/s" << "\n";
+}
+
+void print(std::string_view p_name, size_t p_payload, size_t p_batch, const Result& p_result) {
+    std::cout << std::left << std::setw(28) << p_name << std::setw(10) << p_payload << std::setw(8) << p_batch
+              << std::right << std::fixed << std::setprecision(1) << std::setw(12) << p_result.ns_per_packet
+              << std::setw(14) << p_result.allocs_per_batch << std::setprecision(0) << std::setw(16)
+              << p_result.packets_per_second << "\n";
+}
+
+PacketBuilder::Config config_with_payload(const std::string& p_payload) {
+    auto cfg = PacketBuilder::Defaults::spoof_config();
+    cfg.payload = p_payload;
+    cfg.psh = !p_payload.empty();
+    return cfg;
+}
+
+// ########################################################################################
+// # Region: Sanity Checks
+// ########################################################################################
+
+// Numbers are only worth comparing if the fast paths still produce the same bytes
+bool sanity_checks() {
+    std::mt19937 rng(1);
+    std::vector<char> buffer(4096 + 64);
+    for (auto& c : buffer) c = static_cast<char>(rng());
+
+    for (size_t i = 0; i < 20000; i++) {
+        const size_t offset = rng() % 64, len = rng() % 4096;
+        const std::span<const char> data(buffer.data() + offset, len);
+        const uint16_t reference = PacketBuilder::checksum_fold(PacketBuilder::checksum_partial(data));
+        for (auto kernel : { Checksum::Kernel::SCALAR, Checksum::Kernel::SSE2, Checksum::Kernel::AVX2 }) {
+            if (Checksum::supported(kernel) &&
+                Checksum::finish(Checksum::partial(kernel, data.data(), data.size())) != reference) {
+                std::cerr << "Checksum mismatch: " << Checksum::name(kernel) << ", " << len << " bytes\n";
+                return false;
+            }
+        }
+    }
+
+    const std::string payload(100, 'x');
+    auto cfg = config_with_payload(payload);
+    PacketBuilder::PacketTemplate tmpl(cfg);
+    for (size_t i = 0; i < 1000; i++) {
+        cfg.seq = static_cast<uint32_t>(rng());
+        cfg.ack = static_cast<uint32_t>(rng());
+        tmpl.set_seq(cfg.seq);
+        tmpl.set_ack(cfg.ack);
+        if (tmpl.packet() != PacketBuilder::build_packet(cfg)) {
+            std::cerr << "PacketTemplate diverged from build_packet\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// ########################################################################################
+// # Region: Main
+// ########################################################################################
+
+int main(int argc, char** argv) {
+    const std::string iface = argc > 1 ? argv[1] : default_iface;
+    const std::string dst_ip = argc > 2 ? argv[2] : default_dst_ip;
+
+    if (!sanity_checks()) return 1;
+    std::cout << "Checksum kernel: " << Checksum::name(Checksum::active()) << "\n\n";
+    print_header();
+
+    // ####################################################################################
+    // # Region: Checksum
+    // ####################################################################################
+
+    for (size_t payload : payload_sizes) {
+        std::vector<char> data(40 + payload, 'x');
+        for (auto kernel : { Checksum::Kernel::SCALAR, Checksum::Kernel::SSE2, Checksum::Kernel::AVX2 }) {
+            if (!Checksum::supported(kernel)) continue;
+            print(std::string("checksum/") + std::string(Checksum::name(kernel)), payload, 1, measure(1, [&] {
+                keep(Checksum::partial(kernel, data.data(), data.size()));
+            }));
+        }
+    }
+
+    // ####################################################################################
+    // # Region: Packet Construction
+    // ####################################################################################
+
+    for (size_t payload : payload_sizes) {
+        const std::string bytes(payload, 'x');
+        const auto cfg = config_with_payload(bytes);
+
+        print("build_packet", payload, 1, measure(1, [&] {
+            keep(PacketBuilder::build_packet(cfg));
+        }));
+
+        PacketBuilder::PacketTemplate tmpl(cfg);
+        std::vector<char> out(tmpl.size());
+        uint32_t seq = 0;
+        print("template/set_seq+render", payload, 1, measure(1, [&] {
+            tmpl.set_seq(seq++);
+            keep(tmpl.render(out.data()));
+        }));
+    }
+
+    for (size_t payload : payload_sizes) {
+        const std::string bytes(payload, 'x');
+        const auto cfg = config_with_payload(bytes);
+
+        for (size_t batch : batch_lengths) {
+            print("build_packet_batch", payload, batch, measure(batch, [&] {
+                keep(PacketBuilder::build_packet_batch(cfg, batch));
+            }));
+
+            PacketBuilder::BatchSlab slab(batch);
+            PacketBuilder::PacketTemplate tmpl(cfg);
+            print("slab/put_sequence", payload, batch, measure(batch, [&] {
+                slab.put_sequence(0, tmpl, cfg.seq, static_cast<uint32_t>(payload), batch);
+                keep(slab.msgs());
+            }));
+        }
+    }
+
+    // ####################################################################################
+    // # Region: Message Vectors
+    // ####################################################################################
+
+    for (size_t batch : batch_lengths) {
+        PacketBuilder::PacketBatch packets;
+        packets.probe1 = PacketBuilder::build_packet(PacketBuilder::Defaults::probe_config(1));
+        packets.spoofed = PacketBuilder::build_packet_batch(PacketBuilder::Defaults::spoof_config(), batch);
+        packets.probe2 = PacketBuilder::build_packet(PacketBuilder::Defaults::probe_config(2));
+
+        print("PacketBatch::to_mmsg", 0, batch + 2, measure(batch + 2, [&] {
+            std::vector<iovec> iovecs;
+            keep(packets.to_mmsg(iovecs));
+        }));
+    }
+
+    // ####################################################################################
+    // # Region: Send
+    // ####################################################################################
+
+    sockaddr_in dest{};
+    dest.sin_family = AF_INET;
+    dest.sin_port = htons(sink_port);
+    const auto dst = PacketBuilder::parse_ipv4(dst_ip);
+    if (!dst || inet_pton(AF_INET, dst_ip.c_str(), &dest.sin_addr) != 1) {
+        std::cerr << "Invalid destination " << dst_ip << "\n";
+        return 1;
+    }
+
+    Sender::RawSocket sender(iface);
+    if (!sender.valid()) {
+        std::cerr << "\nSkipping sendmmsg benchmarks: no raw socket on " << iface << " (needs CAP_NET_RAW)\n";
+        return 0;
+    }
+
+    std::cout << "\nsendmmsg on " << iface << " to " << dst_ip << "\n";
+    for (size_t payload : payload_sizes) {
+        const std::string bytes(payload, 'x');
+        auto cfg = config_with_payload(bytes);
+        cfg.src_ip = *dst;
+        cfg.dst_ip = *dst;
+        cfg.dst_port = sink_port;
+
+        for (size_t batch : batch_lengths) {
+            PacketBuilder::BatchSlab slab(batch);
+            slab.set_destination(dest);
+            PacketBuilder::PacketTemplate tmpl(cfg);
+            slab.put_sequence(0, tmpl, cfg.seq, static_cast<uint32_t>(payload), batch);
+
+            size_t failures = 0;
+            const Result result = measure(batch, [&] {
+                if (sender.send(slab) != static_cast<int>(batch)) failures++;
+            });
+            print("sendmmsg", payload, batch, result);
+            if (failures) {
+                std::cerr << "  " << failures << " short or failed sendmmsg calls\n";
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,182 @@
+/*######################################################################################################
+# Experiment: Pcap Replay
+# Description: Replay a captured or rendered pcap/pcapng file on a raw socket, at the recorded timing,
+#              scaled, or as fast as possible, sending straight out of the file mapping
+######################################################################################################*/
+
+#include "pcap.hpp"
+#include "sender.hpp"
+#include "timing.hpp"
+#include "default.hpp"
+
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// ########################################################################################
+// # Region: Configuration
+// ########################################################################################
+
+// Usage: PcapReplay <file> [speed] [iface]
+//   speed: 1 replays at the recorded timing, 2 twice as fast, 0.5 at half speed, max back to back
+const std::string default_speed = "1";
+const size_t num_loops = 1;
+// Frames recorded within this window of a batch's first frame leave in the same sendmmsg,
+// so their relative gaps collapse to whatever the kernel makes of back to back sends
+const uint64_t batch_window_ns = 10000;
+const size_t max_batch = 256;
+
+// ########################################################################################
+// # Region: Schedule
+// ########################################################################################
+
+struct Batch {
+    size_t first;
+    size_t count;
+    uint64_t offset_ns;     // release time after the first frame, already scaled
+};
+
+// One mmsghdr per frame whose iovec points into the mapping, destination taken from the
+// IP header since raw sockets still want one with IP_HDRINCL
+struct Schedule {
+    std::vector<sockaddr_in> destinations;
+    std::vector<iovec> iovecs;
+    std::vector<mmsghdr> msgs;
+    std::vector<Batch> batches;
+};
+
+Schedule build_schedule(const std::vector<Pcap::Frame>& p_frames, double p_speed) {
+    Schedule schedule;
+    const size_t n = p_frames.size();
+    schedule.destinations.resize(n);
+    schedule.iovecs.resize(n);
+    schedule.msgs.resize(n);
+
+    for (size_t i = 0; i < n; ++i) {
+        const auto& packet = p_frames[i].packet;
+        auto& dest = schedule.destinations[i];
+        dest.sin_family = AF_INET;
+        std::memcpy(&dest.sin_addr, packet.data() + offsetof(iphdr, daddr), sizeof(dest.sin_addr));
+
+        schedule.iovecs[i] = { const_cast<char*>(packet.data()), packet.size() };
+        auto& hdr = schedule.msgs[i].msg_hdr;
+        hdr.msg_name = &dest;
+        hdr.msg_namelen = sizeof(dest);
+        hdr.msg_iov = &schedule.iovecs[i];
+        hdr.msg_iovlen = 1;
+    }
+
+    // Captures are not guaranteed to be time ordered, never schedule before the start
+    const uint64_t origin = n ? p_frames[0].timestamp_ns : 0;
+    for (size_t i = 0; i < n;) {
+        const uint64_t batch_start = p_frames[i].timestamp_ns;
+        size_t count = 1;
+        while (i + count < n && count < max_batch &&
+               (p_speed <= 0 || p_frames[i + count].timestamp_ns - batch_start <= batch_window_ns)) {
+            count++;
+        }
+        const uint64_t offset = batch_start > origin ? batch_start - origin : 0;
+        schedule.batches.push_back({ i, count,
+                                     p_speed > 0 ? static_cast<uint64_t>(static_cast<double>(offset) / p_speed) : 0 });
+        i += count;
+    }
+    return schedule;
+}
+
+// ########################################################################################
+// # Region: Main
+// ########################################################################################
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <file> [speed|max] [iface]\n";
+        return 1;
+    }
+    const std::string path = argv[1];
+    const std::string speed_arg = argc > 2 ? argv[2] : default_speed;
+    const std::string iface = argc > 3 ? argv[3] : std::string(Connection::Defaults::iface);
+
+    // 0 means as fast as possible
+    double speed = 0;
+    if (speed_arg != "max") {
+        speed = std::strtod(speed_arg.c_str(), nullptr);
+        if (!(speed > 0)) {
+            std::cerr << "Invalid speed " << speed_arg << "\n";
+            return 1;
+        }
+    }
+
+    // ####################################################################################
+    // # Region: Load Capture
+    // ####################################################################################
+
+    const auto parse_start = std::chrono::steady_clock::now();
+    Pcap::Reader reader(path);
+    if (!reader.valid()) return 1;
+    Schedule schedule = build_schedule(reader.frames(), speed);
+    const auto parse_end = std::chrono::steady_clock::now();
+
+    const double parse_s = std::chrono::duration<double>(parse_end - parse_start).count();
+    std::cout << Pcap::LOG_TAG << " " << path << ": " << reader.frames().size() << " IPv4 frames ("
+              << reader.skipped() << " skipped) in " << schedule.batches.size() << " batches, indexed in "
+              << parse_s * 1e3 << " ms (" << static_cast<double>(reader.file_bytes()) / parse_s / 1e6 << " MB/s)\n";
+    if (schedule.msgs.empty()) return 1;
+
+    // ####################################################################################
+    // # Region: Setup Sender
+    // ####################################################################################
+
+    const int fd = Sender::setup_raw_socket(iface);
+    if (fd < 0) return 1;
+
+    // ####################################################################################
+    // # Region: Replay
+    // ####################################################################################
+
+    Timing::Pacer pacer(0);
+    size_t sent = 0, sent_bytes = 0, errors = 0;
+    const auto start = std::chrono::steady_clock::now();
+
+    for (size_t loop = 0; loop < num_loops; ++loop) {
+        pacer.start();
+        for (const Batch& batch : schedule.batches) {
+            if (speed > 0) pacer.wait_until(batch.offset_ns);
+
+            mmsghdr* msgs = schedule.msgs.data() + batch.first;
+            size_t remaining = batch.count;
+            while (remaining > 0) {
+                int rc = sendmmsg(fd, msgs, static_cast<unsigned>(remaining), 0);
+                if (rc < 0) {
+                    if (errno == EINTR) continue;
+                    // Drop the message that failed and carry on with the rest of the batch
+                    if (errors++ == 0) perror("sendmmsg");
+                    rc = 1;
+                } else {
+                    sent += static_cast<size_t>(rc);
+                    for (int i = 0; i < rc; i++) sent_bytes += msgs[i].msg_hdr.msg_iov->iov_len;
+                }
+                msgs += rc;
+                remaining -= static_cast<size_t>(rc);
+            }
+        }
+    }
+
+    const double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    // Only frames the kernel accepted count, dropped ones would overstate the rate
+    const double bytes = static_cast<double>(sent_bytes);
+    std::cout << "Sent " << sent << " packets, " << errors << " errors in " << elapsed_s << " s: "
+              << static_cast<double>(sent) / elapsed_s << " packets/s, " << bytes * 8 / elapsed_s / 1e9 << " Gbit/s\n";
+    if (speed > 0) std::cout << pacer.report();
+
+    close(fd);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,143 @@
+/*######################################################################################################
+# Experiment: Single Queue Plan Runner
+# Description: Compile the single queue experiment ahead of time into a plan file (scenarios from a
+#              seeded PRNG, every frame, a batch index) and send it by walking the mapping
+######################################################################################################*/
+
+#include "plan.hpp"
+#include "sender.hpp"
+#include "timing.hpp"
+#include "client.hpp"
+#include "default.hpp"
+
+#include <unistd.h>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+
+// ########################################################################################
+// # Region: Configuration
+// ########################################################################################
+
+// Usage: PlanRunner <plan> [seed]           connect, compile with the live seq/ack, send
+//        PlanRunner compile <plan> [seed]   compile with the default seq/ack, no root needed
+//        PlanRunner run <plan>              send a plan compiled before
+const uint64_t default_seed = 1;
+const size_t num_iterations = 1000;
+const size_t seq_length = 16;
+const std::string_view payload = "ABC";
+const double in_connection_ratio = 0.5;
+const double batch_rate = 100.0;    // batches per second
+
+// ########################################################################################
+// # Region: Compile
+// ########################################################################################
+
+bool compile(const std::string& p_path, uint64_t p_seed, uint32_t p_seq, uint32_t p_ack) {
+    auto non_spoof_cfg = PacketBuilder::Defaults::probe_config();
+    auto spoof_cfg = PacketBuilder::Defaults::spoof_config();
+    spoof_cfg.seq = non_spoof_cfg.seq = p_seq;
+    spoof_cfg.ack = non_spoof_cfg.ack = p_ack;
+    spoof_cfg.payload = non_spoof_cfg.payload = payload;
+    spoof_cfg.psh = non_spoof_cfg.psh = !payload.empty();
+
+    const auto start = std::chrono::steady_clock::now();
+    const bool ok = Plan::compile(Plan::Spec{
+        .seed = p_seed,
+        .iterations = num_iterations,
+        .seq_length = seq_length,
+        .in_connection_ratio = in_connection_ratio,
+        .batch_rate = batch_rate,
+        .spoof = spoof_cfg,
+        .non_spoof = non_spoof_cfg,
+        .probe1 = PacketBuilder::Defaults::probe_packet<1>.view(),
+        .probe2 = PacketBuilder::Defaults::probe_packet<2>.view()
+    }, p_path);
+    const auto end = std::chrono::steady_clock::now();
+
+    if (ok) {
+        std::cout << Plan::LOG_TAG << " Compiled " << num_iterations << " batches (seed " << p_seed << ", seq="
+                  << p_seq << ", ack=" << p_ack << ") to " << p_path << " in "
+                  << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " µs\n";
+    }
+    return ok;
+}
+
+// ########################################################################################
+// # Region: Run
+// ########################################################################################
+
+bool run(const std::string& p_path) {
+    Plan::File plan(p_path);
+    if (!plan.valid()) return false;
+
+    int fd = Sender::setup_raw_socket(Connection::Defaults::iface);
+    if (fd < 0) return false;
+
+    const auto batches = plan.batches();
+    size_t in_connection = 0;
+    for (const auto& batch : batches) {
+        in_connection += batch.in_connection;
+    }
+    std::cout << Plan::LOG_TAG << " Sending " << batches.size() << " batches (" << in_connection
+              << " in connection, seed " << plan.header().seed << ") from " << p_path << "\n";
+
+    // Nothing but pacing and one sendmmsg per batch, everything else is in the plan
+    uint64_t sent = 0, errors = 0;
+    Timing::Pacer pacer(plan.header().gap_ns);
+    pacer.start();
+    for (size_t i = 0; i < batches.size(); ++i) {
+        pacer.wait();
+        const int n = plan.send(fd, i);
+        if (n < 0) {
+            errors++;
+        } else {
+            sent += static_cast<uint64_t>(n);
+        }
+    }
+    close(fd);
+
+    std::cout << pacer.report();
+    std::cout << Plan::LOG_TAG << " Sent " << sent << "/" << plan.header().frames << " packets, " << errors
+              << " failed batches\n";
+    return errors == 0;
+}
+
+// ########################################################################################
+// # Region: Main
+// ########################################################################################
+
+int main(int argc, char** argv) {
+    const std::string mode = argc > 1 ? argv[1] : "";
+    if (argc < 2 || ((mode == "compile" || mode == "run") && argc < 3)) {
+        std::cerr << "Usage: " << argv[0] << " <plan> [seed]\n"
+                  << "       " << argv[0] << " compile <plan> [seed]\n"
+                  << "       " << argv[0] << " run <plan>\n";
+        return 1;
+    }
+
+    if (mode == "run") {
+        return run(argv[2]) ? 0 : 1;
+    }
+
+    if (mode == "compile") {
+        const uint64_t seed = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : default_seed;
+        return compile(argv[2], seed, PacketBuilder::Defaults::base_seq, PacketBuilder::Defaults::base_ack) ? 0 : 1;
+    }
+
+    // The plan fixes seq/ack at compile time, so the connection is only needed for its state
+    const std::string path = argv[1];
+    const uint64_t seed = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : default_seed;
+    Connection::TCPClient client;
+    if (!client.extended_connect()) {
+        std::cerr << "Failed to connect to server." << std::endl;
+        return 1;
+    }
+    auto [base_seq, base_ack] = client.server_state();
+    if (!compile(path, seed, base_seq, base_ack)) return 1;
+    return run(path) ? 0 : 1;
+}
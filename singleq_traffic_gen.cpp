@@ -4,7 +4,16 @@
 ######################################################################################################*/
 
 #include "packetbuilder.hpp"
+#include "sender.hpp"
+#include "uring.hpp"
+#include "timing.hpp"
+#include "txstamp.hpp"
+#include "txtime.hpp"
 #include "client.hpp"
+#include "pcap.hpp"
+#include "spsc.hpp"
+#include "plan.hpp"
+#include "trace.hpp"
 #include "default.hpp"
 
 #include <netinet/in.h>
@@ -13,6 +22,12 @@
 #include <chrono>
 #include <arpa/inet.h>
 #include <cstring>
+#include <cerrno>
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <ctime>
+#include <thread>
 
 // ########################################################################################
 // # Region: Configuration
@@ -20,34 +35,62 @@
 
 const size_t num_iterations = 1000;
 const size_t seq_length = 16;
-const std::string payload = "ABC";
+const std::string_view payload = "ABC";
+const bool use_hugepages = false;
+const Sender::Type backend = Sender::Type::RAW_SOCKET;
+// io_uring backend: a kernel thread polls the submission queue (SQPOLL), so a submit needs no
+// syscall. With uring_async a batch is only submitted and its completions are reaped after the
+// next pacer release, right before the slab is rebuilt, instead of being waited for in the send.
+const bool uring_sqpoll = false;
+const int uring_sqpoll_cpu = -1;    // pin the polling thread, -1 leaves it to the scheduler
+const bool uring_async = false;     // needs pipeline off, its slots are reused once popped
+const double batch_rate = 100.0;    // batches per second
+// Scenario choice per batch, the same seed gives the same in/out-of-connection sequence
+// (PlanRunner compiles a whole run ahead of time from it)
+const uint64_t seed = 1;
+// Follow the connection on the wire so seq/ack stay current over long runs
+const bool track_state = true;
+// Per-packet departure times from SO_TIMESTAMPING, written next to the summary when a path is set
+const bool tx_timestamps = true;
+const std::string tx_timestamps_path = "tx_timestamps.csv";
+// Launch times: every packet carries an SCM_TXTIME and the ETF qdisc on the interface releases it
+// then (Testbed has an etf option). Batch i launches txtime_lead_ns after the pacer's deadline i,
+// its packets at the gaps below, so neither depends on when sendmmsg runs. Raw socket and io_uring.
+const bool txtime = false;
+const uint64_t txtime_lead_ns = 500000;     // covers the ETF delta and the sender's wakeup jitter
+const uint64_t spoofed_lead_ns = 10000;     // probe1 -> first spoofed
+const uint64_t spoofed_spacing_ns = 1000;   // between spoofed packets
+const uint64_t probe2_lead_ns = 10000;      // last spoofed -> probe2
+// Without tx_timestamps nothing else reads the error queue: drain the qdisc's drop reports every
+// this many batches, before they fill the socket's receive buffer and later ones are discarded
+const size_t txtime_drain_interval = 4;
+// Render to file: write every batch with its intended send time to this pcapng instead of
+// sending it. Needs neither the server nor root; batches are rendered back to back.
+const std::string render_path = "";
+// Build batches on a producer thread and hand them to a pinned sender thread through an
+// SPSC ring, so only sendmmsg sits between two pacer releases
+const bool pipeline = false;
+const size_t pipeline_depth = 8;    // batches the producer may run ahead
+const int producer_cpu = 0;
+const int sender_cpu = 1;
+// Per-batch trace (scenario, seq/ack, TSC around the send, result) written as .npy columns to
+// this directory by a background thread, empty disables it. Nothing is printed per batch.
+const std::string trace_dir = "trace_singleq";
 
 // ########################################################################################
-// # Region: Initialize Sender Socket
+// # Region: Batches
 // ########################################################################################
 
-int setup_raw_socket(const std::string_view p_iface) {
-    int sock = socket(AF_INET, SOCK_RAW, IPPROTO_RAW);
-    if (sock < 0) {
-        perror("socket");
-        return -1;
-    }
-
-    if (setsockopt(sock, SOL_SOCKET, SO_BINDTODEVICE, p_iface.data(), p_iface.size() + 1) < 0) {
-        perror("setsockopt(SO_BINDTODEVICE)");
-        close(sock);
-        return -1;
-    }
-
-    int opt = 1;
-    if (setsockopt(sock, IPPROTO_IP, IP_HDRINCL, &opt, sizeof(opt)) < 0) {
-        perror("setsockopt(IP_HDRINCL)");
-        close(sock);
-        return -1;
-    }
+// One batch ready to send, plus what it was built from for the per-batch trace record
+struct Burst {
+    PacketBuilder::BatchSlab batch;
+    bool in_connection = false;
+    uint32_t seq = 0;
+    uint32_t ack = 0;
 
-    return sock;
-}
+    Burst(size_t p_slots, bool p_hugepages)
+        : batch(p_slots, PacketBuilder::BatchSlab::default_stride, p_hugepages) {}
+};
 
 // ########################################################################################
 // # Region: Main
@@ -59,20 +102,30 @@ int main() {
     // # Region: Initialize Client (Optional)
     // ####################################################################################
 
-    Connection::TCPClient client;
-    if (!client.extended_connect()) {
-        std::cerr << "Failed to connect to server." << std::endl;
-        return 1;
-    }
+    const bool render = !render_path.empty();
 
-    auto [base_seq, base_ack] = client.server_state();
+    // Rendering uses the default seq/ack, there is no connection to take them from
+    std::optional<Connection::TCPClient> client;
+    uint32_t base_seq = PacketBuilder::Defaults::base_seq;
+    uint32_t base_ack = PacketBuilder::Defaults::base_ack;
+
+    if (!render) {
+        client.emplace();
+        if (!client->extended_connect()) {
+            std::cerr << "Failed to connect to server." << std::endl;
+            return 1;
+        }
+
+        std::tie(base_seq, base_ack) = client->server_state();
+        if (track_state && !client->start_tracking()) {
+            std::cerr << "Failed to track connection state, extrapolating seq instead." << std::endl;
+        }
+    }
 
     // ####################################################################################
     // # Region: Packet Configuration
     // ####################################################################################
 
-    auto probe1_cfg = PacketBuilder::Defaults::probe_config(1);
-    auto probe2_cfg = PacketBuilder::Defaults::probe_config(2);
     auto non_spoof_cfg = PacketBuilder::Defaults::probe_config();
     auto spoof_cfg = PacketBuilder::Defaults::spoof_config();
     spoof_cfg.seq = non_spoof_cfg.seq = base_seq;
@@ -84,65 +137,270 @@ int main() {
                                 std::max(static_cast<uint32_t>(payload.size()), 1u) : 0;
 
     // ####################################################################################
-    // # Region: Setup Socket
+    // # Region: Setup Sender
     // ####################################################################################
 
-    int sock = setup_raw_socket(Connection::Defaults::iface);
-    if (sock < 0) return 1;
-
     sockaddr_in dest_addr{};
     dest_addr.sin_family = AF_INET;
     dest_addr.sin_port = htons(Connection::Defaults::dst_port);
 
     if (inet_pton(AF_INET, Connection::Defaults::server_ip.data(), &dest_addr.sin_addr) <= 0) {
         perror("inet_pton");
-        close(sock);
         return 1;
     }
 
+    std::unique_ptr<Sender::Backend> sender;
+    std::optional<Pcap::Writer> writer;
+    if (render) {
+        writer.emplace(render_path);
+        if (!writer->valid()) return 1;
+    } else {
+        sender = Sender::create(backend, Connection::Defaults::iface, dest_addr,
+                                { .sqpoll = uring_sqpoll, .sqpoll_cpu = uring_sqpoll_cpu });
+        if (!sender) return 1;
+    }
+
+    // io_uring reports every packet's status, not just a count
+    Uring::Socket* uring = dynamic_cast<Uring::Socket*>(sender.get());
+    if (uring_async && sender && (!uring || pipeline)) {
+        std::cerr << Uring::LOG_TAG << " Asynchronous submission needs the io_uring backend without the pipeline." << std::endl;
+        return 1;
+    }
+
+    std::vector<uint64_t> launch_offsets;
+    if (txtime && sender) {
+        if (backend != Sender::Type::RAW_SOCKET && backend != Sender::Type::IO_URING) {
+            std::cerr << TxTime::LOG_TAG << " Launch times need the raw socket or io_uring backend." << std::endl;
+            return 1;
+        }
+        if (!TxTime::enable(sender->fd())) return 1;
+        const TxTime::Segment segments[] = {
+            { 1 },
+            { seq_length, spoofed_lead_ns, spoofed_spacing_ns },
+            { 1, probe2_lead_ns }
+        };
+        launch_offsets = TxTime::offsets(segments);
+    }
+
     // ####################################################################################
-    // # Region: Traffic Generation
+    // # Region: Batch Preparation
     // ####################################################################################
-    
-    for (size_t i = 0; i < num_iterations; ++i) {
-        bool in_connection = std::rand() % 2 == 0;
-        auto& current_cfg = in_connection ? spoof_cfg : non_spoof_cfg;
 
-        PacketBuilder::PacketBatch batch = {
-            .probe1 = build_packet(probe1_cfg),
-            .spoofed = build_packet_batch(current_cfg, seq_length),
-            .probe2 = build_packet(probe2_cfg)
-        };
+    PacketBuilder::PacketTemplate spoof_tmpl(spoof_cfg);
+    PacketBuilder::PacketTemplate non_spoof_tmpl(non_spoof_cfg);
 
-        std::vector<iovec> iovecs;
-        std::vector<mmsghdr> msgs = batch.to_mmsg(iovecs);
+    // Layout: [probe1 | seq_length spoofed | probe2], probes never change
+    auto init_burst = [&](Burst& p_burst) {
+        p_burst.batch.set_destination(dest_addr);
+        p_burst.batch.put(0, PacketBuilder::Defaults::probe_packet<1>.view());
+        p_burst.batch.put(seq_length + 1, PacketBuilder::Defaults::probe_packet<2>.view());
+        if (!launch_offsets.empty()) p_burst.batch.enable_txtime();
+        return p_burst.batch.valid();
+    };
 
-        for (auto& msg : msgs) {
-            msg.msg_hdr.msg_name = &dest_addr;
-            msg.msg_hdr.msg_namelen = sizeof(dest_addr);
+    std::unique_ptr<Burst> single;
+    std::unique_ptr<Spsc::Ring<Burst>> ring;
+    if (pipeline && !render) {
+        ring = std::make_unique<Spsc::Ring<Burst>>(pipeline_depth, seq_length + 2, use_hugepages);
+        for (size_t s = 0; s < ring->capacity(); ++s) {
+            if (!init_burst(ring->slot(s))) return 1;
         }
+    } else {
+        single = std::make_unique<Burst>(seq_length + 2, use_hugepages);
+        if (!init_burst(*single)) return 1;
+    }
 
-        auto start = std::chrono::steady_clock::now();
-        int sent = sendmmsg(sock, msgs.data(), msgs.size(), 0);
-        auto end = std::chrono::steady_clock::now();
+    std::unique_ptr<TxStamp::Recorder> stamps;
+    if (tx_timestamps && sender) {
+        stamps = std::make_unique<TxStamp::Recorder>(sender->fd(), Connection::Defaults::iface,
+            TxStamp::Layout{ {"probe1", 1}, {"spoofed", seq_length}, {"probe2", 1} }, num_iterations);
+        if (!stamps->valid()) stamps.reset();
+    }
 
-        if (sent < 0) {
-            perror("sendmmsg");
+    std::unique_ptr<Trace::Recorder> trace;
+    Trace::Stream* trace_stream = nullptr;
+    if (!trace_dir.empty() && !render) {
+        trace = std::make_unique<Trace::Recorder>(trace_dir);
+        if (trace->valid()) {
+            trace_stream = &trace->stream();
         } else {
-            std::cout << "Batch " << (i + 1) << ": Sent " << sent << " packets, "
-                      << "type=" << (in_connection ? "IN-CONNECTION" : "OUT-OF-CONNECTION") << ", "
-                      << "seq=" << current_cfg.seq << ", ack=" << current_cfg.ack << ", ∆t="
-                      << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()
-                      << " µs\n";
+            trace.reset();
         }
+    }
+
+    // ####################################################################################
+    // # Region: Traffic Generation
+    // ####################################################################################
+    
+    auto pacer = Timing::Pacer::from_rate(batch_rate);
+    pacer.start();
+    const uint64_t launch_start_ns = TxTime::now() + txtime_lead_ns;
+
+    timespec render_start{};
+    clock_gettime(CLOCK_REALTIME, &render_start);
+    const uint64_t render_start_ns = static_cast<uint64_t>(render_start.tv_sec) * 1000000000ULL + render_start.tv_nsec;
+
+    Plan::Xoshiro256 rng(seed);
+
+    // Fill the spoofed slots, only ever called from one thread at a time
+    auto prepare = [&](Burst& p_burst) {
+        bool in_connection = rng.bernoulli(0.5);
+        auto& current_cfg = in_connection ? spoof_cfg : non_spoof_cfg;
+        auto& current_tmpl = in_connection ? spoof_tmpl : non_spoof_tmpl;
+
+        if (in_connection && client) {
+            // Local extrapolation covers our own segments the tracker has not seen yet
+            auto [live_seq, live_ack] = client->server_state();
+            spoof_cfg.seq = Connection::seq_max(spoof_cfg.seq, live_seq);
+            if (live_ack != spoof_cfg.ack) {
+                spoof_cfg.ack = live_ack;
+                spoof_tmpl.set_ack(live_ack);
+            }
+        }
+
+        p_burst.batch.put_sequence(1, current_tmpl, current_cfg.seq,
+                                   static_cast<uint32_t>(current_cfg.payload.size()), seq_length);
+        p_burst.in_connection = in_connection;
+        p_burst.seq = current_cfg.seq;
+        p_burst.ack = current_cfg.ack;
 
         if(in_connection) {
             spoof_cfg.seq += delta_seq * seq_length;
         }
+    };
+
+    // Per-batch bookkeeping once the batch's result is known
+    auto account = [&](const Burst& p_burst, size_t p_iteration, uint64_t p_start, uint64_t p_end,
+                       int p_sent, int p_error) {
+        // p_error with p_sent >= 0: some packets of the batch failed, io_uring only
+        if (p_error) std::cerr << "send: " << strerror(p_error) << "\n";
+        if (p_sent >= 0 && stamps) stamps->sent(static_cast<size_t>(p_sent));
+        if (trace_stream) {
+            trace_stream->record({
+                .batch = p_iteration,
+                .tsc_start = p_start,
+                .tsc_end = p_end,
+                .seq = p_burst.seq,
+                .ack = p_burst.ack,
+                .sent = p_sent,
+                .error = p_error,
+                .scenario = p_burst.in_connection
+            });
+        }
+    };
 
-        std::this_thread::sleep_for(std::chrono::microseconds(10000));
+    // uring_async: the batch submitted last, its slab untouched until complete() reaped it
+    struct Submitted {
+        const Burst* burst;
+        size_t iteration;
+        uint64_t start;
+        uint64_t end;
+    };
+    std::optional<Submitted> submitted;
+
+    auto complete = [&] {
+        if (!submitted) return;
+        uring->reap(uring->in_flight());
+        account(*submitted->burst, submitted->iteration, submitted->start, submitted->end,
+                static_cast<int>(uring->sent()), uring->error());
+        submitted.reset();
+    };
+
+    // Launch time drops reported so far, when the TxStamp recorder is not there to count them
+    const bool count_txtime = !launch_offsets.empty() && !stamps;
+    TxTime::Errors txtime_errors;
+    auto drain_txtime = [&] {
+        const auto errors = TxTime::drain_errors(sender->fd());
+        txtime_errors.missed += errors.missed;
+        txtime_errors.invalid += errors.invalid;
+    };
+
+    auto transmit = [&](Burst& p_burst, size_t p_iteration) {
+        if (render) {
+            // Stamped with the deadline the pacer would have released the batch at
+            writer->write(p_burst.batch, render_start_ns + p_iteration * pacer.gap_ns());
+            return;
+        }
+
+        if (!launch_offsets.empty()) {
+            TxTime::stamp(p_burst.batch, launch_start_ns + p_iteration * pacer.gap_ns(), launch_offsets);
+        }
+
+        const uint64_t start = Timing::rdtsc();
+        if (uring_async) {
+            const size_t queued = uring->submit(p_burst.batch);
+            const uint64_t end = Timing::rdtsc();
+            if (queued == 0 && p_burst.batch.size() > 0) {
+                account(p_burst, p_iteration, start, end, -1, errno);
+            } else {
+                submitted = Submitted{ &p_burst, p_iteration, start, end };
+            }
+            return;
+        }
+
+        int sent = sender->send(p_burst.batch);
+        const uint64_t end = Timing::rdtsc();
+        account(p_burst, p_iteration, start, end, sent, sent < 0 ? errno : uring ? uring->error() : 0);
+    };
+
+    if (ring) {
+        std::jthread producer([&] {
+            Timing::pin_thread(producer_cpu);
+            for (size_t i = 0; i < num_iterations; ++i) {
+                prepare(ring->acquire());
+                ring->publish();
+            }
+            ring->close();
+        });
+
+        Timing::pin_thread(sender_cpu);
+        for (size_t i = 0; i < num_iterations; ++i) {
+            pacer.wait();
+            Burst* burst = ring->front();
+            if (!burst) break;
+            transmit(*burst, i);
+            ring->pop();
+            if (count_txtime && (i + 1) % txtime_drain_interval == 0) drain_txtime();
+        }
+    } else {
+        for (size_t i = 0; i < num_iterations; ++i) {
+            if (!render) pacer.wait();
+            complete();
+            prepare(*single);
+            transmit(*single, i);
+            if (count_txtime && (i + 1) % txtime_drain_interval == 0) drain_txtime();
+        }
+        complete();
+    }
+
+    if (render) {
+        std::cout << Pcap::LOG_TAG << " Rendered " << writer->packets() << " packets ("
+                  << writer->bytes() << " bytes) to " << render_path << "\n";
+        return writer->close() ? 0 : 1;
     }
 
-    close(sock);
+    std::cout << pacer.report();
+    if (ring) std::cout << ring->stats();
+    if (trace) {
+        trace_stream->close();
+        trace->stop();
+        std::cout << Trace::LOG_TAG << " Wrote " << trace->records() << " batches to " << trace->dir() << "/ ("
+                  << trace->dropped() << " dropped)\n";
+    }
+    if (count_txtime) {
+        // The recorder counts these itself when it runs. Wait out the last launch times first.
+        std::this_thread::sleep_for(std::chrono::nanoseconds(txtime_lead_ns + probe2_lead_ns +
+                                                             spoofed_lead_ns + seq_length * spoofed_spacing_ns));
+        drain_txtime();
+        std::cout << TxTime::LOG_TAG << " Dropped by the qdisc: " << txtime_errors.missed << " launch times missed, "
+                  << txtime_errors.invalid << " invalid\n";
+    }
+    if (stamps) {
+        stamps->stop();
+        std::cout << stamps->report();
+        if (!tx_timestamps_path.empty() && stamps->write_csv(tx_timestamps_path)) {
+            std::cout << TxStamp::LOG_TAG << " Wrote " << tx_timestamps_path << "\n";
+        }
+    }
     return 0;
 }
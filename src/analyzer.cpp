@@ -0,0 +1,242 @@
+#include "analyzer.hpp"
+#include <algorithm>
+
+namespace Analyzer {
+
+    static constexpr uint8_t PROBE1 = 0;
+    static constexpr uint8_t SPOOFED = 1;
+    static constexpr uint8_t PROBE2 = 2;
+
+    Stream::Stream(const BurstLayout& p_layout, size_t p_displacement_threshold)
+        : m_layout(p_layout), m_threshold(p_displacement_threshold) {
+        // Room for every packet twice over before a burst is forced closed
+        m_arrivals.reserve(2 * m_layout.size());
+        m_order.reserve(m_layout.size());
+        m_rank.resize(m_layout.size());
+        m_seen.resize(m_layout.size());
+        m_totals.displacement.assign(2 * m_threshold + 1, 0);
+    }
+
+    void Stream::expect(uint32_t p_first_seq) {
+        if (m_expected.size() == max_expected) m_expected.pop_front();
+        m_expected.push_back(p_first_seq);
+    }
+
+    std::optional<BurstResult> Stream::add(const Capture::Record& p_record) {
+        uint8_t kind;
+        if (p_record.src_port == m_layout.probe1_port) {
+            kind = PROBE1;
+        } else if (p_record.src_port == m_layout.probe2_port) {
+            kind = PROBE2;
+        } else if (static_cast<uint16_t>(p_record.src_port - m_layout.spoof_port) < m_layout.spoof_ports ||
+                   p_record.src_port == m_layout.attacker_port) {
+            kind = SPOOFED;
+        } else {
+            m_totals.unmatched++;
+            return std::nullopt;
+        }
+
+        std::optional<BurstResult> closed;
+        if (!m_arrivals.empty() && (p_record.timestamp_ns > m_last_ns + m_layout.burst_gap_ns ||
+                                    m_arrivals.size() == m_arrivals.capacity() ||
+                                    (kind == PROBE1 && m_has_probe1))) {
+            closed = close();
+        }
+
+        m_arrivals.push_back(Arrival{ kind, p_record.seq, p_record.timestamp_ns });
+        m_has_probe1 |= kind == PROBE1;
+        m_attacker |= p_record.src_port == m_layout.attacker_port;
+        m_last_ns = p_record.timestamp_ns;
+        return closed;
+    }
+
+    std::optional<BurstResult> Stream::flush() {
+        if (m_arrivals.empty()) return std::nullopt;
+        return close();
+    }
+
+    BurstResult Stream::close() {
+        const size_t size = m_layout.size();
+        BurstResult result;
+        result.index = m_next_index++;
+        result.first_ns = m_arrivals.front().timestamp_ns;
+
+        // Sent seq of slot 1, so a lost first spoofed packet does not shift the others.
+        // Without one the lowest spoofed seq received stands in, wrap-around aware.
+        const std::optional<uint32_t> expected = expected_base();
+        uint32_t base = expected.value_or(0);
+        bool has_base = expected.has_value();
+        for (const auto& arrival : m_arrivals) {
+            if (expected || arrival.kind != SPOOFED) continue;
+            if (!has_base || static_cast<int32_t>(arrival.seq - base) < 0) base = arrival.seq;
+            has_base = true;
+        }
+
+        // Send position of every distinct arrival, duplicates and strangers dropped
+        std::fill(m_seen.begin(), m_seen.end(), 0);
+        m_order.clear();
+        size_t spoofed_seen = 0;
+        size_t probe1_at = SIZE_MAX, probe2_at = SIZE_MAX;
+        for (const auto& arrival : m_arrivals) {
+            size_t position;
+            if (arrival.kind == PROBE1) {
+                position = 0;
+            } else if (arrival.kind == PROBE2) {
+                position = size - 1;
+            } else if (m_layout.delta_seq) {
+                const uint32_t offset = arrival.seq - base;
+                const size_t k = offset / m_layout.delta_seq;
+                if (offset % m_layout.delta_seq || k >= m_layout.spoofed) {
+                    m_totals.unmatched++;
+                    continue;
+                }
+                position = 1 + k;
+            } else {
+                position = 1 + spoofed_seen++;
+                if (position >= size - 1) {
+                    m_totals.unmatched++;
+                    continue;
+                }
+            }
+
+            if (m_seen[position]) {
+                result.duplicates++;
+                continue;
+            }
+            m_seen[position] = 1;
+            if (position == 0) probe1_at = m_order.size();
+            if (position == size - 1) probe2_at = m_order.size();
+            m_order.push_back(position);
+        }
+        result.received = m_order.size();
+        result.lost = size - result.received;
+
+        // RFC 4737: reordered if below NextExp, extent back to the earliest later-sent arrival
+        size_t next_expected = 0;
+        for (size_t i = 0; i < m_order.size(); i++) {
+            const size_t position = m_order[i];
+            if (position >= next_expected) {
+                next_expected = position + 1;
+                continue;
+            }
+            result.reordered++;
+            size_t j = 0;
+            while (m_order[j] < position) j++;
+            result.max_extent = std::max(result.max_extent, i - j);
+            result.extent_sum += i - j;
+        }
+
+        // RFC 5236: displacement against the receive index, lost packets compacted out
+        // the way its RI adjustment would within the threshold
+        for (size_t position = 0, rank = 0; position < size; position++) {
+            m_rank[position] = rank;
+            rank += m_seen[position];
+        }
+        const auto threshold = static_cast<int64_t>(m_threshold);
+        for (size_t i = 0; i < m_order.size(); i++) {
+            const int64_t displacement = static_cast<int64_t>(i) - static_cast<int64_t>(m_rank[m_order[i]]);
+            if (displacement != 0) result.displaced++;
+            if (displacement >= -threshold && displacement <= threshold) {
+                m_totals.displacement[static_cast<size_t>(displacement + threshold)]++;
+            }
+        }
+
+        if (probe2_at != SIZE_MAX) {
+            result.probe2_before_probe1 = probe1_at != SIZE_MAX && probe2_at < probe1_at;
+            for (size_t i = probe2_at + 1; i < m_order.size(); i++) {
+                if (m_order[i] != 0) result.overtaken++;
+            }
+        }
+
+        m_totals.bursts++;
+        m_totals.received += result.received;
+        m_totals.lost += result.lost;
+        m_totals.duplicates += result.duplicates;
+        m_totals.reordered += result.reordered;
+        m_totals.extent_sum += result.extent_sum;
+        m_totals.max_extent = std::max(m_totals.max_extent, result.max_extent);
+        m_totals.probe2_before_probe1 += result.probe2_before_probe1;
+        m_totals.probe2_overtook += result.overtaken > 0;
+
+        m_arrivals.clear();
+        m_has_probe1 = false;
+        m_attacker = false;
+        return result;
+    }
+
+    bool Stream::fits(uint32_t p_base) const {
+        for (const auto& arrival : m_arrivals) {
+            if (arrival.kind != SPOOFED) continue;
+            const uint32_t offset = arrival.seq - p_base;
+            if (offset % m_layout.delta_seq == 0 && offset / m_layout.delta_seq < m_layout.spoofed) return true;
+        }
+        return false;
+    }
+
+    std::optional<uint32_t> Stream::expected_base() {
+        const bool spoofed = std::any_of(m_arrivals.begin(), m_arrivals.end(),
+                                         [](const Arrival& p_arrival) { return p_arrival.kind == SPOOFED; });
+        if (!m_expected.empty() && (!spoofed || !m_layout.delta_seq)) {
+            // Positions do not depend on it, the burst only uses up its hint
+            const uint32_t base = m_expected.front();
+            m_expected.pop_front();
+            return base;
+        }
+        if (!m_expected.empty()) {
+            // The first hint a spoofed arrival fits belongs to this burst, the ones before it
+            // to bursts that never arrived. If none fits the hints are kept for later bursts.
+            for (size_t i = 0; i < m_expected.size(); i++) {
+                if (!fits(m_expected[i])) continue;
+                const uint32_t base = m_expected[i];
+                m_expected.erase(m_expected.begin(), m_expected.begin() + static_cast<std::ptrdiff_t>(i) + 1);
+                return base;
+            }
+        }
+        if (!m_attacker || !spoofed) return std::nullopt;
+        if (m_layout.attacker_seq) return m_layout.attacker_seq;
+        for (const auto& arrival : m_arrivals) {
+            if (arrival.kind != SPOOFED) continue;
+            if (!m_attacker_base || static_cast<int32_t>(arrival.seq - *m_attacker_base) < 0) m_attacker_base = arrival.seq;
+        }
+        return m_attacker_base;
+    }
+
+    std::vector<double> Totals::density() const {
+        uint64_t sum = 0;
+        for (uint64_t count : displacement) sum += count;
+        std::vector<double> density(displacement.size(), 0);
+        for (size_t d = 0; sum && d < displacement.size(); d++) {
+            density[d] = static_cast<double>(displacement[d]) / static_cast<double>(sum);
+        }
+        return density;
+    }
+
+    std::ostream& operator<<(std::ostream& os, const BurstResult& result) {
+        os << LOG_TAG << " Burst " << result.index << ": " << result.received << " received, " << result.lost
+           << " lost, " << result.reordered << " reordered (ratio " << result.reorder_ratio() << ", max extent "
+           << result.max_extent << "), " << result.displaced << " displaced";
+        if (result.overtaken) os << ", probe2 overtook " << result.overtaken;
+        if (result.probe2_before_probe1) os << ", probe2 before probe1";
+        return os << "\n";
+    }
+
+    std::ostream& operator<<(std::ostream& os, const Totals& totals) {
+        os << LOG_TAG << " " << totals.bursts << " bursts, " << totals.received << " packets received, "
+           << totals.lost << " lost, " << totals.duplicates << " duplicates, " << totals.unmatched << " unmatched\n";
+        os << LOG_TAG << "   RFC 4737: reorder ratio " << totals.reorder_ratio() << ", mean extent "
+           << (totals.reordered ? static_cast<double>(totals.extent_sum) / static_cast<double>(totals.reordered) : 0)
+           << ", max extent " << totals.max_extent << "\n";
+        os << LOG_TAG << "   probe2 overtook spoofed packets in " << totals.probe2_overtook
+           << " bursts, arrived before probe1 in " << totals.probe2_before_probe1 << "\n";
+
+        const auto density = totals.density();
+        const auto threshold = static_cast<int64_t>(density.size() / 2);
+        os << LOG_TAG << "   RFC 5236 reorder density:";
+        for (size_t d = 0; d < density.size(); d++) {
+            if (totals.displacement[d] == 0) continue;
+            os << " " << static_cast<int64_t>(d) - threshold << ":" << density[d];
+        }
+        return os << "\n";
+    }
+
+} // namespace Analyzer
@@ -0,0 +1,246 @@
+#include "capture.hpp"
+#include <iostream>
+#include <cstring>
+#include <unistd.h>
+#include <poll.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
+#include <linux/if_ether.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+namespace Capture {
+
+    std::vector<sock_filter> Filter::compile() const {
+        std::vector<sock_filter> code;
+        std::vector<size_t> drop_if_false;  // jf patched to the drop instruction
+        std::vector<size_t> drop_if_true;   // jt patched to the drop instruction
+
+        auto require = [&](uint32_t p_value, std::vector<size_t>& p_fail) {
+            code.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, p_value, 0, 0));
+            p_fail.push_back(code.size() - 1);
+        };
+
+        // IPv4 only, the packet socket is bound to ETH_P_ALL
+        code.push_back(BPF_STMT(BPF_LD | BPF_H | BPF_ABS, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_PROTOCOL)));
+        require(ETH_P_IP, drop_if_false);
+
+        if (direction != Direction::BOTH) {
+            code.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_PKTTYPE)));
+            code.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, PACKET_OUTGOING, 0, 0));
+            (direction == Direction::OUTGOING ? drop_if_false : drop_if_true).push_back(code.size() - 1);
+        }
+
+        code.push_back(BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 9));             // ip protocol
+        require(IPPROTO_TCP, drop_if_false);
+
+        code.push_back(BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 6));             // fragment offset
+        code.push_back(BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x1FFF, 0, 0));
+        drop_if_true.push_back(code.size() - 1);
+        code.push_back(BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 0));            // X = ip header length
+
+        auto endpoints = [&](const std::optional<uint32_t>& p_src_ip, const std::optional<uint32_t>& p_dst_ip,
+                             const std::optional<uint16_t>& p_src_port, const std::optional<uint16_t>& p_dst_port,
+                             std::vector<size_t>& p_fail) {
+            if (p_src_ip) {
+                code.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 12));    // ip src
+                require(ntohl(*p_src_ip), p_fail);
+            }
+            if (p_dst_ip) {
+                code.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 16));    // ip dst
+                require(ntohl(*p_dst_ip), p_fail);
+            }
+            if (p_src_port) {
+                code.push_back(BPF_STMT(BPF_LD | BPF_H | BPF_IND, 0));     // tcp src port
+                require(*p_src_port, p_fail);
+            }
+            if (p_dst_port) {
+                code.push_back(BPF_STMT(BPF_LD | BPF_H | BPF_IND, 2));     // tcp dst port
+                require(*p_dst_port, p_fail);
+            }
+        };
+
+        if (!symmetric) {
+            endpoints(src_ip, dst_ip, src_port, dst_port, drop_if_false);
+        } else {
+            // Forward match jumps over the reversed one, a forward mismatch falls through to it
+            std::vector<size_t> try_reverse;
+            endpoints(src_ip, dst_ip, src_port, dst_port, try_reverse);
+            code.push_back(BPF_STMT(BPF_JMP | BPF_JA, 0));
+            const size_t skip = code.size() - 1;
+            for (size_t i : try_reverse) code[i].jf = static_cast<uint8_t>(code.size() - i - 1);
+            endpoints(dst_ip, src_ip, dst_port, src_port, drop_if_false);
+            code[skip].k = static_cast<uint32_t>(code.size() - skip - 1);
+        }
+
+        if (flags_mask) {
+            code.push_back(BPF_STMT(BPF_LD | BPF_B | BPF_IND, 13));        // tcp flags
+            code.push_back(BPF_STMT(BPF_ALU | BPF_AND | BPF_K, flags_mask));
+            require(flags_value & flags_mask, drop_if_false);
+        }
+
+        code.push_back(BPF_STMT(BPF_RET | BPF_K, snap_len));
+        code.push_back(BPF_STMT(BPF_RET | BPF_K, 0));
+
+        const size_t drop = code.size() - 1;
+        for (size_t i : drop_if_false) code[i].jf = static_cast<uint8_t>(drop - i - 1);
+        for (size_t i : drop_if_true) code[i].jt = static_cast<uint8_t>(drop - i - 1);
+        return code;
+    }
+
+    int open_socket(const Filter& p_filter) {
+        // Protocol 0 receives nothing until bind_socket() selects ETH_P_ALL
+        int fd = socket(AF_PACKET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            std::cerr << LOG_TAG << " Packet socket creation failed: " << strerror(errno) << "\n";
+            return -1;
+        }
+
+        std::vector<sock_filter> code = p_filter.compile();
+        sock_fprog prog{ .len = static_cast<unsigned short>(code.size()), .filter = code.data() };
+        if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0) {
+            std::cerr << LOG_TAG << " setsockopt(SO_ATTACH_FILTER) failed: " << strerror(errno) << "\n";
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    bool bind_socket(int p_fd, const std::string& p_iface) {
+        sockaddr_ll addr{};
+        addr.sll_family = AF_PACKET;
+        addr.sll_protocol = htons(ETH_P_ALL);
+
+        if (!p_iface.empty()) {
+            addr.sll_ifindex = static_cast<int>(if_nametoindex(p_iface.c_str()));
+            if (addr.sll_ifindex == 0) {
+                std::cerr << LOG_TAG << " Unknown interface " << p_iface << ": " << strerror(errno) << "\n";
+                return false;
+            }
+        }
+
+        if (bind(p_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            std::cerr << LOG_TAG << " Packet socket bind failed: " << strerror(errno) << "\n";
+            return false;
+        }
+        return true;
+    }
+
+    bool parse(const uint8_t* p_packet, size_t p_len, uint64_t p_timestamp_ns, Record& p_record) {
+        if (p_len < sizeof(iphdr)) return false;
+
+        const auto* iph = reinterpret_cast<const iphdr*>(p_packet);
+        const size_t ip_len = iph->ihl * 4UL;
+        if (iph->version != 4 || iph->protocol != IPPROTO_TCP || p_len < ip_len + sizeof(tcphdr)) {
+            return false;
+        }
+
+        const auto* tcph = reinterpret_cast<const tcphdr*>(p_packet + ip_len);
+        const size_t headers_len = ip_len + tcph->doff * 4UL;
+        const size_t tot_len = ntohs(iph->tot_len);
+
+        p_record.timestamp_ns = p_timestamp_ns;
+        p_record.src_ip = iph->saddr;
+        p_record.dst_ip = iph->daddr;
+        p_record.src_port = ntohs(tcph->source);
+        p_record.dst_port = ntohs(tcph->dest);
+        p_record.seq = ntohl(tcph->seq);
+        p_record.ack = ntohl(tcph->ack_seq);
+        p_record.payload_len = static_cast<uint16_t>(tot_len > headers_len ? tot_len - headers_len : 0);
+        p_record.flags = p_packet[ip_len + 13];
+        p_record.outgoing = 0;
+        return true;
+    }
+
+    Ring::Ring(const RingConfig& p_config)
+        : m_block_size(p_config.block_size), m_block_count(p_config.block_count) {
+
+        m_fd = open_socket(p_config.filter);
+        if (m_fd < 0) return;
+
+        int version = TPACKET_V3;
+        if (setsockopt(m_fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+            std::cerr << LOG_TAG << " setsockopt(PACKET_VERSION) failed: " << strerror(errno) << "\n";
+            close(m_fd);
+            m_fd = -1;
+            return;
+        }
+
+        tpacket_req3 req{};
+        req.tp_block_size = m_block_size;
+        req.tp_block_nr = m_block_count;
+        req.tp_frame_size = p_config.frame_size;
+        req.tp_frame_nr = (m_block_size / p_config.frame_size) * m_block_count;
+        req.tp_retire_blk_tov = p_config.block_timeout_ms;
+        if (setsockopt(m_fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+            std::cerr << LOG_TAG << " setsockopt(PACKET_RX_RING) failed: " << strerror(errno) << "\n";
+            close(m_fd);
+            m_fd = -1;
+            return;
+        }
+
+        m_map_len = static_cast<size_t>(m_block_size) * m_block_count;
+        void* map = mmap(nullptr, m_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, m_fd, 0);
+        if (map == MAP_FAILED) {
+            // MAP_LOCKED fails under a small RLIMIT_MEMLOCK, the ring still works without it
+            map = mmap(nullptr, m_map_len, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        }
+        if (map == MAP_FAILED) {
+            std::cerr << LOG_TAG << " mmap of the capture ring failed: " << strerror(errno) << "\n";
+            close(m_fd);
+            m_fd = -1;
+            return;
+        }
+        m_map = static_cast<uint8_t*>(map);
+
+        if (!bind_socket(m_fd, p_config.iface)) {
+            munmap(m_map, m_map_len);
+            m_map = nullptr;
+            close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+    Ring::~Ring() {
+        if (m_map) {
+            munmap(m_map, m_map_len);
+        }
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+    }
+
+    tpacket_block_desc* Ring::next_block(std::chrono::milliseconds p_timeout) {
+        auto* block = reinterpret_cast<tpacket_block_desc*>(m_map + static_cast<size_t>(m_block_index) * m_block_size);
+
+        if (!(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) {
+            if (p_timeout.count() == 0) return nullptr;
+
+            pollfd pfd{ .fd = m_fd, .events = POLLIN | POLLERR, .revents = 0 };
+            if (::poll(&pfd, 1, static_cast<int>(p_timeout.count())) <= 0) return nullptr;
+            if (!(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) return nullptr;
+        }
+        return block;
+    }
+
+    void Ring::release_block(tpacket_block_desc* p_block) {
+        __atomic_store_n(&p_block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        m_block_index = (m_block_index + 1) % m_block_count;
+    }
+
+    Stats Ring::stats() {
+        tpacket_stats_v3 kstats{};
+        socklen_t len = sizeof(kstats);
+        if (m_fd >= 0 && getsockopt(m_fd, SOL_PACKET, PACKET_STATISTICS, &kstats, &len) == 0) {
+            // The kernel resets its counters on every read
+            m_stats.packets += kstats.tp_packets;
+            m_stats.drops += kstats.tp_drops;
+            m_stats.freezes += kstats.tp_freeze_q_cnt;
+        }
+        return m_stats;
+    }
+
+} // namespace Capture
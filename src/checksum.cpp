@@ -0,0 +1,220 @@
+#include "checksum.hpp"
+#include <bit>
+#include <cstring>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define CHECKSUM_X86 1
+#endif
+
+namespace Checksum {
+
+    // Kernels sum native-order words into a 64-bit accumulator; RFC 1071 byte order
+    // independence lets partial() swap once at the end instead of per word.
+
+    static inline uint64_t add_carry(uint64_t p_sum, uint64_t p_value) {
+        p_sum += p_value;
+        return p_sum + (p_sum < p_value);   // end-around carry
+    }
+
+    static inline uint16_t fold64(uint64_t p_sum) {
+        p_sum = (p_sum >> 32) + (p_sum & 0xFFFFFFFF);
+        p_sum = (p_sum >> 32) + (p_sum & 0xFFFFFFFF);
+        p_sum = (p_sum >> 16) + (p_sum & 0xFFFF);
+        p_sum = (p_sum >> 16) + (p_sum & 0xFFFF);
+        return static_cast<uint16_t>(p_sum);
+    }
+
+    static inline uint16_t to_big_endian_domain(uint16_t p_sum) {
+        if constexpr (std::endian::native == std::endian::little) {
+            return static_cast<uint16_t>((p_sum << 8) | (p_sum >> 8));
+        } else {
+            return p_sum;
+        }
+    }
+
+    static uint64_t sum_scalar(const uint8_t* p_data, size_t p_len, uint64_t p_sum) {
+        // 32-bit halves into independent 64-bit accumulators: no carries to chase until the end
+        uint64_t acc[4] = { 0, 0, 0, 0 };
+        while (p_len >= 16) {
+            uint64_t words[2];
+            std::memcpy(words, p_data, sizeof(words));
+            acc[0] += words[0] & 0xFFFFFFFF;
+            acc[1] += words[0] >> 32;
+            acc[2] += words[1] & 0xFFFFFFFF;
+            acc[3] += words[1] >> 32;
+            p_data += 16;
+            p_len -= 16;
+        }
+        for (uint64_t a : acc) p_sum = add_carry(p_sum, a);
+
+        if (p_len >= 8) {
+            uint64_t word;
+            std::memcpy(&word, p_data, sizeof(word));
+            p_sum = add_carry(p_sum, word);
+            p_data += 8;
+            p_len -= 8;
+        }
+        if (p_len >= 4) {
+            uint32_t word;
+            std::memcpy(&word, p_data, sizeof(word));
+            p_sum = add_carry(p_sum, word);
+            p_data += 4;
+            p_len -= 4;
+        }
+        if (p_len >= 2) {
+            uint16_t word;
+            std::memcpy(&word, p_data, sizeof(word));
+            p_sum = add_carry(p_sum, word);
+            p_data += 2;
+            p_len -= 2;
+        }
+        if (p_len) {
+            // Zero padded to a full word at the same memory position
+            uint16_t word = 0;
+            std::memcpy(&word, p_data, 1);
+            p_sum = add_carry(p_sum, word);
+        }
+        return p_sum;
+    }
+
+#ifdef CHECKSUM_X86
+    // Words are widened into 32-bit lanes, which gain at most 2 * 0xFFFF per block:
+    // spill them to the 64-bit sum well before two accumulators added together can wrap
+    static constexpr size_t spill_blocks = 8192;
+
+    // Horizontal sum of four 32-bit lanes, widened to 64 bits so nothing carries out
+    __attribute__((target("sse2"), always_inline))
+    static inline uint64_t reduce_sse2(__m128i p_acc) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i wide = _mm_add_epi64(_mm_unpacklo_epi32(p_acc, zero), _mm_unpackhi_epi32(p_acc, zero));
+        return static_cast<uint64_t>(_mm_cvtsi128_si64(wide)) +
+               static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(wide, wide)));
+    }
+
+    __attribute__((target("sse2"), always_inline))
+    static inline __m128i widen_sse2(__m128i p_acc, const uint8_t* p_block) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p_block));
+        return _mm_add_epi32(p_acc, _mm_add_epi32(_mm_unpacklo_epi16(block, zero),
+                                                  _mm_unpackhi_epi16(block, zero)));
+    }
+
+    __attribute__((target("avx2"), always_inline))
+    static inline __m256i widen_avx2(__m256i p_acc, const uint8_t* p_block) {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p_block));
+        return _mm256_add_epi32(p_acc, _mm256_add_epi32(_mm256_unpacklo_epi16(block, zero),
+                                                        _mm256_unpackhi_epi16(block, zero)));
+    }
+
+    __attribute__((target("sse2")))
+    static uint64_t sum_sse2(const uint8_t* p_data, size_t p_len, uint64_t p_sum) {
+        const __m128i zero = _mm_setzero_si128();
+
+        while (p_len >= 16) {
+            __m128i acc0 = zero, acc1 = zero;
+            size_t n = 0;
+            for (; n < spill_blocks && p_len >= 32; n++) {
+                acc0 = widen_sse2(acc0, p_data);
+                acc1 = widen_sse2(acc1, p_data + 16);
+                p_data += 32;
+                p_len -= 32;
+            }
+            if (p_len >= 16 && n < spill_blocks) {
+                acc0 = widen_sse2(acc0, p_data);
+                p_data += 16;
+                p_len -= 16;
+            }
+            p_sum = add_carry(p_sum, reduce_sse2(_mm_add_epi32(acc0, acc1)));
+        }
+        return sum_scalar(p_data, p_len, p_sum);
+    }
+
+    __attribute__((target("avx2")))
+    static uint64_t sum_avx2(const uint8_t* p_data, size_t p_len, uint64_t p_sum) {
+        const __m256i zero = _mm256_setzero_si256();
+
+        while (p_len >= 32) {
+            __m256i acc0 = zero, acc1 = zero;
+            size_t n = 0;
+            for (; n < spill_blocks && p_len >= 64; n++) {
+                acc0 = widen_avx2(acc0, p_data);
+                acc1 = widen_avx2(acc1, p_data + 32);
+                p_data += 64;
+                p_len -= 64;
+            }
+            if (p_len >= 32 && n < spill_blocks) {
+                acc0 = widen_avx2(acc0, p_data);
+                p_data += 32;
+                p_len -= 32;
+            }
+            const __m256i acc = _mm256_add_epi32(acc0, acc1);
+            p_sum = add_carry(p_sum, reduce_sse2(_mm256_castsi256_si128(acc)) +
+                                     reduce_sse2(_mm256_extracti128_si256(acc, 1)));
+        }
+        // The scalar tail is tail-called without GCC's automatic vzeroupper
+        _mm256_zeroupper();
+        return sum_scalar(p_data, p_len, p_sum);
+    }
+#endif
+
+    bool supported(Kernel p_kernel) {
+        switch (p_kernel) {
+            case Kernel::SCALAR:
+                return true;
+#ifdef CHECKSUM_X86
+            case Kernel::SSE2:
+                return __builtin_cpu_supports("sse2");
+            case Kernel::AVX2:
+                return __builtin_cpu_supports("avx2");
+#endif
+            default:
+                return false;
+        }
+    }
+
+    uint32_t partial(Kernel p_kernel, const void* p_data, size_t p_len, uint32_t p_initial) {
+        const auto* data = static_cast<const uint8_t*>(p_data);
+        const uint64_t initial = to_big_endian_domain(fold64(p_initial));
+
+        uint64_t sum;
+        switch (p_kernel) {
+#ifdef CHECKSUM_X86
+            case Kernel::SSE2:
+                sum = sum_sse2(data, p_len, initial);
+                break;
+            case Kernel::AVX2:
+                sum = sum_avx2(data, p_len, initial);
+                break;
+#endif
+            default:
+                sum = sum_scalar(data, p_len, initial);
+                break;
+        }
+        return to_big_endian_domain(fold64(sum));
+    }
+
+    Kernel active() {
+        static const Kernel kernel = [] {
+            for (Kernel k : { Kernel::AVX2, Kernel::SSE2 }) {
+                if (supported(k)) return k;
+            }
+            return Kernel::SCALAR;
+        }();
+        return kernel;
+    }
+
+    uint32_t partial(const void* p_data, size_t p_len, uint32_t p_initial) {
+        return partial(active(), p_data, p_len, p_initial);
+    }
+
+    std::string_view name(Kernel p_kernel) {
+        switch (p_kernel) {
+            case Kernel::SCALAR: return "scalar";
+            case Kernel::SSE2: return "sse2";
+            case Kernel::AVX2: return "avx2";
+        }
+        return "unknown";
+    }
+
+} // namespace Checksum
@@ -1,13 +1,15 @@
 #include "client.hpp"
+#include "capture.hpp"
 #include <iostream>
-#include <thread>
 #include <chrono>
-#include <regex>
 #include <cstdio>
 #include <cstdlib>
 #include <unistd.h>
+#include <poll.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <cstring>
 
@@ -64,47 +66,64 @@ namespace Connection {
         return true;
     }
 
-    // Ain't nobody got time for libpcap, so we use good old tcpdump
-    void TCPClient::sniff_syn_ack() {
-        std::string filter = "tcp[tcpflags] & 0x12 == 0x12 and dst host " + m_src_ip +
-                             " and dst port " + std::to_string(m_src_port);
-        std::string cmd = "timeout 5s tcpdump -i " + m_iface + " -nn -l -c 1 \"" + filter + "\" 2>/dev/null";
+    // Packet socket that only passes the SYN-ACK answering our SYN, see Capture::open_socket
+    bool TCPClient::arm_sniffer() {
+        in_addr src{};
+        if (inet_pton(AF_INET, m_src_ip.c_str(), &src) != 1) {
+            std::cerr << LOG_TAG << " Invalid source IP address: " << m_src_ip << "\n";
+            return false;
+        }
 
-        try {
-            FILE* pipe = popen(cmd.c_str(), "r");
-            if (!pipe) {
-                throw std::runtime_error("Failed to run tcpdump command");
-            }
+        Capture::Filter filter{
+            .direction = Capture::Filter::Direction::INCOMING,
+            .dst_ip = src.s_addr,
+            .dst_port = m_src_port,
+            .flags_mask = TH_SYN | TH_ACK,
+            .flags_value = TH_SYN | TH_ACK
+        };
 
-            char buffer[512];
-            std::string output;
-            while (fgets(buffer, sizeof(buffer), pipe)) {
-                output += buffer;
-            }
+        m_sniff_fd = Capture::open_socket(filter);
+        if (m_sniff_fd < 0) return false;
 
-            int status = pclose(pipe);
-            if (status != 0) {
-                throw std::runtime_error("tcpdump exited abnormally or timed out");
-            }
+        if (!Capture::bind_socket(m_sniff_fd, m_iface)) {
+            disarm_sniffer();
+            return false;
+        }
+        return true;
+    }
 
-            std::smatch match;
-            std::regex pattern(R"(seq (\d+), ack (\d+))");
-            if (std::regex_search(output, match, pattern) && match.size() == 3) {
-                m_server_state.set_seq(std::stoul(match[2]));
-                m_server_state.set_ack(std::stoul(match[1])+ 1);
-            } else {
-                throw std::runtime_error("Failed to parse tcpdump output: " + output);
-            }
+    bool TCPClient::sniff_syn_ack(std::chrono::milliseconds p_timeout) {
+        pollfd pfd{ .fd = m_sniff_fd, .events = POLLIN, .revents = 0 };
+        int ready = poll(&pfd, 1, static_cast<int>(p_timeout.count()));
+        if (ready <= 0) {
+            std::cerr << LOG_TAG << " No SYN-ACK captured" << (ready < 0 ? std::string(": ") + strerror(errno) : "") << "\n";
+            return false;
+        }
 
-            {
-                std::lock_guard<std::mutex> lock(m_sniff_mutex);
-                m_sniff_done = true;
-            }
+        char buffer[128];
+        ssize_t len = recv(m_sniff_fd, buffer, sizeof(buffer), 0);
+        if (len < static_cast<ssize_t>(sizeof(iphdr))) {
+            std::cerr << LOG_TAG << " Failed to read SYN-ACK: " << (len < 0 ? strerror(errno) : "truncated") << "\n";
+            return false;
         }
-        catch (const std::exception& e) {
-            std::cerr << LOG_TAG << " Exception in sniffing thread: " << e.what() << "\n";
+
+        const auto* iph = reinterpret_cast<const iphdr*>(buffer);
+        const size_t ip_len = iph->ihl * 4UL;
+        if (static_cast<size_t>(len) < ip_len + sizeof(tcphdr)) {
+            std::cerr << LOG_TAG << " Failed to read SYN-ACK: truncated\n";
+            return false;
+        }
+
+        const auto* tcph = reinterpret_cast<const tcphdr*>(buffer + ip_len);
+        m_server_state.store(ntohl(tcph->ack_seq), ntohl(tcph->seq) + 1);
+        return true;
+    }
+
+    void TCPClient::disarm_sniffer() {
+        if (m_sniff_fd >= 0) {
+            close(m_sniff_fd);
+            m_sniff_fd = -1;
         }
-        m_sniff_cv.notify_one();
     }
 
     bool TCPClient::extended_connect(const std::string& p_dst_ip, uint16_t p_dst_port) {
@@ -133,32 +152,27 @@ namespace Connection {
             return false;
         }
 
-        {
-            std::lock_guard<std::mutex> lock(m_sniff_mutex);
-            m_sniff_done = false;
+        // Armed before connect(), the SYN-ACK is queued on the packet socket by the time
+        // the handshake completes
+        if (!arm_sniffer()) {
+            std::cerr << LOG_TAG << " Failed to arm SYN-ACK sniffer.\n";
+            return false;
         }
 
-        m_sniff_thread = std::jthread(&TCPClient::sniff_syn_ack, this);
-
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-
         if (connect(m_sock_fd, reinterpret_cast<sockaddr*>(&dst_addr), sizeof(dst_addr)) < 0) {
             std::cerr << LOG_TAG << " Connection Failed: " << strerror(errno) << "\n";
-            m_sniff_thread.request_stop();
             disconnect();
             return false;
         }
 
         std::cout << LOG_TAG << " Connected to " << m_dst_ip << ":" << m_dst_port << "...";
 
-        {
-            std::unique_lock<std::mutex> lock(m_sniff_mutex);
-            if (!m_sniff_cv.wait_for(lock, std::chrono::seconds(5), [this] { return m_sniff_done; })) {
-                std::cerr << "Sniffing Failed.\n";
-                m_sniff_thread.request_stop();
-                disconnect();
-                return false;
-            }
+        bool sniffed = sniff_syn_ack(std::chrono::seconds(5));
+        disarm_sniffer();
+        if (!sniffed) {
+            std::cerr << "Sniffing Failed.\n";
+            disconnect();
+            return false;
         }
 
         std::cout << "Sniffing Succeeded.\n";
@@ -169,6 +183,7 @@ namespace Connection {
     }
 
     void TCPClient::disconnect() {
+        stop_tracking();
         if (m_sock_fd >= 0) {
             close(m_sock_fd);
             m_sock_fd = -1;
@@ -176,14 +191,76 @@ namespace Connection {
         } else {
             std::cout << LOG_TAG << " Already disconnected.\n";
         }
-        m_sniff_thread.request_stop();
+        disarm_sniffer();
 
-        m_server_state.set_seq(0);
-        m_server_state.set_ack(0);
+        m_server_state.store(0, 0);
         m_server_state.type = State::Type::DISCONNECTED;
-        {
-            std::lock_guard<std::mutex> lock(m_sniff_mutex);
-            m_sniff_done = false;
+    }
+
+    bool TCPClient::start_tracking() {
+        if (m_server_state.type != State::Type::CONNECTED) {
+            std::cerr << LOG_TAG << " Not connected, nothing to track.\n";
+            return false;
+        }
+        if (m_tracking) return true;
+
+        in_addr src{}, dst{};
+        inet_pton(AF_INET, m_src_ip.c_str(), &src);
+        inet_pton(AF_INET, m_dst_ip.c_str(), &dst);
+
+        // Small blocks with a 1 ms timeout, so updates surface within about a millisecond
+        Capture::RingConfig config{
+            .iface = m_iface,
+            .filter = Capture::Filter{
+                .direction = Capture::Filter::Direction::BOTH,
+                .src_ip = src.s_addr,
+                .dst_ip = dst.s_addr,
+                .src_port = m_src_port,
+                .dst_port = m_dst_port,
+                .symmetric = true,
+                .snap_len = 128
+            },
+            .block_size = 1U << 16,
+            .block_count = 64,
+            .block_timeout_ms = 1
+        };
+
+        m_tracker_ring = std::make_unique<Capture::Ring>(config);
+        if (!m_tracker_ring->valid()) {
+            std::cerr << LOG_TAG << " Failed to open capture ring for tracking.\n";
+            m_tracker_ring.reset();
+            return false;
+        }
+
+        m_tracking = true;
+        m_tracker = std::thread(&TCPClient::track, this);
+        return true;
+    }
+
+    void TCPClient::stop_tracking() {
+        if (!m_tracking) return;
+        m_tracking = false;
+        m_tracker.join();
+        m_tracker_ring.reset();
+    }
+
+    void TCPClient::track() {
+        in_addr src{};
+        inet_pton(AF_INET, m_src_ip.c_str(), &src);
+
+        auto on_record = [&](const Capture::Record& r) {
+            // SYN and FIN occupy one sequence number each
+            const uint32_t length = r.payload_len + ((r.flags & (TH_SYN | TH_FIN)) ? 1 : 0);
+            if (r.src_ip == src.s_addr && r.src_port == m_src_port) {
+                m_server_state.advance_seq(r.seq + length);
+            } else {
+                if (r.flags & TH_ACK) m_server_state.advance_seq(r.ack);
+                m_server_state.advance_ack(r.seq + length);
+            }
+        };
+
+        while (m_tracking.load(std::memory_order_relaxed)) {
+            m_tracker_ring->poll(on_record, std::chrono::milliseconds(10));
         }
     }
 
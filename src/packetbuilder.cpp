@@ -1,23 +1,23 @@
 #include "packetbuilder.hpp"
+#include "checksum.hpp"
 #include <array>
+#include <atomic>
 #include <cstring>
 #include <netinet/ip.h>
 #include <netinet/tcp.h>
+#include <linux/if_ether.h>
 #include <arpa/inet.h>
+#include <cstddef>
 #include <sys/socket.h>
 #include <sys/uio.h>
+#include <sys/mman.h>
 #include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <unistd.h>
 
 namespace PacketBuilder {
 
-    struct PseudoHeader {
-        uint32_t src_addr;
-        uint32_t dst_addr;
-        uint8_t zero = 0;
-        uint8_t protocol = IPPROTO_TCP;
-        uint16_t tcp_length;
-    };
-
     mmsghdr PacketBatch::make_msg(iovec& iov) {
         mmsghdr msg{};
         msg.msg_hdr.msg_iov = &iov;
@@ -59,20 +59,118 @@ namespace PacketBuilder {
         return msgs;
     }
 
-    static uint16_t compute_checksum(const uint16_t* data, size_t bytes) {
-        uint32_t sum = 0;
-        while (bytes > 1) {
-            sum += *data++;
-            bytes -= 2;
+    static std::atomic<uint64_t> next_slab_id{1};
+
+    static size_t round_up(size_t value, size_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    BatchSlab::BatchSlab(size_t p_slots, size_t p_stride, bool p_hugepages)
+        : m_stride(round_up(p_stride, cache_line)), m_size(p_slots),
+          m_iovecs(p_slots), m_msgs(p_slots),
+          m_id(next_slab_id.fetch_add(1, std::memory_order_relaxed)), m_versions(p_slots, 0) {
+
+        constexpr size_t hugepage_size = 2UL << 20;
+        const size_t bytes = std::max<size_t>(p_slots * m_stride, cache_line);
+
+        // mmap is page aligned, which covers the cache-line alignment of every slot
+        if (p_hugepages) {
+            m_slab_bytes = round_up(bytes, hugepage_size);
+            void* mem = mmap(nullptr, m_slab_bytes, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (mem != MAP_FAILED) {
+                m_slab = static_cast<char*>(mem);
+                m_hugepages = true;
+            } else {
+                std::cerr << "BatchSlab: hugepage mapping failed, falling back to regular pages.\n";
+            }
         }
-        if (bytes == 1) {
-            uint16_t odd = 0;
-            *reinterpret_cast<uint8_t*>(&odd) = *reinterpret_cast<const uint8_t*>(data);
-            sum += odd;
+
+        if (!m_slab) {
+            m_slab_bytes = round_up(bytes, static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+            void* mem = mmap(nullptr, m_slab_bytes, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+            if (mem == MAP_FAILED) {
+                perror("mmap");
+                m_slab_bytes = 0;
+                m_size = 0;
+                return;
+            }
+            m_slab = static_cast<char*>(mem);
+        }
+
+        for (size_t i = 0; i < p_slots; i++) {
+            m_iovecs[i] = iovec{ slot(i), 0 };
+            m_msgs[i] = mmsghdr{};
+            m_msgs[i].msg_hdr.msg_iov = &m_iovecs[i];
+            m_msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+    }
+
+    BatchSlab::~BatchSlab() {
+        if (m_slab) {
+            munmap(m_slab, m_slab_bytes);
+        }
+    }
+
+    void BatchSlab::resize(size_t p_size) {
+        m_size = std::min(p_size, capacity());
+    }
+
+    size_t BatchSlab::put(size_t p_index, const PacketTemplate& p_tmpl) {
+        if (p_tmpl.size() > m_stride) {
+            set_length(p_index, 0);
+            return 0;
+        }
+        set_length(p_index, p_tmpl.render(slot(p_index)));
+        return length(p_index);
+    }
+
+    size_t BatchSlab::put(size_t p_index, std::span<const char> p_packet) {
+        if (p_packet.size() > m_stride) {
+            set_length(p_index, 0);
+            return 0;
+        }
+        std::memcpy(slot(p_index), p_packet.data(), p_packet.size());
+        set_length(p_index, p_packet.size());
+        return p_packet.size();
+    }
+
+    void BatchSlab::put_sequence(size_t p_first, PacketTemplate& p_tmpl, uint32_t p_seq,
+                                 uint32_t p_delta_seq, size_t p_count) {
+        for (size_t i = 0; i < p_count; i++) {
+            p_tmpl.set_seq(p_seq + static_cast<uint32_t>(i * p_delta_seq));
+            put(p_first + i, p_tmpl);
         }
-        sum = (sum >> 16) + (sum & 0xFFFF);
-        sum += (sum >> 16);
-        return static_cast<uint16_t>(~sum);
+    }
+
+    void BatchSlab::set_destination(const sockaddr_in& p_addr) {
+        m_dest = p_addr;
+        for (auto& msg : m_msgs) {
+            msg.msg_hdr.msg_name = &m_dest;
+            msg.msg_hdr.msg_namelen = sizeof(m_dest);
+        }
+    }
+
+    void BatchSlab::enable_txtime() {
+        if (txtime()) return;
+
+        constexpr size_t words = CMSG_SPACE(sizeof(uint64_t)) / sizeof(uint64_t);
+        m_control.assign(capacity() * words, 0);
+        for (size_t i = 0; i < capacity(); i++) {
+            auto* control = &m_control[i * words];
+            m_msgs[i].msg_hdr.msg_control = control;
+            m_msgs[i].msg_hdr.msg_controllen = CMSG_SPACE(sizeof(uint64_t));
+
+            cmsghdr* cmsg = CMSG_FIRSTHDR(&m_msgs[i].msg_hdr);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_TXTIME;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+        }
+    }
+
+    void BatchSlab::set_txtime(size_t p_index, uint64_t p_time_ns) {
+        std::memcpy(CMSG_DATA(CMSG_FIRSTHDR(&m_msgs[p_index].msg_hdr)), &p_time_ns, sizeof(p_time_ns));
     }
 
     std::vector<char> build_packet(const Config& config) {
@@ -100,17 +198,8 @@ namespace PacketBuilder {
         iph->frag_off = 0;
         iph->ttl = 64;
         iph->protocol = IPPROTO_TCP;
-        in_addr src{}, dst{};
-        if (inet_pton(AF_INET, config.src_ip.c_str(), &src) != 1 ||
-            inet_pton(AF_INET, config.dst_ip.c_str(), &dst) != 1) {
-            std::cerr << "Invalid source or destination IP address.\n";
-            return {}; // Invalid IPs
-        }
-
-        iph->saddr = src.s_addr;
-        iph->daddr = dst.s_addr;
-
-        iph->check = compute_checksum(reinterpret_cast<uint16_t*>(iph), sizeof(iphdr));
+        iph->saddr = config.src_ip.network();
+        iph->daddr = config.dst_ip.network();
 
         tcph->source = htons(config.src_port);
         tcph->dest = htons(config.dst_port);
@@ -124,33 +213,150 @@ namespace PacketBuilder {
         tcph->window = htons(config.window);
         tcph->check = 0;
 
-        PseudoHeader psh {
-            .src_addr = iph->saddr,
-            .dst_addr = iph->daddr,
-            .tcp_length = htons(sizeof(tcphdr) + payload_len)
-        };
-
-        std::vector<char> pseudo_packet(sizeof(PseudoHeader) + sizeof(tcphdr) + payload_len);
-        std::memcpy(pseudo_packet.data(), &psh, sizeof(PseudoHeader));
-        std::memcpy(pseudo_packet.data() + sizeof(PseudoHeader), tcph, sizeof(tcphdr));
-        if (payload_len > 0) {
-            std::memcpy(pseudo_packet.data() + sizeof(PseudoHeader) + sizeof(tcphdr),
-                        payload_ptr, payload_len);
-        }
+        iph->check = htons(Checksum::compute(iph, sizeof(iphdr)));
 
-        tcph->check = compute_checksum(reinterpret_cast<const uint16_t*>(pseudo_packet.data()), pseudo_packet.size());
+        // Pseudo header summed from the parsed addresses, no staging copy of the segment
+        const uint32_t tcp_len = static_cast<uint32_t>(sizeof(tcphdr) + payload_len);
+        uint32_t sum = (config.src_ip.value >> 16) + (config.src_ip.value & 0xFFFF) +
+                       (config.dst_ip.value >> 16) + (config.dst_ip.value & 0xFFFF) + IPPROTO_TCP + tcp_len;
+        tcph->check = htons(Checksum::compute(tcph, tcp_len, sum));
 
         return buffer;
     }
 
+    // RFC 1624, Eqn. 3: HC' = ~(~HC + ~m + m')
+    static uint16_t adjust_checksum(uint16_t check, uint16_t old_word, uint16_t new_word) {
+        uint32_t sum = static_cast<uint16_t>(~check) + static_cast<uint16_t>(~old_word) + new_word;
+        sum = (sum >> 16) + (sum & 0xFFFF);
+        sum += (sum >> 16);
+        return static_cast<uint16_t>(~sum);
+    }
+
+    static constexpr size_t tcp_offset = sizeof(iphdr);
+    static constexpr size_t ip_check_offset = offsetof(iphdr, check);
+    static constexpr size_t tcp_check_offset = tcp_offset + offsetof(tcphdr, check);
+
+    PacketTemplate::PacketTemplate(const Config& p_config)
+        : m_packet(build_packet(p_config)) {}
+
+    PacketTemplate::PacketTemplate(const Config& p_config, const MacAddress& p_src_mac, const MacAddress& p_dst_mac)
+        : m_packet(build_frame(p_config, p_src_mac, p_dst_mac)), m_l3_offset(sizeof(ethhdr)) {}
+
+    void PacketTemplate::patch_ip(size_t p_offset, uint16_t p_word) {
+        uint16_t old_word, check;
+        std::memcpy(&old_word, l3() + p_offset, sizeof(old_word));
+        if (old_word == p_word) return;
+
+        std::memcpy(&check, l3() + ip_check_offset, sizeof(check));
+        check = adjust_checksum(check, old_word, p_word);
+        std::memcpy(l3() + p_offset, &p_word, sizeof(p_word));
+        std::memcpy(l3() + ip_check_offset, &check, sizeof(check));
+    }
+
+    void PacketTemplate::patch_tcp(size_t p_offset, uint16_t p_word) {
+        uint16_t old_word, check;
+        std::memcpy(&old_word, l3() + p_offset, sizeof(old_word));
+        if (old_word == p_word) return;
+
+        std::memcpy(&check, l3() + tcp_check_offset, sizeof(check));
+        check = adjust_checksum(check, old_word, p_word);
+        std::memcpy(l3() + p_offset, &p_word, sizeof(p_word));
+        std::memcpy(l3() + tcp_check_offset, &check, sizeof(check));
+    }
+
+    void PacketTemplate::patch_tcp32(size_t p_offset, uint32_t p_dword) {
+        uint16_t words[2];
+        std::memcpy(words, &p_dword, sizeof(words));
+        patch_tcp(p_offset, words[0]);
+        patch_tcp(p_offset + sizeof(uint16_t), words[1]);
+    }
+
+    uint32_t PacketTemplate::seq() const {
+        uint32_t seq;
+        std::memcpy(&seq, l3() + tcp_offset + offsetof(tcphdr, seq), sizeof(seq));
+        return ntohl(seq);
+    }
+
+    void PacketTemplate::set_seq(uint32_t p_seq) {
+        if (!valid()) return;
+        patch_tcp32(tcp_offset + offsetof(tcphdr, seq), htonl(p_seq));
+    }
+
+    void PacketTemplate::set_ack(uint32_t p_ack) {
+        if (!valid()) return;
+        patch_tcp32(tcp_offset + offsetof(tcphdr, ack_seq), htonl(p_ack));
+    }
+
+    void PacketTemplate::set_src_port(uint16_t p_port) {
+        if (!valid()) return;
+        patch_tcp(tcp_offset + offsetof(tcphdr, source), htons(p_port));
+    }
+
+    void PacketTemplate::set_dst_port(uint16_t p_port) {
+        if (!valid()) return;
+        patch_tcp(tcp_offset + offsetof(tcphdr, dest), htons(p_port));
+    }
+
+    void PacketTemplate::set_flags(bool p_syn, bool p_ack, bool p_rst, bool p_psh) {
+        if (!valid()) return;
+
+        // Flags share a 16-bit word with doff, so patch the whole word via a header copy
+        tcphdr tcph;
+        std::memcpy(&tcph, l3() + tcp_offset, sizeof(tcph));
+        tcph.syn = p_syn;
+        tcph.ack = p_ack;
+        tcph.rst = p_rst;
+        tcph.psh = p_psh;
+
+        constexpr size_t flags_offset = offsetof(tcphdr, ack_seq) + sizeof(uint32_t);
+        uint16_t word;
+        std::memcpy(&word, reinterpret_cast<const char*>(&tcph) + flags_offset, sizeof(word));
+        patch_tcp(tcp_offset + flags_offset, word);
+    }
+
+    void PacketTemplate::set_window(uint16_t p_window) {
+        if (!valid()) return;
+        patch_tcp(tcp_offset + offsetof(tcphdr, window), htons(p_window));
+    }
+
+    void PacketTemplate::set_ip_id(uint16_t p_id) {
+        if (!valid()) return;
+        patch_ip(offsetof(iphdr, id), htons(p_id));
+    }
+
+    size_t PacketTemplate::render(char* p_dst) const {
+        std::memcpy(p_dst, m_packet.data(), m_packet.size());
+        return m_packet.size();
+    }
+
+    std::array<char, 14> build_ethernet_header(const MacAddress& src_mac, const MacAddress& dst_mac) {
+        std::array<char, sizeof(ethhdr)> header{};
+        auto* eth = reinterpret_cast<ethhdr*>(header.data());
+        std::memcpy(eth->h_dest, dst_mac.data(), ETH_ALEN);
+        std::memcpy(eth->h_source, src_mac.data(), ETH_ALEN);
+        eth->h_proto = htons(ETH_P_IP);
+        return header;
+    }
+
+    std::vector<char> build_frame(const Config& config, const MacAddress& src_mac, const MacAddress& dst_mac) {
+        std::vector<char> packet = build_packet(config);
+        if (packet.empty())
+            return {};
+
+        const auto header = build_ethernet_header(src_mac, dst_mac);
+        packet.insert(packet.begin(), header.begin(), header.end());
+        return packet;
+    }
+
     std::vector<std::vector<char>> build_packet_batch(const Config& base_config, size_t packet_count) {
         std::vector<std::vector<char>> packets;
+        packets.reserve(packet_count);
         std::size_t delta_seq = base_config.payload.size();
 
+        PacketTemplate tmpl(base_config);
         for (size_t i = 0; i < packet_count; i++) {
-            Config cfg = base_config;
-            cfg.seq += static_cast<uint32_t>(i * delta_seq);
-            packets.push_back(build_packet(cfg));
+            tmpl.set_seq(base_config.seq + static_cast<uint32_t>(i * delta_seq));
+            packets.push_back(tmpl.packet());
         }
         return packets;
     }
@@ -0,0 +1,390 @@
+#include "pcap.hpp"
+#include <algorithm>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+namespace Pcap {
+
+    // pcapng block types and options (draft-ietf-opsawg-pcapng), host byte order throughout
+    static constexpr uint32_t SECTION_HEADER = 0x0A0D0D0A;
+    static constexpr uint32_t INTERFACE_DESCRIPTION = 0x00000001;
+    static constexpr uint32_t SIMPLE_PACKET = 0x00000003;
+    static constexpr uint32_t ENHANCED_PACKET = 0x00000006;
+    static constexpr uint32_t BYTE_ORDER_MAGIC = 0x1A2B3C4D;
+    static constexpr uint16_t OPT_ENDOFOPT = 0;
+    static constexpr uint16_t IF_TSRESOL = 9;
+    static constexpr uint32_t snap_len = 0xFFFF;
+
+    // Classic pcap magics as read in host order
+    static constexpr uint32_t PCAP_MICRO = 0xA1B2C3D4;
+    static constexpr uint32_t PCAP_NANO = 0xA1B23C4D;
+
+    static constexpr size_t pad4(size_t p_len) {
+        return (p_len + 3) & ~size_t(3);
+    }
+
+    template <typename T>
+    static char* put(char* p_dst, T p_value) {
+        std::memcpy(p_dst, &p_value, sizeof(p_value));
+        return p_dst + sizeof(p_value);
+    }
+
+    Writer::Writer(const std::string& p_path, uint16_t p_linktype, size_t p_initial_bytes)
+        : m_path(p_path) {
+        m_fd = open(p_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (m_fd < 0) {
+            std::cerr << LOG_TAG << " Failed to open " << p_path << ": " << strerror(errno) << "\n";
+            return;
+        }
+        if (!reserve(std::max<size_t>(p_initial_bytes, 4096))) {
+            ::close(m_fd);
+            m_fd = -1;
+            return;
+        }
+        put_header(p_linktype);
+    }
+
+    Writer::~Writer() {
+        close();
+    }
+
+    bool Writer::reserve(size_t p_bytes) {
+        if (m_offset + p_bytes <= m_capacity) return true;
+
+        size_t capacity = m_capacity ? m_capacity : p_bytes;
+        while (capacity < m_offset + p_bytes) capacity *= 2;
+
+        if (ftruncate(m_fd, static_cast<off_t>(capacity)) < 0) {
+            std::cerr << LOG_TAG << " Failed to grow " << m_path << ": " << strerror(errno) << "\n";
+            return false;
+        }
+        void* map = m_map ? mremap(m_map, m_capacity, capacity, MREMAP_MAYMOVE)
+                          : mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        if (map == MAP_FAILED) {
+            perror("mmap(pcapng)");
+            if (m_map) munmap(m_map, m_capacity);
+            m_map = nullptr;
+            return false;
+        }
+        // Written front to back exactly once
+        madvise(map, capacity, MADV_SEQUENTIAL);
+        m_map = static_cast<char*>(map);
+        m_capacity = capacity;
+        return true;
+    }
+
+    void Writer::put_header(uint16_t p_linktype) {
+        constexpr uint32_t shb_len = 28;
+        char* p = m_map + m_offset;
+        p = put(p, SECTION_HEADER);
+        p = put(p, shb_len);
+        p = put(p, BYTE_ORDER_MAGIC);
+        p = put<uint16_t>(p, 1);                // major version
+        p = put<uint16_t>(p, 0);                // minor version
+        p = put<int64_t>(p, -1);                // section length unknown
+        p = put(p, shb_len);
+
+        constexpr uint32_t idb_len = 32;
+        p = put(p, INTERFACE_DESCRIPTION);
+        p = put(p, idb_len);
+        p = put(p, p_linktype);
+        p = put<uint16_t>(p, 0);                // reserved
+        p = put(p, snap_len);
+        p = put(p, IF_TSRESOL);
+        p = put<uint16_t>(p, 1);
+        p = put<uint8_t>(p, 9);                 // 10^-9 s
+        p += 3;                                 // option padding, already zero
+        p = put(p, OPT_ENDOFOPT);
+        p = put<uint16_t>(p, 0);
+        p = put(p, idb_len);
+
+        m_offset = static_cast<size_t>(p - m_map);
+    }
+
+    bool Writer::write(uint64_t p_timestamp_ns, std::span<const char> p_packet) {
+        const size_t captured = std::min<size_t>(p_packet.size(), snap_len);
+        const uint32_t block_len = static_cast<uint32_t>(32 + pad4(captured));
+        if (!valid() || !reserve(block_len)) return false;
+
+        char* p = m_map + m_offset;
+        p = put(p, ENHANCED_PACKET);
+        p = put(p, block_len);
+        p = put<uint32_t>(p, 0);                // interface id
+        p = put(p, static_cast<uint32_t>(p_timestamp_ns >> 32));
+        p = put(p, static_cast<uint32_t>(p_timestamp_ns));
+        p = put(p, static_cast<uint32_t>(captured));
+        p = put(p, static_cast<uint32_t>(p_packet.size()));
+        std::memcpy(p, p_packet.data(), captured);
+        // The mapping past the end of the file is zero filled, padding needs no stores
+        p += pad4(captured);
+        p = put(p, block_len);
+
+        m_offset = static_cast<size_t>(p - m_map);
+        m_packets++;
+        return true;
+    }
+
+    size_t Writer::write(const PacketBuilder::PacketBatch& p_batch, uint64_t p_timestamp_ns, uint64_t p_gap_ns) {
+        size_t written = 0;
+        auto next = [&](const std::vector<char>& p_packet) {
+            if (p_packet.empty()) return;
+            if (write(p_timestamp_ns + written * p_gap_ns, p_packet)) written++;
+        };
+
+        next(p_batch.probe1);
+        for (const auto& packet : p_batch.spoofed) {
+            next(packet);
+        }
+        next(p_batch.probe2);
+        return written;
+    }
+
+    size_t Writer::write(const PacketBuilder::BatchSlab& p_batch, uint64_t p_timestamp_ns, uint64_t p_gap_ns) {
+        size_t written = 0;
+        for (size_t i = 0; i < p_batch.size(); i++) {
+            if (p_batch.length(i) == 0) continue;
+            if (write(p_timestamp_ns + written * p_gap_ns, { p_batch.slot(i), p_batch.length(i) })) written++;
+        }
+        return written;
+    }
+
+    bool Writer::close() {
+        if (m_fd < 0) return true;
+
+        bool ok = m_map != nullptr;
+        if (m_map) {
+            munmap(m_map, m_capacity);
+            m_map = nullptr;
+        }
+        if (ftruncate(m_fd, static_cast<off_t>(m_offset)) < 0) {
+            std::cerr << LOG_TAG << " Failed to truncate " << m_path << ": " << strerror(errno) << "\n";
+            ok = false;
+        }
+        ::close(m_fd);
+        m_fd = -1;
+        return ok;
+    }
+
+    template <typename T>
+    static T get(const char* p_src, bool p_swap) {
+        T value;
+        std::memcpy(&value, p_src, sizeof(value));
+        if (!p_swap) return value;
+        if constexpr (sizeof(T) == 2) return static_cast<T>(__builtin_bswap16(value));
+        else return static_cast<T>(__builtin_bswap32(value));
+    }
+
+    static uint16_t get_be16(const char* p_src) {
+        uint16_t value;
+        std::memcpy(&value, p_src, sizeof(value));
+        return ntohs(value);
+    }
+
+    // if_tsresol: 10^-v seconds, or 2^-v with the high bit set
+    static uint64_t to_ns(uint64_t p_timestamp, uint8_t p_resolution) {
+        if (p_resolution & 0x80) {
+            unsigned shift = p_resolution & 0x7F;
+            if (shift > 32) {
+                p_timestamp >>= shift - 32;
+                shift = 32;
+            }
+            const uint64_t fraction = p_timestamp & ((1ULL << shift) - 1);
+            return (p_timestamp >> shift) * 1000000000ULL + ((fraction * 1000000000ULL) >> shift);
+        }
+        uint64_t scale = 1;
+        for (unsigned i = std::min<unsigned>(p_resolution, 9); i < 9; i++) scale *= 10;
+        for (unsigned i = 9; i < p_resolution && i < 28; i++) p_timestamp /= 10;
+        return p_timestamp * scale;
+    }
+
+    Reader::Reader(const std::string& p_path) {
+        int fd = open(p_path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            std::cerr << LOG_TAG << " Failed to open " << p_path << ": " << strerror(errno) << "\n";
+            return;
+        }
+        struct stat st{};
+        if (fstat(fd, &st) < 0 || st.st_size < 24) {
+            std::cerr << LOG_TAG << " " << p_path << " is too short for a capture file\n";
+            ::close(fd);
+            return;
+        }
+
+        void* map = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED) {
+            perror("mmap(pcap)");
+            return;
+        }
+        m_map = static_cast<const char*>(map);
+        m_size = static_cast<size_t>(st.st_size);
+        madvise(map, m_size, MADV_WILLNEED);
+
+        const bool ok = get<uint32_t>(m_map, false) == SECTION_HEADER ? parse_pcapng() : parse_pcap();
+        if (!ok) {
+            std::cerr << LOG_TAG << " " << p_path << " is neither pcap nor pcapng\n";
+            munmap(map, m_size);
+            m_map = nullptr;
+            m_frames.clear();
+        }
+    }
+
+    Reader::~Reader() {
+        if (m_map) munmap(const_cast<char*>(m_map), m_size);
+    }
+
+    bool Reader::parse_pcap() {
+        const uint32_t magic = get<uint32_t>(m_map, false);
+        bool swap, nano;
+        if (magic == PCAP_MICRO || magic == PCAP_NANO) {
+            swap = false;
+            nano = magic == PCAP_NANO;
+        } else if (__builtin_bswap32(magic) == PCAP_MICRO || __builtin_bswap32(magic) == PCAP_NANO) {
+            swap = true;
+            nano = __builtin_bswap32(magic) == PCAP_NANO;
+        } else {
+            return false;
+        }
+
+        // Upper bits of the link type field carry FCS information
+        const uint16_t linktype = static_cast<uint16_t>(get<uint32_t>(m_map + 20, swap) & 0xFFFF);
+
+        size_t offset = 24;
+        while (offset + 16 <= m_size) {
+            const char* record = m_map + offset;
+            const uint64_t seconds = get<uint32_t>(record, swap);
+            const uint64_t fraction = get<uint32_t>(record + 4, swap);
+            const uint32_t captured = get<uint32_t>(record + 8, swap);
+            const uint32_t original = get<uint32_t>(record + 12, swap);
+            if (offset + 16 + captured > m_size) {
+                m_skipped++;    // file cut off mid-record
+                break;
+            }
+            add(linktype, seconds * 1000000000ULL + (nano ? fraction : fraction * 1000), record + 16,
+                captured, original);
+            offset += 16 + captured;
+        }
+        return true;
+    }
+
+    bool Reader::parse_pcapng() {
+        struct Interface {
+            uint16_t linktype;
+            uint8_t resolution;
+        };
+        std::vector<Interface> interfaces;
+        bool swap = false;
+        uint64_t last_timestamp = 0;
+
+        size_t offset = 0;
+        while (offset + 12 <= m_size) {
+            const char* block = m_map + offset;
+            const uint32_t type = get<uint32_t>(block, swap);
+            if (type == SECTION_HEADER) {
+                // Every section carries its own byte order and interface list
+                const uint32_t magic = get<uint32_t>(block + 8, false);
+                if (magic != BYTE_ORDER_MAGIC && __builtin_bswap32(magic) != BYTE_ORDER_MAGIC) return false;
+                swap = magic != BYTE_ORDER_MAGIC;
+                interfaces.clear();
+            }
+
+            const uint32_t length = get<uint32_t>(block + 4, swap);
+            if (length < 12 || length % 4 || offset + length > m_size) {
+                m_skipped++;    // corrupt or cut off block, nothing after it can be trusted
+                break;
+            }
+            const char* body = block + 8;
+            const size_t body_len = length - 12;
+
+            if (type == INTERFACE_DESCRIPTION && body_len >= 8) {
+                Interface interface{ get<uint16_t>(body, swap), 6 };
+                for (size_t opt = 8; opt + 4 <= body_len;) {
+                    const uint16_t code = get<uint16_t>(body + opt, swap);
+                    const uint16_t opt_len = get<uint16_t>(body + opt + 2, swap);
+                    if (code == OPT_ENDOFOPT || opt + 4 + opt_len > body_len) break;
+                    if (code == IF_TSRESOL && opt_len >= 1) {
+                        interface.resolution = static_cast<uint8_t>(body[opt + 4]);
+                    }
+                    opt += 4 + pad4(opt_len);
+                }
+                interfaces.push_back(interface);
+            } else if (type == ENHANCED_PACKET && body_len >= 20) {
+                const uint32_t id = get<uint32_t>(body, swap);
+                const uint64_t timestamp = (static_cast<uint64_t>(get<uint32_t>(body + 4, swap)) << 32) |
+                                           get<uint32_t>(body + 8, swap);
+                const uint32_t captured = get<uint32_t>(body + 12, swap);
+                const uint32_t original = get<uint32_t>(body + 16, swap);
+                if (id >= interfaces.size() || 20 + static_cast<size_t>(captured) > body_len) {
+                    m_skipped++;
+                } else {
+                    last_timestamp = to_ns(timestamp, interfaces[id].resolution);
+                    add(interfaces[id].linktype, last_timestamp, body + 20, captured, original);
+                }
+            } else if (type == SIMPLE_PACKET && body_len >= 4 && !interfaces.empty()) {
+                // No timestamp of its own, sent back to back with the previous packet
+                const uint32_t original = get<uint32_t>(body, swap);
+                const uint32_t captured = static_cast<uint32_t>(std::min<size_t>(original, body_len - 4));
+                add(interfaces[0].linktype, last_timestamp, body + 4, captured, original);
+            }
+            offset += length;
+        }
+        return true;
+    }
+
+    void Reader::add(uint16_t p_linktype, uint64_t p_timestamp_ns, const char* p_data,
+                     uint32_t p_captured, uint32_t p_original) {
+        // Raw sockets rewrite tot_len, a snapped packet would go out with the wrong length
+        if (p_captured < p_original) {
+            m_skipped++;
+            return;
+        }
+
+        size_t offset = 0;
+        switch (p_linktype) {
+            case LINKTYPE_ETHERNET: {
+                if (p_captured < 14) {
+                    offset = p_captured;
+                    break;
+                }
+                uint16_t ethertype = get_be16(p_data + 12);
+                offset = 14;
+                while ((ethertype == 0x8100 || ethertype == 0x88A8) && p_captured >= offset + 4) {
+                    ethertype = get_be16(p_data + offset + 2);     // 802.1Q / 802.1ad tag
+                    offset += 4;
+                }
+                if (ethertype != 0x0800) offset = p_captured;
+                break;
+            }
+            case LINKTYPE_LINUX_SLL:
+                offset = p_captured >= 16 && get_be16(p_data + 14) == 0x0800 ? 16 : p_captured;
+                break;
+            case LINKTYPE_RAW:
+            case LINKTYPE_IPV4:
+                break;
+            default:
+                offset = p_captured;
+                break;
+        }
+
+        const char* packet = p_data + offset;
+        const size_t available = p_captured - std::min<size_t>(offset, p_captured);
+        if (available < 20 || (static_cast<uint8_t>(packet[0]) >> 4) != 4) {
+            m_skipped++;
+            return;
+        }
+        // Cut Ethernet trailer padding off at the IP total length
+        const uint16_t total = get_be16(packet + 2);
+        if (total < 20 || total > available) {
+            m_skipped++;
+            return;
+        }
+        m_frames.push_back(Frame{ p_timestamp_ns, { packet, total } });
+    }
+
+} // namespace Pcap
@@ -0,0 +1,185 @@
+#include "plan.hpp"
+#include <algorithm>
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace Plan {
+
+    static constexpr size_t align(size_t p_value, size_t p_alignment) {
+        return (p_value + p_alignment - 1) / p_alignment * p_alignment;
+    }
+
+    bool compile(const Spec& p_spec, const std::string& p_path) {
+        PacketBuilder::PacketTemplate spoof_tmpl(p_spec.spoof);
+        PacketBuilder::PacketTemplate non_spoof_tmpl(p_spec.non_spoof);
+        if (!spoof_tmpl.valid() || !non_spoof_tmpl.valid() || p_spec.probe1.empty() || p_spec.probe2.empty() ||
+            p_spec.iterations == 0 || p_spec.seq_length == 0 || p_spec.batch_rate <= 0) {
+            std::cerr << LOG_TAG << " Invalid plan spec\n";
+            return false;
+        }
+
+        const size_t per_batch = p_spec.seq_length + 2;
+        const size_t frames = p_spec.iterations * per_batch;
+        const size_t stride = align(std::max({ p_spec.probe1.size(), p_spec.probe2.size(), spoof_tmpl.size(),
+                                               non_spoof_tmpl.size() }), 64);
+
+        Header header{};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.stride = static_cast<uint32_t>(stride);
+        header.seed = p_spec.seed;
+        header.iterations = p_spec.iterations;
+        header.frames = frames;
+        header.gap_ns = static_cast<uint64_t>(1e9 / p_spec.batch_rate);
+        header.batches_offset = align(sizeof(Header), 64);
+        header.lengths_offset = align(header.batches_offset + p_spec.iterations * sizeof(Batch), 64);
+        // Frames start on a page so the sender's iovecs never straddle the index
+        header.frames_offset = align(header.lengths_offset + frames * sizeof(uint16_t), 4096);
+        header.dst_ip = p_spec.spoof.dst_ip.network();
+        const size_t total = header.frames_offset + frames * stride;
+
+        int fd = open(p_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            std::cerr << LOG_TAG << " Failed to open " << p_path << ": " << strerror(errno) << "\n";
+            return false;
+        }
+        if (ftruncate(fd, static_cast<off_t>(total)) < 0) {
+            perror("ftruncate(plan)");
+            close(fd);
+            return false;
+        }
+        void* map = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) {
+            perror("mmap(plan)");
+            return false;
+        }
+
+        auto* base = static_cast<char*>(map);
+        std::memcpy(base, &header, sizeof(header));
+        auto* batches = reinterpret_cast<Batch*>(base + header.batches_offset);
+        auto* lengths = reinterpret_cast<uint16_t*>(base + header.lengths_offset);
+        char* frame_base = base + header.frames_offset;
+
+        // Same seq arithmetic as SingleQTrafficGen without live tracking
+        const std::string_view payload = p_spec.spoof.payload;
+        const uint32_t step = static_cast<uint32_t>(payload.size());
+        const uint32_t delta_seq = (!payload.empty() || p_spec.spoof.psh || p_spec.spoof.syn || p_spec.spoof.rst) ?
+                                    std::max(step, 1u) : 0;
+
+        Xoshiro256 rng(p_spec.seed);
+        uint32_t conn_seq = p_spec.spoof.seq;
+        size_t frame = 0;
+        auto put = [&](const char* p_data, size_t p_len) {
+            std::memcpy(frame_base + frame * stride, p_data, p_len);
+            lengths[frame++] = static_cast<uint16_t>(p_len);
+        };
+
+        for (size_t i = 0; i < p_spec.iterations; ++i) {
+            const bool in_connection = rng.bernoulli(p_spec.in_connection_ratio);
+            auto& tmpl = in_connection ? spoof_tmpl : non_spoof_tmpl;
+            const uint32_t seq = in_connection ? conn_seq : p_spec.non_spoof.seq;
+            const uint32_t ack = in_connection ? p_spec.spoof.ack : p_spec.non_spoof.ack;
+
+            Batch& batch = batches[i];
+            batch.first_frame = static_cast<uint32_t>(frame);
+            batch.frame_count = static_cast<uint32_t>(per_batch);
+            batch.seq = seq;
+            batch.ack = ack;
+            batch.in_connection = in_connection;
+
+            put(p_spec.probe1.data(), p_spec.probe1.size());
+            for (size_t k = 0; k < p_spec.seq_length; ++k) {
+                tmpl.set_seq(seq + static_cast<uint32_t>(k * step));
+                lengths[frame] = static_cast<uint16_t>(tmpl.render(frame_base + frame * stride));
+                frame++;
+            }
+            put(p_spec.probe2.data(), p_spec.probe2.size());
+
+            if (in_connection) {
+                conn_seq += delta_seq * static_cast<uint32_t>(p_spec.seq_length);
+            }
+        }
+
+        const bool synced = msync(map, total, MS_SYNC) == 0;
+        if (!synced) perror("msync(plan)");
+        munmap(map, total);
+        return synced;
+    }
+
+    File::File(const std::string& p_path) {
+        int fd = open(p_path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            std::cerr << LOG_TAG << " Failed to open " << p_path << ": " << strerror(errno) << "\n";
+            return;
+        }
+        struct stat st{};
+        if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+            std::cerr << LOG_TAG << " " << p_path << " is not a plan\n";
+            close(fd);
+            return;
+        }
+
+        // Populated up front, the send loop must not take page faults
+        m_map_len = static_cast<size_t>(st.st_size);
+        void* map = mmap(nullptr, m_map_len, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) {
+            perror("mmap(plan)");
+            return;
+        }
+        m_map = map;
+
+        const auto* base = static_cast<const char*>(m_map);
+        const auto* header = reinterpret_cast<const Header*>(base);
+        if (std::memcmp(header->magic, magic, sizeof(magic)) != 0 || header->version != version ||
+            header->batches_offset + header->iterations * sizeof(Batch) > header->lengths_offset ||
+            header->lengths_offset + header->frames * sizeof(uint16_t) > header->frames_offset ||
+            header->frames_offset + header->frames * header->stride > m_map_len) {
+            std::cerr << LOG_TAG << " " << p_path << " is not a version " << version << " plan\n";
+            return;
+        }
+
+        const auto* lengths = reinterpret_cast<const uint16_t*>(base + header->lengths_offset);
+        m_batches = { reinterpret_cast<const Batch*>(base + header->batches_offset), header->iterations };
+        for (const Batch& batch : m_batches) {
+            if (batch.first_frame + static_cast<uint64_t>(batch.frame_count) > header->frames) {
+                std::cerr << LOG_TAG << " " << p_path << " has a batch outside its frames\n";
+                return;
+            }
+        }
+
+        m_dest.sin_family = AF_INET;
+        m_dest.sin_addr.s_addr = header->dst_ip;
+        m_iovecs.resize(header->frames);
+        m_msgs.resize(header->frames);
+        for (size_t i = 0; i < header->frames; ++i) {
+            // sendmsg takes a non-const iovec, the kernel only reads from it
+            m_iovecs[i].iov_base = const_cast<char*>(base + header->frames_offset + i * header->stride);
+            m_iovecs[i].iov_len = lengths[i];
+            m_msgs[i] = {};
+            m_msgs[i].msg_hdr.msg_name = &m_dest;
+            m_msgs[i].msg_hdr.msg_namelen = sizeof(m_dest);
+            m_msgs[i].msg_hdr.msg_iov = &m_iovecs[i];
+            m_msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        m_header = header;
+    }
+
+    File::~File() {
+        if (m_map) {
+            munmap(m_map, m_map_len);
+        }
+    }
+
+    int File::send(int p_fd, size_t p_index) {
+        const Batch& batch = m_batches[p_index];
+        return sendmmsg(p_fd, &m_msgs[batch.first_frame], batch.frame_count, 0);
+    }
+
+} // namespace Plan
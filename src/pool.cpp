@@ -0,0 +1,272 @@
+#include "pool.hpp"
+#include "capture.hpp"
+#include <algorithm>
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+namespace Connection {
+
+    ConnectionPool::ConnectionPool(const std::string& p_src_ip, uint16_t p_first_port, size_t p_count,
+                                   const std::string& p_iface)
+        : m_src_ip(p_src_ip), m_first_port(p_first_port),
+          m_count(std::min<size_t>(p_count, 65536 - static_cast<size_t>(p_first_port))), m_iface(p_iface),
+          m_fds(m_count, -1), m_states(std::make_unique<State[]>(m_count)), m_synced(m_count, 0) {
+        if (m_count < p_count) {
+            std::cerr << LOG_TAG << " Port range ends at 65535, pool limited to " << m_count << " flows\n";
+        }
+        in_addr src{};
+        if (inet_pton(AF_INET, m_src_ip.c_str(), &src) != 1) {
+            std::cerr << LOG_TAG << " Invalid source IP address: " << m_src_ip << "\n";
+        }
+        m_src_addr = src.s_addr;
+
+        // One descriptor per flow plus a few spare, raise the soft limit as far as allowed
+        rlimit limit{};
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < m_count + 64) {
+            limit.rlim_cur = std::min<rlim_t>(limit.rlim_max, m_count + 64);
+            setrlimit(RLIMIT_NOFILE, &limit);
+        }
+    }
+
+    ConnectionPool::~ConnectionPool() {
+        disconnect();
+    }
+
+    bool ConnectionPool::open_ring(const std::string& p_dst_ip, uint16_t p_dst_port) {
+        in_addr dst{};
+        if (inet_pton(AF_INET, p_dst_ip.c_str(), &dst) != 1) {
+            std::cerr << LOG_TAG << " Invalid destination IP address: " << p_dst_ip << "\n";
+            return false;
+        }
+
+        // Every flow of the pool in both directions, told apart by source port in on_record()
+        m_ring = std::make_unique<Capture::Ring>(Capture::RingConfig{
+            .iface = m_iface,
+            .filter = Capture::Filter{
+                .direction = Capture::Filter::Direction::BOTH,
+                .src_ip = m_src_addr,
+                .dst_ip = dst.s_addr,
+                .dst_port = p_dst_port,
+                .symmetric = true,
+                .snap_len = 128
+            },
+            // Blocks retire after 1 ms however full, so many small ones
+            .block_size = 1U << 18,
+            .block_count = 64,
+            .block_timeout_ms = 1
+        });
+        if (!m_ring->valid()) {
+            std::cerr << LOG_TAG << " Failed to open capture ring for the pool.\n";
+            m_ring.reset();
+            return false;
+        }
+        return true;
+    }
+
+    void ConnectionPool::on_record(const Capture::Record& p_record) {
+        // Matched on address and port as in TCPClient::track, so a server on the same host works too
+        size_t index = static_cast<uint16_t>(p_record.src_port - m_first_port);
+        const bool outgoing = p_record.src_ip == m_src_addr && index < m_count;
+        if (!outgoing) index = static_cast<uint16_t>(p_record.dst_port - m_first_port);
+        if (index >= m_count) return;
+        State& state = m_states[index];
+
+        // The SYN-ACK fixes both sides, before it there is nothing to compare against
+        if (!m_synced[index]) {
+            if (!outgoing && (p_record.flags & (TH_SYN | TH_ACK)) == (TH_SYN | TH_ACK)) {
+                state.store(p_record.ack, p_record.seq + 1);
+                m_synced[index] = 1;
+            }
+            return;
+        }
+
+        // Same bookkeeping as TCPClient::track, SYN and FIN occupy one sequence number each
+        const uint32_t length = p_record.payload_len + ((p_record.flags & (TH_SYN | TH_FIN)) ? 1 : 0);
+        if (outgoing) {
+            state.advance_seq(p_record.seq + length);
+        } else {
+            if (p_record.flags & TH_ACK) state.advance_seq(p_record.ack);
+            state.advance_ack(p_record.seq + length);
+        }
+    }
+
+    size_t ConnectionPool::connect(const std::string& p_dst_ip, uint16_t p_dst_port, std::chrono::milliseconds p_timeout) {
+        if (m_ring) {
+            std::cerr << LOG_TAG << " Pool already connected. Disconnect first.\n";
+            return 0;
+        }
+
+        sockaddr_in dst_addr{};
+        dst_addr.sin_family = AF_INET;
+        dst_addr.sin_port = htons(p_dst_port);
+        if (inet_pton(AF_INET, p_dst_ip.c_str(), &dst_addr.sin_addr) != 1) {
+            std::cerr << LOG_TAG << " Invalid destination IP address: " << p_dst_ip << "\n";
+            return 0;
+        }
+
+        // Armed before the first SYN, so no SYN-ACK can slip past
+        if (!open_ring(p_dst_ip, p_dst_port)) return 0;
+
+        int epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (epfd < 0) {
+            perror("epoll_create1");
+            m_ring.reset();
+            return 0;
+        }
+
+        // Ring entries carry no fd, tag them with m_count
+        epoll_event ring_event{ .events = EPOLLIN, .data = { .u64 = m_count } };
+        epoll_ctl(epfd, EPOLL_CTL_ADD, m_ring->fd(), &ring_event);
+
+        auto drain = [this] {
+            m_ring->poll([this](const Capture::Record& r) { on_record(r); }, std::chrono::milliseconds(0));
+        };
+
+        const auto start = std::chrono::steady_clock::now();
+        size_t pending = 0, failed = 0;
+        for (size_t i = 0; i < m_count; ++i) {
+            // Early SYN-ACKs fill blocks while the later connects are still being issued
+            if (i % 64 == 63) drain();
+
+            int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (fd < 0) {
+                std::cerr << LOG_TAG << " Socket creation failed for flow " << i << ": " << strerror(errno) << "\n";
+                failed++;
+                continue;
+            }
+
+            int opt = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+            sockaddr_in src_addr{};
+            src_addr.sin_family = AF_INET;
+            src_addr.sin_port = htons(src_port(i));
+            src_addr.sin_addr.s_addr = m_src_addr;
+            if (bind(fd, reinterpret_cast<sockaddr*>(&src_addr), sizeof(src_addr)) < 0 ||
+                (::connect(fd, reinterpret_cast<sockaddr*>(&dst_addr), sizeof(dst_addr)) < 0 && errno != EINPROGRESS)) {
+                std::cerr << LOG_TAG << " Flow " << i << " (port " << src_port(i) << ") failed: " << strerror(errno) << "\n";
+                close(fd);
+                failed++;
+                continue;
+            }
+
+            m_fds[i] = fd;
+            epoll_event event{ .events = EPOLLOUT, .data = { .u64 = i } };
+            epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &event);
+            pending++;
+        }
+
+        // Wait for the handshakes and, for each one that completed, its SYN-ACK on the ring
+        auto unsynced = [this] {
+            size_t count = 0;
+            for (size_t i = 0; i < m_count; ++i) {
+                count += m_states[i].type == State::Type::CONNECTED && !m_synced[i];
+            }
+            return count;
+        };
+
+        std::vector<epoll_event> events(std::min<size_t>(m_count + 1, 1024));
+        const auto deadline = start + p_timeout;
+        while (pending > 0 || unsynced() > 0) {
+            const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0) break;
+
+            int ready = epoll_wait(epfd, events.data(), static_cast<int>(events.size()), static_cast<int>(left.count()));
+            if (ready < 0) {
+                if (errno == EINTR) continue;
+                perror("epoll_wait");
+                break;
+            }
+
+            for (int e = 0; e < ready; ++e) {
+                const size_t i = events[e].data.u64;
+                if (i == m_count) {
+                    drain();
+                    continue;
+                }
+
+                int error = 0;
+                socklen_t len = sizeof(error);
+                getsockopt(m_fds[i], SOL_SOCKET, SO_ERROR, &error, &len);
+                epoll_ctl(epfd, EPOLL_CTL_DEL, m_fds[i], nullptr);
+                pending--;
+                if (error) {
+                    std::cerr << LOG_TAG << " Flow " << i << " (port " << src_port(i) << ") failed: " << strerror(error) << "\n";
+                    close(m_fds[i]);
+                    m_fds[i] = -1;
+                    failed++;
+                } else {
+                    m_states[i].type = State::Type::CONNECTED;
+                }
+            }
+        }
+        close(epfd);
+
+        // Connected but never seen on the wire has no state to hand out, and a connect still in
+        // progress may complete later: close both, so a DISCONNECTED flow never holds an open socket
+        size_t ready = 0, untracked = 0;
+        for (size_t i = 0; i < m_count; ++i) {
+            if (m_fds[i] < 0) continue;
+            if (m_states[i].type == State::Type::CONNECTED && m_synced[i]) {
+                ready++;
+                continue;
+            }
+            untracked += m_states[i].type == State::Type::CONNECTED;
+            close(m_fds[i]);
+            m_fds[i] = -1;
+            m_states[i].type = State::Type::DISCONNECTED;
+        }
+
+        const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        std::cout << LOG_TAG << " Pool connected " << ready << "/" << m_count << " flows to " << p_dst_ip << ":"
+                  << p_dst_port << " in " << elapsed.count() << " ms (" << failed << " failed, " << pending
+                  << " timed out, " << untracked << " closed without a SYN-ACK on the ring)\n";
+        return ready;
+    }
+
+    void ConnectionPool::disconnect() {
+        stop_tracking();
+        for (size_t i = 0; i < m_count; ++i) {
+            if (m_fds[i] >= 0) {
+                close(m_fds[i]);
+                m_fds[i] = -1;
+            }
+            m_states[i].store(0, 0);
+            m_states[i].type = State::Type::DISCONNECTED;
+            m_synced[i] = 0;
+        }
+        m_ring.reset();
+    }
+
+    bool ConnectionPool::start_tracking() {
+        if (!m_ring) {
+            std::cerr << LOG_TAG << " Pool not connected, nothing to track.\n";
+            return false;
+        }
+        if (m_tracking) return true;
+
+        m_tracking = true;
+        m_tracker = std::thread(&ConnectionPool::track, this);
+        return true;
+    }
+
+    void ConnectionPool::stop_tracking() {
+        if (!m_tracking) return;
+        m_tracking = false;
+        m_tracker.join();
+    }
+
+    void ConnectionPool::track() {
+        while (m_tracking.load(std::memory_order_relaxed)) {
+            m_ring->poll([this](const Capture::Record& r) { on_record(r); }, std::chrono::milliseconds(10));
+        }
+    }
+
+} // namespace Connection
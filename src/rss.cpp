@@ -0,0 +1,169 @@
+#include "rss.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace Rss {
+
+    Toeplitz::Toeplitz(std::span<const uint8_t> p_key) {
+        if (p_key.size() < input_bytes + 4) {
+            std::cerr << LOG_TAG << " Key of " << p_key.size() << " bytes is too short\n";
+            return;
+        }
+
+        // 32-bit key window starting at bit b, for every bit of the input
+        auto window = [&p_key](size_t p_bit) {
+            const size_t byte = p_bit / 8, shift = p_bit % 8;
+            uint64_t bits = 0;
+            for (size_t i = 0; i < 5; i++) {
+                bits = (bits << 8) | p_key[byte + i];
+            }
+            return static_cast<uint32_t>(bits >> (8 - shift));
+        };
+
+        for (size_t i = 0; i < input_bytes; i++) {
+            std::array<uint32_t, 8> windows;
+            for (size_t bit = 0; bit < 8; bit++) {
+                windows[bit] = window(i * 8 + bit);
+            }
+            for (size_t value = 1; value < 256; value++) {
+                uint32_t result = 0;
+                for (size_t bit = 0; bit < 8; bit++) {
+                    if (value & (0x80 >> bit)) result ^= windows[bit];
+                }
+                m_table[i][value] = result;
+            }
+        }
+    }
+
+    uint32_t Toeplitz::partial(const Tuple& p_tuple) const {
+        const uint32_t src = p_tuple.src_ip.value, dst = p_tuple.dst_ip.value;
+        uint32_t result = 0;
+        for (size_t i = 0; i < 4; i++) {
+            result ^= m_table[i][(src >> (24 - 8 * i)) & 0xFF];
+            result ^= m_table[4 + i][(dst >> (24 - 8 * i)) & 0xFF];
+        }
+        return result ^ m_table[10][p_tuple.dst_port >> 8] ^ m_table[11][p_tuple.dst_port & 0xFF];
+    }
+
+    uint32_t Toeplitz::hash(const Tuple& p_tuple) const {
+        return with_src_port(partial(p_tuple), p_tuple.src_port);
+    }
+
+    size_t Config::queues() const {
+        return indirection.empty() ? 0 : *std::max_element(indirection.begin(), indirection.end()) + 1;
+    }
+
+    std::optional<Config> Config::parse(std::istream& p_in) {
+        // Format:
+        //   RX flow hash indirection table for eth0 with 4 RX ring(s):
+        //       0:      0     1     2     3     0     1     2     3
+        //   RSS hash key:
+        //   6d:5a:56:da:...
+        Config config;
+        bool key_next = false;
+        std::string line;
+        while (std::getline(p_in, line)) {
+            if (key_next) {
+                key_next = false;
+                std::istringstream hex(line);
+                std::string byte;
+                while (std::getline(hex, byte, ':')) {
+                    char* end = nullptr;
+                    const unsigned long value = std::strtoul(byte.c_str(), &end, 16);
+                    if (end == byte.c_str() || value > 0xFF) {
+                        config.key.clear();
+                        break;
+                    }
+                    config.key.push_back(static_cast<uint8_t>(value));
+                }
+                continue;
+            }
+            if (line.find("RSS hash key") != std::string::npos) {
+                key_next = true;
+                continue;
+            }
+
+            // Table rows start with "<index>:"
+            std::istringstream row(line);
+            size_t index;
+            char colon;
+            if (!(row >> index >> colon) || colon != ':' || index != config.indirection.size()) continue;
+            uint32_t queue;
+            while (row >> queue) {
+                config.indirection.push_back(queue);
+            }
+        }
+
+        if (config.key.size() < Toeplitz::input_bytes + 4 || config.indirection.empty()) return std::nullopt;
+        return config;
+    }
+
+    std::optional<Config> Config::from_file(const std::string& p_path) {
+        std::ifstream in(p_path);
+        if (!in) {
+            std::cerr << LOG_TAG << " Failed to open " << p_path << "\n";
+            return std::nullopt;
+        }
+        auto config = parse(in);
+        if (!config) std::cerr << LOG_TAG << " No RSS key and indirection table in " << p_path << "\n";
+        return config;
+    }
+
+    std::optional<Config> Config::from_ethtool(std::string_view p_iface) {
+        for (char c : p_iface) {
+            if (!std::isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_' && c != '.') {
+                std::cerr << LOG_TAG << " Invalid interface name " << p_iface << "\n";
+                return std::nullopt;
+            }
+        }
+
+        const std::string command = "ethtool -x " + std::string(p_iface) + " 2>/dev/null";
+        FILE* pipe = popen(command.c_str(), "r");
+        if (!pipe) {
+            perror("popen(ethtool)");
+            return std::nullopt;
+        }
+        std::string output;
+        char buffer[4096];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+            output.append(buffer, read);
+        }
+        pclose(pipe);
+
+        std::istringstream in(output);
+        auto config = parse(in);
+        if (!config) std::cerr << LOG_TAG << " ethtool -x " << p_iface << " reported no RSS key and table\n";
+        return config;
+    }
+
+    Steering::Steering(const Config& p_config)
+        : m_hash(p_config.key), m_indirection(p_config.indirection), m_queues(p_config.queues()) {
+        if (m_indirection.empty()) m_indirection.push_back(0);
+    }
+
+    std::vector<std::vector<uint16_t>> Steering::find_ports(const Tuple& p_tuple, std::span<const uint32_t> p_queues,
+                                                            size_t p_per_queue, uint16_t p_first,
+                                                            uint16_t p_last) const {
+        std::vector<std::vector<uint16_t>> ports(p_queues.size());
+        size_t missing = p_queues.size();
+
+        // Only the source port varies: two table lookups per candidate
+        const uint32_t partial = m_hash.partial(p_tuple);
+        for (uint32_t port = p_first; port <= p_last && missing > 0; port++) {
+            const uint32_t queue = queue_of(m_hash.with_src_port(partial, static_cast<uint16_t>(port)));
+            for (size_t q = 0; q < p_queues.size(); q++) {
+                if (p_queues[q] != queue || ports[q].size() == p_per_queue) continue;
+                ports[q].push_back(static_cast<uint16_t>(port));
+                if (ports[q].size() == p_per_queue) missing--;
+            }
+        }
+        return ports;
+    }
+
+} // namespace Rss
@@ -0,0 +1,322 @@
+#include "sender.hpp"
+#include "uring.hpp"
+#include "xdp.hpp"
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+namespace Sender {
+
+    int setup_raw_socket(const std::string_view p_iface) {
+        int sock = socket(AF_INET, SOCK_RAW, IPPROTO_RAW);
+        if (sock < 0) {
+            perror("socket");
+            return -1;
+        }
+
+        if (setsockopt(sock, SOL_SOCKET, SO_BINDTODEVICE, p_iface.data(), p_iface.size() + 1) < 0) {
+            perror("setsockopt(SO_BINDTODEVICE)");
+            close(sock);
+            return -1;
+        }
+
+        int opt = 1;
+        if (setsockopt(sock, IPPROTO_IP, IP_HDRINCL, &opt, sizeof(opt)) < 0) {
+            perror("setsockopt(IP_HDRINCL)");
+            close(sock);
+            return -1;
+        }
+
+        return sock;
+    }
+
+    bool interface_mac(std::string_view p_iface, PacketBuilder::MacAddress& p_mac) {
+        int sock = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sock < 0) {
+            perror("socket");
+            return false;
+        }
+
+        ifreq ifr{};
+        std::strncpy(ifr.ifr_name, std::string(p_iface).c_str(), IFNAMSIZ - 1);
+        bool ok = ioctl(sock, SIOCGIFHWADDR, &ifr) == 0;
+        if (ok) {
+            std::memcpy(p_mac.data(), ifr.ifr_hwaddr.sa_data, p_mac.size());
+        } else {
+            std::cerr << LOG_TAG << " SIOCGIFHWADDR on " << p_iface << " failed: " << strerror(errno) << "\n";
+        }
+        close(sock);
+        return ok;
+    }
+
+    bool resolve_mac(std::string_view p_iface, const in_addr& p_addr, PacketBuilder::MacAddress& p_mac) {
+        // Loopback and NOARP devices accept any destination address
+        int sock = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sock >= 0) {
+            ifreq ifr{};
+            std::strncpy(ifr.ifr_name, std::string(p_iface).c_str(), IFNAMSIZ - 1);
+            bool no_arp = ioctl(sock, SIOCGIFFLAGS, &ifr) == 0 && (ifr.ifr_flags & (IFF_LOOPBACK | IFF_NOARP));
+            close(sock);
+            if (no_arp) {
+                p_mac.fill(0);
+                return true;
+            }
+        }
+
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &p_addr, ip, sizeof(ip));
+
+        // Format: IP address, HW type, Flags, HW address, Mask, Device
+        std::ifstream arp("/proc/net/arp");
+        std::string line;
+        std::getline(arp, line);
+        while (std::getline(arp, line)) {
+            std::istringstream fields(line);
+            std::string addr, hw_type, flags, hw_addr, mask, device;
+            fields >> addr >> hw_type >> flags >> hw_addr >> mask >> device;
+            if (addr != ip || device != p_iface || flags == "0x0") continue;
+
+            unsigned int b[6];
+            if (std::sscanf(hw_addr.c_str(), "%x:%x:%x:%x:%x:%x", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5]) == 6) {
+                for (size_t i = 0; i < p_mac.size(); i++) p_mac[i] = static_cast<uint8_t>(b[i]);
+                return true;
+            }
+        }
+
+        std::cerr << LOG_TAG << " No ARP entry for " << ip << " on " << p_iface
+                  << ", ping it once to populate the neighbour table.\n";
+        return false;
+    }
+
+    RawSocket::RawSocket(std::string_view p_iface)
+        : m_fd(setup_raw_socket(p_iface)) {}
+
+    RawSocket::~RawSocket() {
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+    }
+
+    int RawSocket::send(PacketBuilder::BatchSlab& p_batch) {
+        return sendmmsg(m_fd, p_batch.msgs(), p_batch.size(), 0);
+    }
+
+    TxRing::TxRing(std::string_view p_iface, const PacketBuilder::MacAddress& p_dst_mac,
+                   uint32_t p_frame_size, uint32_t p_frame_count)
+        : m_frame_size(p_frame_size), m_frame_count(p_frame_count),
+          m_data_offset(TPACKET_ALIGN(sizeof(tpacket2_hdr))) {
+        m_max_length = frame_capacity() - m_eth_header.size();
+
+        PacketBuilder::MacAddress src_mac{};
+        if (!interface_mac(p_iface, src_mac)) return;
+        m_eth_header = PacketBuilder::build_ethernet_header(src_mac, p_dst_mac);
+
+        const unsigned int ifindex = if_nametoindex(std::string(p_iface).c_str());
+        if (ifindex == 0) {
+            std::cerr << LOG_TAG << " Unknown interface " << p_iface << ": " << strerror(errno) << "\n";
+            return;
+        }
+
+        // Protocol 0: transmit only, nothing is ever queued for reception
+        m_fd = socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC, 0);
+        if (m_fd < 0) {
+            perror("socket(AF_PACKET)");
+            return;
+        }
+
+        int version = TPACKET_V2;
+        int bypass = 1;
+        if (setsockopt(m_fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+            perror("setsockopt(PACKET_VERSION)");
+            close(m_fd);
+            m_fd = -1;
+            return;
+        }
+        if (setsockopt(m_fd, SOL_PACKET, PACKET_QDISC_BYPASS, &bypass, sizeof(bypass)) < 0) {
+            std::cerr << LOG_TAG << " PACKET_QDISC_BYPASS unavailable, frames go through the qdisc.\n";
+        }
+        // The kernel refuses frames beyond the MTU, send() drops those before they reach the ring
+        ifreq ifr{};
+        std::strncpy(ifr.ifr_name, std::string(p_iface).c_str(), IFNAMSIZ - 1);
+        if (ioctl(m_fd, SIOCGIFMTU, &ifr) == 0) {
+            m_max_length = std::min<size_t>(m_max_length, static_cast<size_t>(ifr.ifr_mtu));
+        } else {
+            std::cerr << LOG_TAG << " SIOCGIFMTU on " << p_iface << " failed: " << strerror(errno) << "\n";
+        }
+
+        const uint32_t page = static_cast<uint32_t>(sysconf(_SC_PAGESIZE));
+        tpacket_req req{};
+        req.tp_frame_size = m_frame_size;
+        req.tp_block_size = std::max(page, m_frame_size);
+        req.tp_block_nr = m_frame_count / (req.tp_block_size / m_frame_size);
+        req.tp_frame_nr = req.tp_block_nr * (req.tp_block_size / m_frame_size);
+        m_frame_count = req.tp_frame_nr;
+        if (setsockopt(m_fd, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) < 0) {
+            perror("setsockopt(PACKET_TX_RING)");
+            close(m_fd);
+            m_fd = -1;
+            return;
+        }
+
+        m_map_len = static_cast<size_t>(req.tp_block_size) * req.tp_block_nr;
+        void* map = mmap(nullptr, m_map_len, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        if (map == MAP_FAILED) {
+            perror("mmap(PACKET_TX_RING)");
+            close(m_fd);
+            m_fd = -1;
+            return;
+        }
+
+        // Still protocol 0: a non-zero one would register a receive hook and clone every inbound
+        // frame into this socket. The kernel takes each frame's protocol from its Ethernet header.
+        sockaddr_ll addr{};
+        addr.sll_family = AF_PACKET;
+        addr.sll_protocol = 0;
+        addr.sll_ifindex = static_cast<int>(ifindex);
+        if (bind(m_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            perror("bind(AF_PACKET)");
+            munmap(map, m_map_len);
+            close(m_fd);
+            m_fd = -1;
+            return;
+        }
+
+        m_map = static_cast<uint8_t*>(map);
+    }
+
+    TxRing::~TxRing() {
+        if (m_map) {
+            munmap(m_map, m_map_len);
+        }
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+    }
+
+    char* TxRing::acquire() {
+        tpacket2_hdr* hdr = frame_header(m_frame_index);
+        if (__atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE) != TP_STATUS_AVAILABLE) {
+            return nullptr;
+        }
+        return reinterpret_cast<char*>(hdr) + m_data_offset;
+    }
+
+    void TxRing::commit(size_t p_length) {
+        tpacket2_hdr* hdr = frame_header(m_frame_index);
+        hdr->tp_len = static_cast<uint32_t>(p_length);
+        __atomic_store_n(&hdr->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+        m_frame_index = (m_frame_index + 1) % m_frame_count;
+        m_pending++;
+    }
+
+    int TxRing::flush() {
+        if (m_pending == 0) return 0;
+        const uint32_t pending = m_pending;
+        m_pending = 0;
+
+        // Blocks until the kernel has handed every pending frame to the driver
+        if (::send(m_fd, nullptr, 0, 0) >= 0) {
+            return static_cast<int>(pending);
+        }
+        const int error = errno;
+
+        // A frame the kernel refuses is marked WRONG_FORMAT and the kernel's ring position stays
+        // on it (no PACKET_LOSS, which would hide the drop). Hand it and the frames queued behind
+        // it back and continue from there, so both sides agree on the next frame again.
+        const uint32_t first = (m_frame_index + m_frame_count - pending) % m_frame_count;
+        for (uint32_t k = 0; k < pending; k++) {
+            const uint32_t index = (first + k) % m_frame_count;
+            if (__atomic_load_n(&frame_header(index)->tp_status, __ATOMIC_ACQUIRE) != TP_STATUS_WRONG_FORMAT) continue;
+            for (uint32_t j = k; j < pending; j++) {
+                __atomic_store_n(&frame_header((first + j) % m_frame_count)->tp_status, TP_STATUS_AVAILABLE,
+                                 __ATOMIC_RELEASE);
+            }
+            m_frame_index = index;
+            break;
+        }
+        errno = error;
+        return -1;
+    }
+
+    int TxRing::send(PacketBuilder::BatchSlab& p_batch) {
+        int sent = 0;
+        for (size_t i = 0; i < p_batch.size(); i++) {
+            const size_t len = p_batch.length(i);
+            if (len > m_max_length) {
+                if (!m_oversize_reported) {
+                    std::cerr << LOG_TAG << " Dropping " << len << " byte packets, at most " << m_max_length
+                              << " fit the MTU and ring frame\n";
+                    m_oversize_reported = true;
+                }
+                continue;
+            }
+
+            char* frame = acquire();
+            if (!frame) {
+                // Ring full: push out what is queued so far and retry once
+                int flushed = flush();
+                if (flushed < 0) return -1;
+                sent += flushed;
+                if (!(frame = acquire())) return sent;
+            }
+
+            std::memcpy(frame, m_eth_header.data(), m_eth_header.size());
+            std::memcpy(frame + m_eth_header.size(), p_batch.slot(i), len);
+            commit(m_eth_header.size() + len);
+        }
+
+        int flushed = flush();
+        if (flushed < 0) return -1;
+        return sent + flushed;
+    }
+
+    std::unique_ptr<Backend> create(Type p_type, std::string_view p_iface, const sockaddr_in& p_dest,
+                                    const Options& p_options) {
+        std::unique_ptr<Backend> backend;
+        switch (p_type) {
+            case Type::RAW_SOCKET:
+                backend = std::make_unique<RawSocket>(p_iface);
+                break;
+            case Type::TX_RING: {
+                PacketBuilder::MacAddress dst_mac{};
+                if (!resolve_mac(p_iface, p_dest.sin_addr, dst_mac)) return nullptr;
+                backend = std::make_unique<TxRing>(p_iface, dst_mac);
+                break;
+            }
+            case Type::XDP: {
+                PacketBuilder::MacAddress dst_mac{};
+                if (!resolve_mac(p_iface, p_dest.sin_addr, dst_mac)) return nullptr;
+                backend = std::make_unique<Xdp::Socket>(
+                    Xdp::Config{ .iface = std::string(p_iface), .queue_id = p_options.queue }, dst_mac);
+                break;
+            }
+            case Type::IO_URING:
+                backend = std::make_unique<Uring::Socket>(Uring::Config{
+                    .iface = std::string(p_iface),
+                    .entries = p_options.ring_entries,
+                    .sqpoll = p_options.sqpoll,
+                    .sqpoll_cpu = p_options.sqpoll_cpu,
+                    .sqpoll_idle_ms = p_options.sqpoll_idle_ms
+                });
+                break;
+        }
+
+        if (!backend || !backend->valid()) {
+            std::cerr << LOG_TAG << " Failed to set up sender backend on " << p_iface << "\n";
+            return nullptr;
+        }
+        return backend;
+    }
+
+} // namespace Sender
@@ -0,0 +1,184 @@
+#include "sink.hpp"
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+namespace Sink {
+
+    std::ostream& operator<<(std::ostream& os, const Stats& stats) {
+        os << LOG_TAG << " " << stats.connections << " connections, " << stats.bytes << " bytes read\n";
+        if (stats.segments || stats.acks) {
+            os << LOG_TAG << " Captured " << stats.segments << " segments (" << stats.segment_bytes
+               << " payload bytes) in, " << stats.acks << " ACKs out, " << stats.ring_drops << " dropped\n";
+        }
+        return os;
+    }
+
+    Server::Server(const Config& p_config)
+        : m_config(p_config), m_buffer(1 << 16) {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(m_config.port);
+        if (inet_pton(AF_INET, m_config.bind_ip.c_str(), &addr.sin_addr) != 1) {
+            std::cerr << LOG_TAG << " Invalid bind address: " << m_config.bind_ip << "\n";
+            return;
+        }
+
+        // The capture log goes first, it has to see the first handshake
+        if (!m_config.iface.empty()) {
+            m_ring = std::make_unique<Capture::Ring>(Capture::RingConfig{
+                .iface = m_config.iface,
+                .filter = Capture::Filter{
+                    .direction = Capture::Filter::Direction::BOTH,
+                    .dst_port = m_config.port,
+                    .symmetric = true,
+                    .snap_len = 128
+                },
+                .block_size = 1U << 20,
+                .block_count = 64,
+                .block_timeout_ms = 10
+            });
+            if (!m_ring->valid()) {
+                std::cerr << LOG_TAG << " No capture on " << m_config.iface << ", logging counters only.\n";
+                m_ring.reset();
+            }
+        }
+        if (m_ring && !m_config.log_path.empty()) {
+            m_log.open(m_config.log_path);
+            if (!m_log) {
+                std::cerr << LOG_TAG << " Failed to open " << m_config.log_path << "\n";
+            } else {
+                m_log << "order,timestamp_ns,direction,src_ip,src_port,dst_ip,dst_port,seq,ack,payload_len,flags\n";
+            }
+        }
+
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            perror("socket");
+            return;
+        }
+        int opt = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+            std::cerr << LOG_TAG << " Cannot listen on " << m_config.bind_ip << ":" << m_config.port << ": "
+                      << strerror(errno) << "\n";
+            close(fd);
+            return;
+        }
+
+        m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (m_epoll_fd < 0) {
+            perror("epoll_create1");
+            close(fd);
+            return;
+        }
+        epoll_event event{ .events = EPOLLIN, .data = { .fd = fd } };
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &event);
+        if (m_ring) {
+            epoll_event ring_event{ .events = EPOLLIN, .data = { .fd = m_ring->fd() } };
+            epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_ring->fd(), &ring_event);
+        }
+        m_listen_fd = fd;
+    }
+
+    Server::~Server() {
+        for (int fd : m_connections) {
+            close(fd);
+        }
+        if (m_listen_fd >= 0) {
+            close(m_listen_fd);
+        }
+        if (m_epoll_fd >= 0) {
+            close(m_epoll_fd);
+        }
+    }
+
+    void Server::accept_all() {
+        while (true) {
+            int fd = accept4(m_listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) perror("accept4");
+                return;
+            }
+            epoll_event event{ .events = EPOLLIN | EPOLLRDHUP, .data = { .fd = fd } };
+            epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &event);
+            m_connections.insert(fd);
+            m_stats.connections++;
+        }
+    }
+
+    void Server::drain(int p_fd) {
+        while (true) {
+            const ssize_t n = read(p_fd, m_buffer.data(), m_buffer.size());
+            if (n > 0) {
+                m_stats.bytes += static_cast<uint64_t>(n);
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+            if (n < 0 && errno == EINTR) continue;
+
+            // EOF or reset, closing also drops it from the epoll set
+            m_connections.erase(p_fd);
+            close(p_fd);
+            return;
+        }
+    }
+
+    void Server::on_record(const Capture::Record& p_record) {
+        if (p_record.outgoing) {
+            m_stats.acks++;
+        } else {
+            m_stats.segments++;
+            m_stats.segment_bytes += p_record.payload_len;
+        }
+        if (!m_log.is_open()) return;
+
+        char src[INET_ADDRSTRLEN], dst[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &p_record.src_ip, src, sizeof(src));
+        inet_ntop(AF_INET, &p_record.dst_ip, dst, sizeof(dst));
+        m_log << m_order++ << "," << p_record.timestamp_ns << "," << (p_record.outgoing ? "out" : "in") << ","
+              << src << "," << p_record.src_port << "," << dst << "," << p_record.dst_port << "," << p_record.seq
+              << "," << p_record.ack << "," << p_record.payload_len << "," << static_cast<int>(p_record.flags) << "\n";
+    }
+
+    void Server::run() {
+        if (!valid()) return;
+        std::cout << LOG_TAG << " Listening on " << m_config.bind_ip << ":" << m_config.port
+                  << (m_ring ? ", capturing on " + m_config.iface : std::string()) << "\n";
+
+        std::vector<epoll_event> events(256);
+        while (m_running.load(std::memory_order_relaxed)) {
+            // Bounded wait so stop() is noticed without a wakeup of its own
+            const int ready = epoll_wait(m_epoll_fd, events.data(), static_cast<int>(events.size()), 100);
+            if (ready < 0) {
+                if (errno == EINTR) continue;
+                perror("epoll_wait");
+                break;
+            }
+
+            for (int e = 0; e < ready; ++e) {
+                const int fd = events[e].data.fd;
+                if (fd == m_listen_fd) {
+                    accept_all();
+                } else if (m_ring && fd == m_ring->fd()) {
+                    m_ring->poll([this](const Capture::Record& r) { on_record(r); }, std::chrono::milliseconds(0));
+                } else {
+                    drain(fd);
+                }
+            }
+        }
+
+        // Blocks still held by the kernel retire within the block timeout
+        if (m_ring) {
+            m_ring->poll([this](const Capture::Record& r) { on_record(r); }, std::chrono::milliseconds(20));
+            m_stats.ring_drops = m_ring->stats().drops;
+        }
+        m_log.flush();
+    }
+
+} // namespace Sink
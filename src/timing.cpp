@@ -0,0 +1,128 @@
+#include "timing.hpp"
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <bit>
+#include <cerrno>
+#include <pthread.h>
+#include <sched.h>
+
+namespace Timing {
+
+    static uint64_t monotonic_ns() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+    }
+
+    static double calibrate() {
+#if defined(__x86_64__) || defined(__i386__)
+        const uint64_t ns_start = monotonic_ns();
+        const uint64_t tsc_start = rdtsc();
+        while (monotonic_ns() - ns_start < 20000000ULL) {
+            // Spin for 20 ms, long enough to push the error below 0.01 %
+        }
+        const uint64_t ns_end = monotonic_ns();
+        const uint64_t tsc_end = rdtsc();
+        return static_cast<double>(tsc_end - tsc_start) / static_cast<double>(ns_end - ns_start);
+#else
+        return 1.0;
+#endif
+    }
+
+    double ticks_per_ns() {
+        static const double ratio = calibrate();
+        return ratio;
+    }
+
+    bool pin_thread(int p_cpu) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(p_cpu, &set);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err != 0) {
+            std::cerr << LOG_TAG << " Failed to pin thread to CPU " << p_cpu << ": " << strerror(err) << "\n";
+            return false;
+        }
+        return true;
+    }
+
+    Pacer::Pacer(uint64_t p_gap_ns, uint64_t p_spin_ns)
+        : m_gap_ns(p_gap_ns), m_spin_ns(p_spin_ns) {}
+
+    Pacer Pacer::from_rate(double p_per_second, uint64_t p_spin_ns) {
+        return Pacer(static_cast<uint64_t>(1e9 / p_per_second), p_spin_ns);
+    }
+
+    void Pacer::start() {
+        start(rdtsc());
+    }
+
+    void Pacer::start(uint64_t p_first_deadline_tsc) {
+        // Map the TSC deadline onto CLOCK_MONOTONIC for the sleeping part of each wait
+        ticks_per_ns();
+        const uint64_t now_tsc = rdtsc();
+        const uint64_t now_ns = monotonic_ns();
+        m_start_tsc = p_first_deadline_tsc;
+        m_start_ns = p_first_deadline_tsc >= now_tsc ? now_ns + ticks_to_ns(p_first_deadline_tsc - now_tsc)
+                                                     : now_ns - ticks_to_ns(now_tsc - p_first_deadline_tsc);
+        m_index = 0;
+        m_first_release = m_last_release = 0;
+        m_late_sum = m_late_max = 0;
+        m_histogram.fill(0);
+    }
+
+    uint64_t Pacer::wait() {
+        return wait_until(m_index * m_gap_ns);
+    }
+
+    uint64_t Pacer::wait_until(uint64_t p_offset_ns) {
+        const uint64_t deadline_ns = m_start_ns + p_offset_ns;
+        const uint64_t deadline_tsc = m_start_tsc + ns_to_ticks(p_offset_ns);
+
+        if (deadline_ns > m_spin_ns + monotonic_ns()) {
+            const uint64_t wake_ns = deadline_ns - m_spin_ns;
+            timespec wake{ static_cast<time_t>(wake_ns / 1000000000ULL), static_cast<long>(wake_ns % 1000000000ULL) };
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, nullptr) == EINTR) {}
+        }
+        spin_until(deadline_tsc);
+
+        const uint64_t released = rdtsc();
+        const uint64_t late = ticks_to_ns(released - deadline_tsc);
+        if (m_index == 0) m_first_release = released;
+        m_last_release = released;
+        m_late_sum += late;
+        m_late_max = std::max(m_late_max, late);
+        m_histogram[std::min<size_t>(late ? std::bit_width(late) - 1 : 0, histogram_buckets - 1)]++;
+        m_index++;
+        return late;
+    }
+
+    Pacer::Report Pacer::report() const {
+        Report report;
+        report.releases = m_index;
+        report.target_rate = m_gap_ns ? 1e9 / static_cast<double>(m_gap_ns) : 0;
+        if (m_index > 1 && m_last_release > m_first_release) {
+            report.achieved_rate = static_cast<double>(m_index - 1) * 1e9 /
+                                   static_cast<double>(ticks_to_ns(m_last_release - m_first_release));
+        }
+        report.mean_late_ns = m_index ? m_late_sum / m_index : 0;
+        report.max_late_ns = m_late_max;
+        report.histogram = m_histogram;
+        return report;
+    }
+
+    std::ostream& operator<<(std::ostream& os, const Pacer::Report& report) {
+        os << LOG_TAG << " Releases: " << report.releases << ", ";
+        if (report.target_rate > 0) os << "target " << report.target_rate << "/s, ";
+        os << "achieved " << report.achieved_rate << "/s, lateness mean " << report.mean_late_ns
+           << " ns, max " << report.max_late_ns << " ns\n";
+        for (size_t b = 0; b < report.histogram.size(); b++) {
+            if (report.histogram[b] == 0) continue;
+            os << LOG_TAG << "   [" << (b ? (1ULL << b) : 0) << ", " << (1ULL << (b + 1)) << ") ns: "
+               << report.histogram[b] << "\n";
+        }
+        return os;
+    }
+
+} // namespace Timing
@@ -0,0 +1,160 @@
+#include "trace.hpp"
+#include "timing.hpp"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <sys/stat.h>
+
+namespace Trace {
+
+    namespace {
+        // Magic, version 1.0, header length, then the dict padded so the data starts at 128.
+        // The shape is only known at the end, so the header is written twice with the same length.
+        constexpr size_t HEADER_SIZE = 128;
+
+        std::string npy_header(const std::string& p_descr, uint64_t p_count) {
+            std::string dict = "{'descr': '" + p_descr + "', 'fortran_order': False, 'shape': (" +
+                               std::to_string(p_count) + ",), }";
+            const size_t prefix = 10;
+            dict.resize(HEADER_SIZE - prefix - 1, ' ');
+            dict += '\n';
+
+            std::string header("\x93NUMPY\x01\x00", 8);
+            header += static_cast<char>(dict.size() & 0xff);
+            header += static_cast<char>(dict.size() >> 8);
+            return header + dict;
+        }
+
+        template <typename T>
+        void gather(char* p_out, const Chunk& p_chunk, T Record::* p_field) {
+            for (size_t i = 0; i < p_chunk.count; i++) {
+                std::memcpy(p_out + i * sizeof(T), &(p_chunk.records[i].*p_field), sizeof(T));
+            }
+        }
+    }
+
+    Recorder::Recorder(const std::string& p_dir, size_t p_chunks)
+        : m_dir(p_dir), m_chunks(p_chunks), m_buffer(Chunk::capacity * sizeof(uint64_t)) {
+        if (mkdir(m_dir.c_str(), 0755) < 0 && errno != EEXIST) {
+            std::cerr << LOG_TAG << " Cannot create " << m_dir << ": " << strerror(errno) << "\n";
+            return;
+        }
+
+        // Little-endian, the order matches the switch in drain()
+        m_columns = {
+            { "batch",     "<u8", 8 },
+            { "thread",    "<u2", 2 },
+            { "scenario",  "|u1", 1 },
+            { "seq",       "<u4", 4 },
+            { "ack",       "<u4", 4 },
+            { "tsc_start", "<u8", 8 },
+            { "tsc_end",   "<u8", 8 },
+            { "sent",      "<i4", 4 },
+            { "error",     "<i4", 4 },
+        };
+        for (auto& column : m_columns) {
+            const std::string path = m_dir + "/" + column.name + ".npy";
+            column.file = std::fopen(path.c_str(), "wb");
+            if (!column.file) {
+                std::cerr << LOG_TAG << " Cannot open " << path << ": " << strerror(errno) << "\n";
+                return;
+            }
+            std::setvbuf(column.file, nullptr, _IOFBF, 1 << 20);
+            const std::string header = npy_header(column.descr, 0);
+            std::fwrite(header.data(), 1, header.size(), column.file);
+        }
+
+        Timing::ticks_per_ns();     // calibrate here, not in the first producer's loop
+        m_writer = std::thread([this] { write(); });
+    }
+
+    Recorder::~Recorder() {
+        stop();
+        for (auto& column : m_columns) {
+            if (column.file) std::fclose(column.file);
+        }
+    }
+
+    Stream& Recorder::stream() {
+        std::lock_guard lock(m_streams_mutex);
+        m_streams.push_back(std::make_unique<Stream>(static_cast<uint16_t>(m_streams.size()), m_chunks));
+        return *m_streams.back();
+    }
+
+    uint64_t Recorder::dropped() const {
+        uint64_t dropped = 0;
+        for (const auto& stream : m_streams) dropped += stream->dropped();
+        return dropped;
+    }
+
+    size_t Recorder::drain(Stream& p_stream) {
+        size_t chunks = 0;
+        while (Chunk* chunk = p_stream.ring().try_front()) {
+            const uint16_t id = p_stream.id();
+            char* out = m_buffer.data();
+            for (size_t c = 0; c < m_columns.size(); c++) {
+                switch (c) {
+                    case 0: gather(out, *chunk, &Record::batch); break;
+                    case 1: for (size_t i = 0; i < chunk->count; i++) std::memcpy(out + i * 2, &id, 2); break;
+                    case 2: gather(out, *chunk, &Record::scenario); break;
+                    case 3: gather(out, *chunk, &Record::seq); break;
+                    case 4: gather(out, *chunk, &Record::ack); break;
+                    case 5: gather(out, *chunk, &Record::tsc_start); break;
+                    case 6: gather(out, *chunk, &Record::tsc_end); break;
+                    case 7: gather(out, *chunk, &Record::sent); break;
+                    case 8: gather(out, *chunk, &Record::error); break;
+                }
+                std::fwrite(out, m_columns[c].width, chunk->count, m_columns[c].file);
+            }
+            m_records += chunk->count;
+            p_stream.ring().pop();
+            chunks++;
+        }
+        return chunks;
+    }
+
+    void Recorder::write() {
+        while (true) {
+            // Read the flag first: whatever was published before stop() is seen by this pass
+            const bool stopping = m_stop.load(std::memory_order_acquire);
+            size_t chunks = 0;
+            {
+                std::lock_guard lock(m_streams_mutex);
+                for (auto& stream : m_streams) chunks += drain(*stream);
+            }
+            if (stopping) return;
+
+            // Chunks take a while to fill, nothing is lost by sleeping between passes
+            if (!chunks) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    bool Recorder::finish() {
+        bool ok = true;
+        for (auto& column : m_columns) {
+            const std::string header = npy_header(column.descr, m_records);
+            if (std::fflush(column.file) != 0 || std::fseek(column.file, 0, SEEK_SET) != 0 ||
+                std::fwrite(header.data(), 1, header.size(), column.file) != header.size() ||
+                std::fflush(column.file) != 0) {
+                std::cerr << LOG_TAG << " Failed to finish " << m_dir << "/" << column.name << ".npy\n";
+                ok = false;
+            }
+        }
+
+        std::ofstream meta(m_dir + "/meta.json");
+        meta << std::setprecision(12) << "{\"ticks_per_ns\": " << Timing::ticks_per_ns()
+             << ", \"records\": " << m_records << ", \"dropped\": " << dropped() << ", \"streams\": " << m_streams.size() << "}\n";
+        return ok && static_cast<bool>(meta);
+    }
+
+    void Recorder::stop() {
+        if (!m_writer.joinable()) return;
+        m_stop.store(true, std::memory_order_release);
+        m_writer.join();
+        finish();
+    }
+
+} // namespace Trace
@@ -0,0 +1,285 @@
+#include "txstamp.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/errqueue.h>
+#include <linux/if_packet.h>
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
+
+namespace TxStamp {
+
+    static uint64_t to_ns(const timespec& p_ts) {
+        return static_cast<uint64_t>(p_ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(p_ts.tv_nsec);
+    }
+
+    static bool set_hwtstamp(int p_fd, std::string_view p_iface, hwtstamp_config& p_config, unsigned long p_request) {
+        ifreq ifr{};
+        std::strncpy(ifr.ifr_name, std::string(p_iface).c_str(), IFNAMSIZ - 1);
+        ifr.ifr_data = reinterpret_cast<char*>(&p_config);
+        return ioctl(p_fd, p_request, &ifr) == 0;
+    }
+
+    // Switch on NIC TX timestamping, keeping whatever RX filter is configured. p_saved receives
+    // the setting to restore afterwards, nothing if it was already on.
+    static bool enable_hardware(int p_fd, std::string_view p_iface, std::optional<hwtstamp_config>& p_saved) {
+        hwtstamp_config config{};
+        if (!set_hwtstamp(p_fd, p_iface, config, SIOCGHWTSTAMP)) {
+            // Drivers without SIOCGHWTSTAMP start out with timestamping off
+            config = hwtstamp_config{};
+            config.tx_type = HWTSTAMP_TX_OFF;
+            config.rx_filter = HWTSTAMP_FILTER_NONE;
+        }
+        if (config.tx_type == HWTSTAMP_TX_ON) return true;
+
+        const hwtstamp_config previous = config;
+        config.tx_type = HWTSTAMP_TX_ON;
+        if (!set_hwtstamp(p_fd, p_iface, config, SIOCSHWTSTAMP)) {
+            std::cerr << LOG_TAG << " No hardware TX timestamps on " << p_iface << " (" << strerror(errno)
+                      << "), using software timestamps.\n";
+            return false;
+        }
+        p_saved = previous;
+        return true;
+    }
+
+    Recorder::Recorder(int p_fd, std::string_view p_iface, Layout p_layout, size_t p_bursts, bool p_hardware)
+        : m_fd(p_fd), m_iface(p_iface), m_layout(std::move(p_layout)) {
+        for (const auto& [name, count] : m_layout) {
+            m_burst_size += count;
+        }
+        if (m_fd < 0 || m_burst_size == 0) {
+            std::cerr << LOG_TAG << " Sender backend has no socket to timestamp.\n";
+            return;
+        }
+
+        m_hardware = p_hardware && enable_hardware(m_fd, p_iface, m_saved_hw);
+
+        // OPT_ID numbers every datagram from 0, OPT_TSONLY keeps packet copies off the error queue
+        int flags = SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE |
+                    SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+        if (m_hardware) {
+            flags |= SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+        }
+        if (setsockopt(m_fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0) {
+            perror("setsockopt(SO_TIMESTAMPING)");
+            return;
+        }
+
+        // Error queue entries are charged to the receive buffer, leave room for a few bursts in flight
+        int rcvbuf = 4 << 20;
+        setsockopt(m_fd, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf));
+
+        m_bursts.reserve(p_bursts);
+        m_stamps.reserve(m_burst_size * p_bursts);
+        m_worker = std::thread(&Recorder::collect, this);
+    }
+
+    Recorder::~Recorder() {
+        stop(0);
+    }
+
+    void Recorder::sent(size_t p_sent) {
+        m_bursts.emplace_back(m_next_id, static_cast<uint32_t>(p_sent));
+        m_next_id += static_cast<uint32_t>(p_sent);
+        m_expected.store(m_next_id, std::memory_order_relaxed);
+    }
+
+    void Recorder::stop(int p_grace_ms) {
+        if (m_worker.joinable()) {
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(p_grace_ms);
+            while (m_received.load(std::memory_order_relaxed) < m_expected.load(std::memory_order_relaxed) &&
+                   std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            m_stop.store(true, std::memory_order_relaxed);
+            m_worker.join();
+
+            int flags = 0;
+            setsockopt(m_fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags));
+        }
+
+        // Also reached when setup failed after the NIC was already switched
+        if (m_saved_hw && !set_hwtstamp(m_fd, m_iface, *m_saved_hw, SIOCSHWTSTAMP)) {
+            std::cerr << LOG_TAG << " Failed to restore the timestamping setting of " << m_iface << ": "
+                      << strerror(errno) << "\n";
+        }
+        m_saved_hw.reset();
+    }
+
+    void Recorder::collect() {
+        // The error queue raises POLLERR, which poll reports without being asked for
+        pollfd pfd{ m_fd, 0, 0 };
+        while (!m_stop.load(std::memory_order_relaxed)) {
+            if (poll(&pfd, 1, 10) > 0 && (pfd.revents & POLLERR)) {
+                drain();
+            }
+        }
+        drain();
+    }
+
+    size_t Recorder::drain() {
+        size_t drained = 0;
+        char control[256];
+        for (;;) {
+            msghdr msg{};
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            if (recvmsg(m_fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    perror("recvmsg(MSG_ERRQUEUE)");
+                }
+                return drained;
+            }
+
+            const scm_timestamping* times = nullptr;
+            const sock_extended_err* err = nullptr;
+            for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+                if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPING) {
+                    times = reinterpret_cast<const scm_timestamping*>(CMSG_DATA(cmsg));
+                } else if ((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+                           (cmsg->cmsg_level == SOL_PACKET && cmsg->cmsg_type == PACKET_TX_TIMESTAMP)) {
+                    err = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(cmsg));
+                }
+            }
+            // Launch time reports share the queue when the socket also has SO_TXTIME
+            if (err && err->ee_origin == SO_EE_ORIGIN_TXTIME) {
+                (err->ee_code == SO_EE_CODE_TXTIME_MISSED ? m_txtime_missed : m_txtime_invalid)++;
+                continue;
+            }
+            if (!times || !err || err->ee_origin != SO_EE_ORIGIN_TIMESTAMPING) continue;
+
+            // Software and hardware stamps of one datagram arrive as separate messages
+            const uint32_t id = err->ee_data;
+            if (id >= m_stamps.size()) {
+                m_stamps.resize(static_cast<size_t>(id) + 1);
+            }
+            Stamp& stamp = m_stamps[id];
+            const bool first = stamp.software_ns == 0 && stamp.hardware_ns == 0;
+            stamp.id = id;
+            if (times->ts[0].tv_sec || times->ts[0].tv_nsec) stamp.software_ns = to_ns(times->ts[0]);
+            if (times->ts[2].tv_sec || times->ts[2].tv_nsec) stamp.hardware_ns = to_ns(times->ts[2]);
+            if (first) m_received.fetch_add(1, std::memory_order_relaxed);
+            drained++;
+        }
+    }
+
+    uint64_t Recorder::departure(uint32_t p_id) const {
+        if (p_id >= m_stamps.size()) return 0;
+        const Stamp& stamp = m_stamps[p_id];
+        return m_hardware && stamp.hardware_ns ? stamp.hardware_ns : stamp.software_ns;
+    }
+
+    std::string Recorder::segment(size_t p_index) const {
+        for (const auto& [name, count] : m_layout) {
+            if (p_index < count) return name;
+            p_index -= count;
+        }
+        return "other";
+    }
+
+    Report Recorder::report() const {
+        Report report;
+        report.hardware = m_hardware;
+        report.span.label = "burst span";
+        report.txtime_missed = m_txtime_missed;
+        report.txtime_invalid = m_txtime_invalid;
+
+        // Gap k sits between packets k and k + 1 and shares its stats with equally labelled gaps
+        std::vector<size_t> slot(m_burst_size > 0 ? m_burst_size - 1 : 0);
+        for (size_t k = 0; k < slot.size(); k++) {
+            const std::string from = segment(k), to = segment(k + 1);
+            const std::string label = from == to ? from : from + " -> " + to;
+            auto it = std::find_if(report.gaps.begin(), report.gaps.end(),
+                                   [&](const GapStats& g) { return g.label == label; });
+            if (it == report.gaps.end()) {
+                report.gaps.push_back(GapStats{ .label = label });
+                it = report.gaps.end() - 1;
+            }
+            slot[k] = static_cast<size_t>(it - report.gaps.begin());
+        }
+
+        auto add = [](GapStats& p_stats, uint64_t p_gap) {
+            p_stats.count++;
+            p_stats.sum_ns += p_gap;
+            p_stats.min_ns = std::min(p_stats.min_ns, p_gap);
+            p_stats.max_ns = std::max(p_stats.max_ns, p_gap);
+        };
+
+        std::vector<uint64_t> times(m_burst_size);
+        for (const auto& [first_id, count] : m_bursts) {
+            bool complete = count == m_burst_size;
+            for (size_t i = 0; complete && i < m_burst_size; i++) {
+                times[i] = departure(first_id + static_cast<uint32_t>(i));
+                complete = times[i] != 0;
+            }
+            if (!complete) {
+                report.incomplete++;
+                continue;
+            }
+
+            report.bursts++;
+            for (size_t k = 0; k < slot.size(); k++) {
+                add(report.gaps[slot[k]], times[k + 1] >= times[k] ? times[k + 1] - times[k] : 0);
+            }
+            add(report.span, times.back() >= times.front() ? times.back() - times.front() : 0);
+        }
+        return report;
+    }
+
+    bool Recorder::write_csv(const std::string& p_path) const {
+        std::ofstream out(p_path);
+        if (!out) {
+            std::cerr << LOG_TAG << " Failed to open " << p_path << "\n";
+            return false;
+        }
+
+        out << "burst,index,segment,id,software_ns,hardware_ns,gap_ns\n";
+        for (size_t b = 0; b < m_bursts.size(); b++) {
+            const auto [first_id, count] = m_bursts[b];
+            uint64_t previous = 0;
+            for (uint32_t i = 0; i < count; i++) {
+                const uint32_t id = first_id + i;
+                const Stamp stamp = id < m_stamps.size() ? m_stamps[id] : Stamp{};
+                const uint64_t time = departure(id);
+                out << b << ',' << i << ',' << segment(i) << ',' << id << ',' << stamp.software_ns << ','
+                    << stamp.hardware_ns << ',';
+                if (i > 0 && previous && time) out << static_cast<int64_t>(time - previous);
+                out << '\n';
+                previous = time;
+            }
+        }
+        return true;
+    }
+
+    std::ostream& operator<<(std::ostream& os, const Report& report) {
+        os << LOG_TAG << " " << (report.hardware ? "Hardware" : "Software") << " TX timestamps for "
+           << report.bursts << " bursts (" << report.incomplete << " incomplete)\n";
+
+        auto print = [&os](const GapStats& p_stats) {
+            if (p_stats.count == 0) return;
+            os << LOG_TAG << "   " << p_stats.label << ": mean " << p_stats.sum_ns / p_stats.count
+               << " ns, min " << p_stats.min_ns << " ns, max " << p_stats.max_ns << " ns\n";
+        };
+        for (const auto& gap : report.gaps) {
+            print(gap);
+        }
+        print(report.span);
+        if (report.txtime_missed || report.txtime_invalid) {
+            os << LOG_TAG << " Dropped by the qdisc: " << report.txtime_missed << " launch times missed, "
+               << report.txtime_invalid << " invalid\n";
+        }
+        return os;
+    }
+
+} // namespace TxStamp
@@ -0,0 +1,104 @@
+#include "txtime.hpp"
+#include <iostream>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+namespace TxTime {
+
+    std::vector<uint64_t> offsets(std::span<const Segment> p_segments) {
+        std::vector<uint64_t> result;
+        uint64_t time = 0;
+        for (const auto& segment : p_segments) {
+            for (size_t i = 0; i < segment.count; i++) {
+                // The first packet of the burst launches at the launch time plus its lead
+                time += i == 0 ? segment.lead_ns : segment.spacing_ns;
+                result.push_back(time);
+            }
+        }
+        return result;
+    }
+
+    bool enable(int p_fd, clockid_t p_clock, bool p_deadline) {
+        sock_txtime config{};
+        config.clockid = p_clock;
+        config.flags = SOF_TXTIME_REPORT_ERRORS | (p_deadline ? SOF_TXTIME_DEADLINE_MODE : 0);
+        if (setsockopt(p_fd, SOL_SOCKET, SO_TXTIME, &config, sizeof(config)) < 0) {
+            perror("setsockopt(SO_TXTIME)");
+            return false;
+        }
+        return true;
+    }
+
+    void stamp(PacketBuilder::BatchSlab& p_batch, uint64_t p_launch_ns, std::span<const uint64_t> p_offsets) {
+        const size_t count = std::min(p_batch.size(), p_offsets.size());
+        for (size_t i = 0; i < count; i++) {
+            p_batch.set_txtime(i, p_launch_ns + p_offsets[i]);
+        }
+    }
+
+    Errors drain_errors(int p_fd) {
+        Errors errors;
+        char control[256];
+        for (;;) {
+            msghdr msg{};
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            if (recvmsg(p_fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    perror("recvmsg(MSG_ERRQUEUE)");
+                }
+                return errors;
+            }
+
+            for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+                if (cmsg->cmsg_level != SOL_IP || cmsg->cmsg_type != IP_RECVERR) continue;
+                const auto* err = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(cmsg));
+                if (err->ee_origin != SO_EE_ORIGIN_TXTIME) continue;
+                if (err->ee_code == SO_EE_CODE_TXTIME_MISSED) {
+                    errors.missed++;
+                } else {
+                    errors.invalid++;
+                }
+            }
+        }
+    }
+
+    std::vector<std::string> etf_commands(std::string_view p_iface, uint32_t p_queues, uint64_t p_delta_ns,
+                                          bool p_offload) {
+        const std::string iface(p_iface);
+        const std::string etf = " etf clockid CLOCK_TAI delta " + std::to_string(p_delta_ns) +
+                                (p_offload ? " offload" : "");
+        if (p_queues <= 1) {
+            return { "tc qdisc replace dev " + iface + " root" + etf };
+        }
+
+        // One traffic class spanning every queue, each queue gets its own ETF instance
+        std::string map;
+        for (int prio = 0; prio < 16; prio++) map += " 0";
+        std::vector<std::string> commands = {
+            "tc qdisc replace dev " + iface + " root handle 100: mqprio num_tc 1 map" + map + " queues " +
+            std::to_string(p_queues) + "@0 hw 0"
+        };
+        for (uint32_t q = 1; q <= p_queues; q++) {
+            commands.push_back("tc qdisc replace dev " + iface + " parent 100:" + std::to_string(q) + etf);
+        }
+        return commands;
+    }
+
+    bool setup_etf(std::string_view p_iface, uint32_t p_queues, uint64_t p_delta_ns, bool p_offload) {
+        for (const auto& command : etf_commands(p_iface, p_queues, p_delta_ns, p_offload)) {
+            if (std::system(command.c_str()) != 0) {
+                std::cerr << LOG_TAG << " Failed: " << command << "\n";
+                return false;
+            }
+        }
+        return true;
+    }
+
+} // namespace TxTime
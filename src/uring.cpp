@@ -0,0 +1,264 @@
+#include "uring.hpp"
+#include "spsc.hpp"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+namespace Uring {
+
+    Socket::Socket(const Config& p_config)
+        : m_config(p_config) {
+        m_fd = Sender::setup_raw_socket(m_config.iface);
+        if (m_fd < 0) return;
+
+        if (!setup_ring() && m_ring_fd >= 0) {
+            close(m_ring_fd);
+            m_ring_fd = -1;
+        }
+    }
+
+    Socket::~Socket() {
+        // The kernel still references the msghdrs of whatever is in flight
+        if (m_ring_fd >= 0) {
+            reap(m_in_flight);
+        }
+        if (m_sqes) {
+            munmap(m_sqes, m_sqes_len);
+        }
+        if (m_cq_map && m_cq_map != m_sq_map) {
+            munmap(m_cq_map, m_cq_map_len);
+        }
+        if (m_sq_map) {
+            munmap(m_sq_map, m_sq_map_len);
+        }
+        if (m_ring_fd >= 0) {
+            close(m_ring_fd);
+        }
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+    }
+
+    bool Socket::setup_ring() {
+        if (m_config.sqpoll) {
+            m_params.flags |= IORING_SETUP_SQPOLL;
+            m_params.sq_thread_idle = m_config.sqpoll_idle_ms;
+            if (m_config.sqpoll_cpu >= 0) {
+                m_params.flags |= IORING_SETUP_SQ_AFF;
+                m_params.sq_thread_cpu = static_cast<uint32_t>(m_config.sqpoll_cpu);
+            }
+        }
+
+        m_ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, m_config.entries, &m_params));
+        if (m_ring_fd < 0) {
+            perror("io_uring_setup");
+            return false;
+        }
+
+        m_sq_map_len = m_params.sq_off.array + m_params.sq_entries * sizeof(uint32_t);
+        m_cq_map_len = m_params.cq_off.cqes + m_params.cq_entries * sizeof(io_uring_cqe);
+        const bool single_mmap = m_params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap) {
+            m_sq_map_len = m_cq_map_len = std::max(m_sq_map_len, m_cq_map_len);
+        }
+
+        void* sq = mmap(nullptr, m_sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd,
+                        IORING_OFF_SQ_RING);
+        if (sq == MAP_FAILED) {
+            perror("mmap(IORING_OFF_SQ_RING)");
+            return false;
+        }
+        m_sq_map = sq;
+
+        if (single_mmap) {
+            m_cq_map = m_sq_map;
+        } else {
+            void* cq = mmap(nullptr, m_cq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd,
+                            IORING_OFF_CQ_RING);
+            if (cq == MAP_FAILED) {
+                perror("mmap(IORING_OFF_CQ_RING)");
+                return false;
+            }
+            m_cq_map = cq;
+        }
+
+        m_sqes_len = m_params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, m_sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd,
+                          IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            perror("mmap(IORING_OFF_SQES)");
+            return false;
+        }
+        m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+        auto* sq_base = static_cast<uint8_t*>(m_sq_map);
+        auto* cq_base = static_cast<uint8_t*>(m_cq_map);
+        m_sq_head = reinterpret_cast<uint32_t*>(sq_base + m_params.sq_off.head);
+        m_sq_tail = reinterpret_cast<uint32_t*>(sq_base + m_params.sq_off.tail);
+        m_sq_flags = reinterpret_cast<uint32_t*>(sq_base + m_params.sq_off.flags);
+        m_sq_mask = *reinterpret_cast<uint32_t*>(sq_base + m_params.sq_off.ring_mask);
+        m_cq_head = reinterpret_cast<uint32_t*>(cq_base + m_params.cq_off.head);
+        m_cq_tail = reinterpret_cast<uint32_t*>(cq_base + m_params.cq_off.tail);
+        m_cq_mask = *reinterpret_cast<uint32_t*>(cq_base + m_params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe*>(cq_base + m_params.cq_off.cqes);
+
+        // Submission entries are always used in ring order, the indirection array stays the identity
+        auto* array = reinterpret_cast<uint32_t*>(sq_base + m_params.sq_off.array);
+        for (uint32_t i = 0; i < m_params.sq_entries; i++) {
+            array[i] = i;
+        }
+
+        if (syscall(__NR_io_uring_register, m_ring_fd, IORING_REGISTER_FILES, &m_fd, 1) < 0) {
+            perror("io_uring_register(IORING_REGISTER_FILES)");
+            return false;
+        }
+        return true;
+    }
+
+    int Socket::enter(uint32_t p_submit, uint32_t p_wait, uint32_t p_flags) {
+        while (true) {
+            const long ret = syscall(__NR_io_uring_enter, m_ring_fd, p_submit, p_wait, p_flags, nullptr, 0);
+            if (ret >= 0 || errno != EINTR) return static_cast<int>(ret);
+            // Interrupted after submitting: only the wait is left
+            p_submit = 0;
+        }
+    }
+
+    bool Socket::flush(uint32_t p_count, uint32_t p_wait) {
+        if (m_config.sqpoll) {
+            // The tail store has to be visible before the flag is read, or a thread going to
+            // sleep right now could miss the new entries
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (__atomic_load_n(m_sq_flags, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP) {
+                if (enter(0, 0, IORING_ENTER_SQ_WAKEUP) < 0) {
+                    perror("io_uring_enter(IORING_ENTER_SQ_WAKEUP)");
+                    return false;
+                }
+            }
+            m_in_flight += p_count;
+            return true;
+        }
+
+        const int submitted = enter(p_count, p_wait, p_wait ? IORING_ENTER_GETEVENTS : 0);
+        if (submitted < 0) {
+            perror("io_uring_enter");
+            return false;
+        }
+        m_in_flight += static_cast<size_t>(submitted);
+        if (static_cast<uint32_t>(submitted) < p_count) {
+            std::cerr << LOG_TAG << " Kernel took " << submitted << " of " << p_count << " requests\n";
+            return false;
+        }
+        return true;
+    }
+
+    size_t Socket::reap(size_t p_min) {
+        p_min = std::min(p_min, m_in_flight);
+        size_t collected = 0;
+        uint32_t spins = 0;
+
+        while (true) {
+            uint32_t head = *m_cq_head;
+            const uint32_t tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+            for (; head != tail; head++) {
+                const io_uring_cqe& cqe = m_cqes[head & m_cq_mask];
+                if (cqe.user_data < m_results.size()) {
+                    m_results[cqe.user_data] = cqe.res;
+                    if (cqe.res >= 0) m_sent++;
+                }
+                collected++;
+                m_in_flight--;
+            }
+            __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+
+            if (collected >= p_min) break;
+
+            if (m_config.sqpoll) {
+                Spsc::relax(spins);
+            } else if (enter(0, static_cast<uint32_t>(p_min - collected), IORING_ENTER_GETEVENTS) < 0) {
+                perror("io_uring_enter(IORING_ENTER_GETEVENTS)");
+                break;
+            }
+        }
+        return collected;
+    }
+
+    size_t Socket::queue(PacketBuilder::BatchSlab& p_batch, bool p_wait) {
+        reap(m_in_flight);
+
+        const size_t count = p_batch.size();
+        m_results.assign(count, -EINPROGRESS);
+        m_sent = 0;
+
+        mmsghdr* msgs = p_batch.msgs();
+        const uint32_t sq_entries = m_params.sq_entries;
+        size_t queued = 0;
+        while (queued < count) {
+            // Batches larger than the ring go out as consecutive chains, each waiting for the
+            // one before so the packets still leave in slot order
+            if (queued > 0 && m_config.link) {
+                reap(m_in_flight);
+            }
+            const uint32_t chunk = static_cast<uint32_t>(std::min<size_t>(count - queued, sq_entries));
+            if (m_in_flight + chunk > m_params.cq_entries) {
+                reap(m_in_flight + chunk - m_params.cq_entries);
+            }
+
+            // The polling thread may not have consumed the previous entries yet
+            uint32_t tail = *m_sq_tail;
+            uint32_t spins = 0;
+            while (tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE) + chunk > sq_entries) {
+                Spsc::relax(spins);
+            }
+
+            for (uint32_t i = 0; i < chunk; i++, tail++) {
+                const size_t slot = queued + i;
+                io_uring_sqe& sqe = m_sqes[tail & m_sq_mask];
+                std::memset(&sqe, 0, sizeof(sqe));
+                sqe.opcode = IORING_OP_SENDMSG;
+                sqe.flags = IOSQE_FIXED_FILE;
+                if (m_config.link && i + 1 < chunk) sqe.flags |= IOSQE_IO_LINK;
+                sqe.fd = 0;
+                sqe.addr = reinterpret_cast<uint64_t>(&msgs[slot].msg_hdr);
+                sqe.len = 1;
+                sqe.user_data = slot;
+            }
+            __atomic_store_n(m_sq_tail, tail, __ATOMIC_RELEASE);
+
+            const bool last = queued + chunk == count;
+            if (!flush(chunk, p_wait && last ? chunk : 0)) {
+                return queued;
+            }
+            queued += chunk;
+        }
+
+        if (p_wait) {
+            reap(m_in_flight);
+        }
+        return queued;
+    }
+
+    size_t Socket::submit(PacketBuilder::BatchSlab& p_batch) {
+        return queue(p_batch, false);
+    }
+
+    int Socket::error() const {
+        for (int32_t result : m_results) {
+            if (result < 0 && result != -EINPROGRESS) return -result;
+        }
+        return 0;
+    }
+
+    int Socket::send(PacketBuilder::BatchSlab& p_batch) {
+        const size_t queued = queue(p_batch, true);
+        if (queued == 0 && p_batch.size() > 0) return -1;
+        return static_cast<int>(m_sent);
+    }
+
+} // namespace Uring
@@ -0,0 +1,444 @@
+#include "xdp.hpp"
+#include <iostream>
+#include <cstring>
+#include <unistd.h>
+#include <poll.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+namespace Xdp {
+
+    // ####################################################################################
+    // # Region: eBPF Redirect Program
+    // ####################################################################################
+
+    static long bpf(int cmd, bpf_attr& attr) {
+        return syscall(__NR_bpf, cmd, &attr, sizeof(attr));
+    }
+
+    static bpf_insn insn(uint8_t code, uint8_t dst, uint8_t src, int16_t off, int32_t imm) {
+        bpf_insn i{};
+        i.code = code;
+        i.dst_reg = dst & 0xF;
+        i.src_reg = src & 0xF;
+        i.off = off;
+        i.imm = imm;
+        return i;
+    }
+
+    // XDP_PASS everything except IPv4/TCP (ihl 5) to p_port, which is redirected into the
+    // XSKMAP entry of the receiving queue (falling back to XDP_PASS if it has no socket)
+    static std::vector<bpf_insn> redirect_program(int p_map_fd, uint16_t p_port) {
+        constexpr int pass = 20;
+        auto jump_to_pass = [](int pc) { return static_cast<int16_t>(pass - (pc + 1)); };
+
+        return {
+            /*  0 */ insn(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_6, BPF_REG_1, 0, 0),
+            /*  1 */ insn(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_6, offsetof(xdp_md, data), 0),
+            /*  2 */ insn(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_3, BPF_REG_6, offsetof(xdp_md, data_end), 0),
+            /*  3 */ insn(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_4, BPF_REG_2, 0, 0),
+            /*  4 */ insn(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_4, 0, 0, 38),   // eth + ip + tcp ports
+            /*  5 */ insn(BPF_JMP | BPF_JGT | BPF_X, BPF_REG_4, BPF_REG_3, jump_to_pass(5), 0),
+            /*  6 */ insn(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_5, BPF_REG_2, 12, 0),
+            /*  7 */ insn(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_5, 0, jump_to_pass(7), htons(ETH_P_IP)),
+            /*  8 */ insn(BPF_LDX | BPF_MEM | BPF_B, BPF_REG_5, BPF_REG_2, 14, 0),
+            /*  9 */ insn(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_5, 0, jump_to_pass(9), 0x45),
+            /* 10 */ insn(BPF_LDX | BPF_MEM | BPF_B, BPF_REG_5, BPF_REG_2, 23, 0),
+            /* 11 */ insn(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_5, 0, jump_to_pass(11), IPPROTO_TCP),
+            /* 12 */ insn(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_5, BPF_REG_2, 36, 0),
+            /* 13 */ insn(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_5, 0, jump_to_pass(13), htons(p_port)),
+            /* 14 */ insn(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_6, offsetof(xdp_md, rx_queue_index), 0),
+            /* 15 */ insn(BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, p_map_fd),
+            /* 16 */ insn(0, 0, 0, 0, 0),
+            /* 17 */ insn(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_3, 0, 0, XDP_PASS),
+            /* 18 */ insn(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map),
+            /* 19 */ insn(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+            /* 20 */ insn(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, XDP_PASS),
+            /* 21 */ insn(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+        };
+    }
+
+    bool Socket::attach_program() {
+        bpf_attr attr{};
+        attr.map_type = BPF_MAP_TYPE_XSKMAP;
+        attr.key_size = sizeof(uint32_t);
+        attr.value_size = sizeof(uint32_t);
+        attr.max_entries = 64;
+        m_map_fd = static_cast<int>(bpf(BPF_MAP_CREATE, attr));
+        if (m_map_fd < 0) {
+            std::cerr << LOG_TAG << " XSKMAP creation failed: " << strerror(errno) << "\n";
+            return false;
+        }
+
+        std::vector<bpf_insn> prog = redirect_program(m_map_fd, m_config.rx_port);
+        static const char license[] = "GPL";
+        std::vector<char> log(1 << 16);
+        attr = bpf_attr{};
+        attr.prog_type = BPF_PROG_TYPE_XDP;
+        attr.insns = reinterpret_cast<uint64_t>(prog.data());
+        attr.insn_cnt = static_cast<uint32_t>(prog.size());
+        attr.license = reinterpret_cast<uint64_t>(license);
+        attr.log_buf = reinterpret_cast<uint64_t>(log.data());
+        attr.log_size = static_cast<uint32_t>(log.size());
+        attr.log_level = 1;
+        m_prog_fd = static_cast<int>(bpf(BPF_PROG_LOAD, attr));
+        if (m_prog_fd < 0) {
+            std::cerr << LOG_TAG << " XDP program load failed: " << strerror(errno) << "\n" << log.data() << "\n";
+            return false;
+        }
+
+        attr = bpf_attr{};
+        attr.link_create.prog_fd = static_cast<uint32_t>(m_prog_fd);
+        attr.link_create.target_ifindex = if_nametoindex(m_config.iface.c_str());
+        attr.link_create.attach_type = BPF_XDP;
+        attr.link_create.flags = m_config.mode == Mode::DRIVER ? XDP_FLAGS_DRV_MODE : XDP_FLAGS_SKB_MODE;
+        m_link_fd = static_cast<int>(bpf(BPF_LINK_CREATE, attr));
+        if (m_link_fd < 0) {
+            std::cerr << LOG_TAG << " XDP attach to " << m_config.iface << " failed: " << strerror(errno) << "\n";
+            return false;
+        }
+
+        uint32_t key = m_config.queue_id;
+        uint32_t value = static_cast<uint32_t>(m_fd);
+        attr = bpf_attr{};
+        attr.map_fd = static_cast<uint32_t>(m_map_fd);
+        attr.key = reinterpret_cast<uint64_t>(&key);
+        attr.value = reinterpret_cast<uint64_t>(&value);
+        if (bpf(BPF_MAP_UPDATE_ELEM, attr) < 0) {
+            std::cerr << LOG_TAG << " XSKMAP update failed: " << strerror(errno) << "\n";
+            return false;
+        }
+        return true;
+    }
+
+    // ####################################################################################
+    // # Region: Socket Setup
+    // ####################################################################################
+
+    Socket::Socket(const Config& p_config, const PacketBuilder::MacAddress& p_dst_mac)
+        : m_config(p_config) {
+
+        PacketBuilder::MacAddress src_mac{};
+        if (!Sender::interface_mac(m_config.iface, src_mac)) return;
+        m_eth_header = PacketBuilder::build_ethernet_header(src_mac, p_dst_mac);
+
+        if (!setup_umem() || !setup_rings() || (m_config.rx && !attach_program())) {
+            std::cerr << LOG_TAG << " Failed to set up AF_XDP socket on " << m_config.iface
+                      << " queue " << m_config.queue_id << "\n";
+            if (m_fd >= 0) {
+                close(m_fd);
+                m_fd = -1;
+            }
+            return;
+        }
+
+        // First half of UMEM feeds the RX fill ring, the rest is the TX pool
+        const uint32_t rx_frames = m_config.rx ? m_config.frame_count / 2 : 0;
+        m_resident.assign(m_config.frame_count, 0);
+        m_in_flight.assign(m_config.frame_count, 0);
+        m_pool_frames = m_config.frame_count - rx_frames;
+        m_free.reserve(m_pool_frames);
+        for (uint32_t i = m_config.frame_count; i > rx_frames; i--) {
+            m_free.push_back(static_cast<uint64_t>(i - 1) * m_config.frame_size);
+        }
+        if (m_config.rx) {
+            fill_rx(rx_frames);
+        }
+    }
+
+    Socket::~Socket() {
+        for (int fd : { m_link_fd, m_prog_fd, m_map_fd, m_fd }) {
+            if (fd >= 0) close(fd);
+        }
+        for (Ring* ring : { &m_fill, &m_comp, &m_rx, &m_tx }) {
+            if (ring->map) munmap(ring->map, ring->map_len);
+        }
+        if (m_umem) {
+            munmap(m_umem, m_umem_len);
+        }
+    }
+
+    bool Socket::setup_umem() {
+        m_umem_len = static_cast<size_t>(m_config.frame_size) * m_config.frame_count;
+        void* mem = mmap(nullptr, m_umem_len, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if (mem == MAP_FAILED) {
+            perror("mmap(UMEM)");
+            m_umem = nullptr;
+            return false;
+        }
+        m_umem = mem;
+
+        m_fd = socket(AF_XDP, SOCK_RAW | SOCK_CLOEXEC, 0);
+        if (m_fd < 0) {
+            perror("socket(AF_XDP)");
+            return false;
+        }
+
+        xdp_umem_reg reg{};
+        reg.addr = reinterpret_cast<uint64_t>(m_umem);
+        reg.len = m_umem_len;
+        reg.chunk_size = m_config.frame_size;
+        reg.headroom = 0;
+        if (setsockopt(m_fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) < 0) {
+            perror("setsockopt(XDP_UMEM_REG)");
+            return false;
+        }
+        return true;
+    }
+
+    static bool map_ring(int p_fd, Ring& p_ring, const xdp_ring_offset& p_off, uint32_t p_size,
+                         size_t p_desc_size, off_t p_pgoff) {
+        p_ring.map_len = p_off.desc + p_size * p_desc_size;
+        void* map = mmap(nullptr, p_ring.map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, p_fd, p_pgoff);
+        if (map == MAP_FAILED) {
+            perror("mmap(XDP ring)");
+            return false;
+        }
+
+        auto* base = static_cast<uint8_t*>(map);
+        p_ring.map = map;
+        p_ring.producer = reinterpret_cast<uint32_t*>(base + p_off.producer);
+        p_ring.consumer = reinterpret_cast<uint32_t*>(base + p_off.consumer);
+        p_ring.flags = reinterpret_cast<uint32_t*>(base + p_off.flags);
+        p_ring.descs = base + p_off.desc;
+        p_ring.size = p_size;
+        p_ring.mask = p_size - 1;
+        return true;
+    }
+
+    bool Socket::setup_rings() {
+        const uint32_t size = m_config.ring_size;
+        if (setsockopt(m_fd, SOL_XDP, XDP_UMEM_FILL_RING, &size, sizeof(size)) < 0 ||
+            setsockopt(m_fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &size, sizeof(size)) < 0 ||
+            setsockopt(m_fd, SOL_XDP, XDP_TX_RING, &size, sizeof(size)) < 0 ||
+            (m_config.rx && setsockopt(m_fd, SOL_XDP, XDP_RX_RING, &size, sizeof(size)) < 0)) {
+            perror("setsockopt(XDP rings)");
+            return false;
+        }
+
+        xdp_mmap_offsets off{};
+        socklen_t len = sizeof(off);
+        if (getsockopt(m_fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &len) < 0) {
+            perror("getsockopt(XDP_MMAP_OFFSETS)");
+            return false;
+        }
+
+        if (!map_ring(m_fd, m_fill, off.fr, size, sizeof(uint64_t), XDP_UMEM_PGOFF_FILL_RING) ||
+            !map_ring(m_fd, m_comp, off.cr, size, sizeof(uint64_t), XDP_UMEM_PGOFF_COMPLETION_RING) ||
+            !map_ring(m_fd, m_tx, off.tx, size, sizeof(xdp_desc), XDP_PGOFF_TX_RING) ||
+            (m_config.rx && !map_ring(m_fd, m_rx, off.rx, size, sizeof(xdp_desc), XDP_PGOFF_RX_RING))) {
+            return false;
+        }
+
+        sockaddr_xdp addr{};
+        addr.sxdp_family = AF_XDP;
+        addr.sxdp_ifindex = if_nametoindex(m_config.iface.c_str());
+        addr.sxdp_queue_id = m_config.queue_id;
+        addr.sxdp_flags = (m_config.mode == Mode::DRIVER ? XDP_ZEROCOPY : XDP_COPY) | XDP_USE_NEED_WAKEUP;
+        if (bind(m_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            perror("bind(AF_XDP)");
+            return false;
+        }
+        return true;
+    }
+
+    // ####################################################################################
+    // # Region: Transmit
+    // ####################################################################################
+
+    // Kicks while waiting on the kernel before giving up on a wedged TX ring
+    static constexpr int max_spins = 1000000;
+
+    size_t Socket::reap() {
+        const uint32_t cons = *m_comp.consumer;
+        const uint32_t prod = __atomic_load_n(m_comp.producer, __ATOMIC_ACQUIRE);
+        const auto* addrs = static_cast<const uint64_t*>(m_comp.descs);
+
+        for (uint32_t i = cons; i != prod; i++) {
+            const uint64_t addr = addrs[i & m_comp.mask];
+            const size_t index = addr / m_config.frame_size;
+            if (m_in_flight[index]) m_in_flight[index]--;
+            if (!m_resident[index]) {
+                m_free.push_back(addr);
+            }
+        }
+        __atomic_store_n(m_comp.consumer, prod, __ATOMIC_RELEASE);
+        return prod - cons;
+    }
+
+    void Socket::kick() {
+        // Copy mode only transmits from sendto(), zero-copy drivers ask for a wakeup when idle
+        if (m_config.mode == Mode::DRIVER &&
+            !(__atomic_load_n(m_tx.flags, __ATOMIC_ACQUIRE) & XDP_RING_NEED_WAKEUP)) {
+            return;
+        }
+
+        // EAGAIN/EBUSY/ENOBUFS only mean the kernel is still busy with earlier frames
+        sendto(m_fd, nullptr, 0, MSG_DONTWAIT, nullptr, 0);
+    }
+
+    bool Socket::post(uint64_t p_addr, size_t p_length) {
+        const uint32_t prod = *m_tx.producer;
+        const uint32_t cons = __atomic_load_n(m_tx.consumer, __ATOMIC_ACQUIRE);
+        if (prod - cons >= m_tx.size) return false;
+
+        auto* descs = static_cast<xdp_desc*>(m_tx.descs);
+        descs[prod & m_tx.mask] = xdp_desc{ .addr = p_addr, .len = static_cast<uint32_t>(p_length), .options = 0 };
+        __atomic_store_n(m_tx.producer, prod + 1, __ATOMIC_RELEASE);
+        m_in_flight[p_addr / m_config.frame_size]++;
+        return true;
+    }
+
+    uint64_t Socket::stage(const char* p_frame, size_t p_length) {
+        reap();
+        if (m_free.empty() || p_length > m_config.frame_size) return UINT64_MAX;
+
+        const uint64_t addr = m_free.back();
+        m_free.pop_back();
+        m_resident[addr / m_config.frame_size] = 1;
+        std::memcpy(frame(addr), p_frame, p_length);
+        return addr;
+    }
+
+    void Socket::write_frame(uint64_t p_addr, const PacketBuilder::BatchSlab& p_batch, size_t p_index) {
+        char* dst = frame(p_addr);
+        std::memcpy(dst, m_eth_header.data(), m_eth_header.size());
+        std::memcpy(dst + m_eth_header.size(), p_batch.slot(p_index), p_batch.length(p_index));
+    }
+
+    uint64_t Socket::cached_frame(const PacketBuilder::BatchSlab& p_batch, size_t p_index) {
+        if (p_index >= m_cached.size()) return UINT64_MAX;
+
+        Cached& cached = m_cached[p_index];
+        if (cached.addr != UINT64_MAX && cached.slab == p_batch.id() && cached.version == p_batch.version(p_index)) {
+            return cached.addr;
+        }
+        if (cached.addr == UINT64_MAX) {
+            // Half the pool stays free for slots that cannot be cached
+            if (m_free.size() <= m_pool_frames / 2) return UINT64_MAX;
+            cached.addr = m_free.back();
+            m_free.pop_back();
+            m_resident[cached.addr / m_config.frame_size] = 1;
+        } else if (m_in_flight[cached.addr / m_config.frame_size]) {
+            // The kernel may still read the old contents
+            return UINT64_MAX;
+        }
+
+        write_frame(cached.addr, p_batch, p_index);
+        cached.slab = p_batch.id();
+        cached.version = p_batch.version(p_index);
+        return cached.addr;
+    }
+
+    int Socket::send(PacketBuilder::BatchSlab& p_batch) {
+        reap();
+        const size_t cacheable = std::min<size_t>(p_batch.size(), m_config.cached_slots);
+        if (m_cached.size() < cacheable) m_cached.resize(cacheable);
+
+        int posted = 0;
+        for (size_t i = 0; i < p_batch.size(); i++) {
+            const size_t len = m_eth_header.size() + p_batch.length(i);
+            if (len > m_config.frame_size) continue;
+
+            uint64_t addr = cached_frame(p_batch, i);
+            const bool pooled = addr == UINT64_MAX;
+            if (pooled) {
+                // Pool exhausted: let the kernel drain completions
+                for (int spins = 0; m_free.empty() && spins < max_spins; spins++) {
+                    kick();
+                    reap();
+                }
+                if (m_free.empty()) break;
+
+                addr = m_free.back();
+                m_free.pop_back();
+                write_frame(addr, p_batch, i);
+            }
+
+            bool queued = post(addr, len);
+            for (int spins = 0; !queued && spins < max_spins; spins++) {
+                kick();
+                reap();
+                queued = post(addr, len);
+            }
+            if (!queued) {
+                std::cerr << LOG_TAG << " TX ring on " << m_config.iface << " does not drain, "
+                          << p_batch.size() - i << " packets not sent\n";
+                if (pooled) m_free.push_back(addr);
+                break;
+            }
+            posted++;
+        }
+
+        // A single wakeup transmits a bounded batch in copy mode, keep kicking until drained
+        for (int spins = 0; spins < max_spins; spins++) {
+            kick();
+            if (__atomic_load_n(m_tx.consumer, __ATOMIC_ACQUIRE) == *m_tx.producer) break;
+        }
+        return posted;
+    }
+
+    // ####################################################################################
+    // # Region: Receive
+    // ####################################################################################
+
+    size_t Socket::fill_rx(size_t p_count) {
+        const uint32_t prod = *m_fill.producer;
+        const uint32_t cons = __atomic_load_n(m_fill.consumer, __ATOMIC_ACQUIRE);
+        const size_t space = m_fill.size - (prod - cons);
+        const size_t count = std::min(p_count, space);
+
+        auto* addrs = static_cast<uint64_t*>(m_fill.descs);
+        for (size_t i = 0; i < count; i++) {
+            addrs[(prod + i) & m_fill.mask] = i * m_config.frame_size;
+        }
+        __atomic_store_n(m_fill.producer, prod + static_cast<uint32_t>(count), __ATOMIC_RELEASE);
+        return count;
+    }
+
+    uint32_t Socket::rx_available(std::chrono::milliseconds p_timeout) {
+        if (!m_config.rx) return 0;
+
+        uint32_t count = __atomic_load_n(m_rx.producer, __ATOMIC_ACQUIRE) - *m_rx.consumer;
+        if (count == 0 && p_timeout.count() > 0) {
+            pollfd pfd{ .fd = m_fd, .events = POLLIN, .revents = 0 };
+            ::poll(&pfd, 1, static_cast<int>(p_timeout.count()));
+            count = __atomic_load_n(m_rx.producer, __ATOMIC_ACQUIRE) - *m_rx.consumer;
+        }
+        return count;
+    }
+
+    const uint8_t* Socket::rx_peek(uint32_t p_index, uint32_t& p_length, uint64_t& p_addr) const {
+        const auto* descs = static_cast<const xdp_desc*>(m_rx.descs);
+        const xdp_desc& desc = descs[(*m_rx.consumer + p_index) & m_rx.mask];
+        p_length = desc.len;
+        p_addr = desc.addr;
+        return static_cast<const uint8_t*>(m_umem) + desc.addr;
+    }
+
+    void Socket::rx_release(uint32_t p_count, const uint64_t* p_addrs) {
+        __atomic_store_n(m_rx.consumer, *m_rx.consumer + p_count, __ATOMIC_RELEASE);
+
+        // Hand the frames straight back to the fill ring (it holds every RX frame)
+        const uint32_t prod = *m_fill.producer;
+        auto* addrs = static_cast<uint64_t*>(m_fill.descs);
+        for (uint32_t i = 0; i < p_count; i++) {
+            addrs[(prod + i) & m_fill.mask] = p_addrs[i] - p_addrs[i] % m_config.frame_size;
+        }
+        __atomic_store_n(m_fill.producer, prod + p_count, __ATOMIC_RELEASE);
+
+        if (__atomic_load_n(m_fill.flags, __ATOMIC_ACQUIRE) & XDP_RING_NEED_WAKEUP) {
+            recvfrom(m_fd, nullptr, 0, MSG_DONTWAIT, nullptr, nullptr);
+        }
+    }
+
+} // namespace Xdp
@@ -0,0 +1,499 @@
+/*######################################################################################################
+# Experiment: Parameter Sweep
+# Description: Run the single queue experiment over a grid of payload sizes, batch lengths, rates and
+#              in/out-of-connection ratios in one process, sharing the connection, sender, capture ring
+#              and packet templates between cells, and write one results table
+######################################################################################################*/
+
+#include "analyzer.hpp"
+#include "capture.hpp"
+#include "client.hpp"
+#include "pool.hpp"
+#include "packetbuilder.hpp"
+#include "plan.hpp"
+#include "sender.hpp"
+#include "timing.hpp"
+#include "default.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+// ########################################################################################
+// # Region: Configuration
+// ########################################################################################
+
+// Usage: SweepRunner [spec]
+//
+// The spec holds one "key = value[, value...]" per line, '#' starts a comment. Grid keys
+// take lists, every other key a single value; anything missing keeps its default below.
+//
+//   payload_sizes = 0, 3, 64, 512      # bytes per spoofed packet
+//   batch_lengths = 4, 16, 64          # spoofed packets between the probes
+//   rates = 100, 1000                  # batches per second
+//   in_connection_ratios = 0, 0.5, 1   # share of batches spoofed into the connection
+//   iterations = 1000                  # batches per cell
+//   seed = 1
+//   connect = 1                        # handshake for live seq/ack, 0 uses the defaults
+//   flows = 1                          # connections spoofed into, round robin per batch
+//   capture = 1                        # capture our own egress and analyze its order
+//   iface = enp1s0np1
+//   server_ip = 10.100.2.2
+//   dst_port = 8080
+//   client_ip = 10.100.2.100
+//   client_port = 65000                # first of `flows` source ports
+//   attacker_ip = 10.100.2.1
+//   output = sweep.csv
+const std::string default_spec_path = "sweep.conf";
+const Sender::Type backend = Sender::Type::RAW_SOCKET;
+const auto drain_time = std::chrono::milliseconds(50);     // capture ring settle time around each cell
+
+// ########################################################################################
+// # Region: Sweep Spec
+// ########################################################################################
+
+struct Spec {
+    std::vector<size_t> payload_sizes = { 3 };
+    std::vector<size_t> batch_lengths = { 16 };
+    std::vector<double> rates = { 100.0 };
+    std::vector<double> in_connection_ratios = { 0.5 };
+    size_t iterations = 1000;
+    uint64_t seed = 1;
+    bool connect = true;
+    size_t flows = 1;
+    bool capture = true;
+    std::string iface = std::string(Connection::Defaults::iface);
+    std::string server_ip = std::string(Connection::Defaults::server_ip);
+    uint16_t dst_port = Connection::Defaults::dst_port;
+    std::string client_ip = std::string(Connection::Defaults::client_ip);
+    uint16_t client_port = Connection::Defaults::client_port;
+    std::string attacker_ip = std::string(SingleQAttacker::Defaults::attacker_ip);
+    std::string output = "sweep.csv";
+};
+
+std::string_view trim(std::string_view p_text) {
+    const size_t first = p_text.find_first_not_of(" \t\r");
+    if (first == std::string_view::npos) return {};
+    return p_text.substr(first, p_text.find_last_not_of(" \t\r") - first + 1);
+}
+
+template <typename T>
+bool parse_value(std::string_view p_text, T& p_value) {
+    if constexpr (std::is_same_v<T, std::string>) {
+        p_value = std::string(p_text);
+        return !p_value.empty();
+    } else if constexpr (std::is_same_v<T, bool>) {
+        if (p_text != "0" && p_text != "1") return false;
+        p_value = p_text == "1";
+        return true;
+    } else {
+        auto [end, ec] = std::from_chars(p_text.data(), p_text.data() + p_text.size(), p_value);
+        return ec == std::errc() && end == p_text.data() + p_text.size();
+    }
+}
+
+template <typename T>
+bool parse_list(std::string_view p_text, std::vector<T>& p_values) {
+    p_values.clear();
+    while (!p_text.empty()) {
+        const size_t comma = p_text.find(',');
+        T value;
+        if (!parse_value(trim(p_text.substr(0, comma)), value)) return false;
+        p_values.push_back(value);
+        p_text = comma == std::string_view::npos ? std::string_view{} : p_text.substr(comma + 1);
+    }
+    return !p_values.empty();
+}
+
+bool load_spec(const std::string& p_path, Spec& p_spec) {
+    std::ifstream in(p_path);
+    if (!in) {
+        std::cerr << "Failed to open sweep spec " << p_path << "\n";
+        return false;
+    }
+
+    std::string line;
+    for (size_t number = 1; std::getline(in, line); ++number) {
+        std::string_view text = line;
+        text = trim(text.substr(0, text.find('#')));
+        if (text.empty()) continue;
+
+        const size_t equals = text.find('=');
+        const std::string_view key = trim(text.substr(0, equals));
+        const std::string_view value = equals == std::string_view::npos ? std::string_view{} : trim(text.substr(equals + 1));
+
+        bool ok;
+        if (key == "payload_sizes") ok = parse_list(value, p_spec.payload_sizes);
+        else if (key == "batch_lengths") ok = parse_list(value, p_spec.batch_lengths);
+        else if (key == "rates") ok = parse_list(value, p_spec.rates);
+        else if (key == "in_connection_ratios") ok = parse_list(value, p_spec.in_connection_ratios);
+        else if (key == "iterations") ok = parse_value(value, p_spec.iterations);
+        else if (key == "seed") ok = parse_value(value, p_spec.seed);
+        else if (key == "connect") ok = parse_value(value, p_spec.connect);
+        else if (key == "flows") ok = parse_value(value, p_spec.flows);
+        else if (key == "capture") ok = parse_value(value, p_spec.capture);
+        else if (key == "iface") ok = parse_value(value, p_spec.iface);
+        else if (key == "server_ip") ok = parse_value(value, p_spec.server_ip);
+        else if (key == "dst_port") ok = parse_value(value, p_spec.dst_port);
+        else if (key == "client_ip") ok = parse_value(value, p_spec.client_ip);
+        else if (key == "client_port") ok = parse_value(value, p_spec.client_port);
+        else if (key == "attacker_ip") ok = parse_value(value, p_spec.attacker_ip);
+        else if (key == "output") ok = parse_value(value, p_spec.output);
+        else {
+            std::cerr << p_path << ":" << number << ": unknown key " << key << "\n";
+            return false;
+        }
+        if (!ok) {
+            std::cerr << p_path << ":" << number << ": invalid value for " << key << "\n";
+            return false;
+        }
+    }
+
+    for (double ratio : p_spec.in_connection_ratios) {
+        if (ratio < 0 || ratio > 1) {
+            std::cerr << p_path << ": in_connection_ratios must lie in [0, 1]\n";
+            return false;
+        }
+    }
+    for (double rate : p_spec.rates) {
+        if (!(rate > 0)) {
+            std::cerr << p_path << ": rates must be positive\n";
+            return false;
+        }
+    }
+    for (size_t length : p_spec.batch_lengths) {
+        if (length == 0) {
+            std::cerr << p_path << ": batch_lengths must be positive\n";
+            return false;
+        }
+    }
+    // The capture tells packets apart by source port, flows must not run into the probes'
+    const size_t last_port = p_spec.client_port + p_spec.flows - 1;
+    if (p_spec.flows == 0 || last_port > 65535) {
+        std::cerr << p_path << ": flows must be positive and end at port 65535\n";
+        return false;
+    }
+    for (int id = 0; id <= 2; ++id) {
+        const uint16_t port = PacketBuilder::Defaults::probe_config(id).src_port;
+        if (port >= p_spec.client_port && port <= last_port) {
+            std::cerr << p_path << ": flows from client_port " << p_spec.client_port << " overlap probe port "
+                      << port << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// ########################################################################################
+// # Region: Cells
+// ########################################################################################
+
+// Everything that depends on the payload size only, built once before the grid runs
+struct PayloadSet {
+    std::string payload;
+    uint32_t delta_seq;
+    PacketBuilder::Config spoof_cfg;
+    PacketBuilder::Config non_spoof_cfg;
+    std::unique_ptr<PacketBuilder::PacketTemplate> spoof_tmpl;
+    std::unique_ptr<PacketBuilder::PacketTemplate> non_spoof_tmpl;
+};
+
+// One connection spoofed into, seq extrapolated locally between tracker updates
+struct Flow {
+    uint16_t port;
+    size_t pool_index;
+    uint32_t seq;
+    uint32_t ack;
+};
+
+struct CellResult {
+    size_t sent = 0;
+    size_t errors = 0;
+    double duration_s = 0;
+    Timing::Pacer::Report pacing;
+    std::optional<Analyzer::Totals> order;
+};
+
+// Discard whatever the ring holds, e.g. the tail of the previous cell
+void drain(Capture::Ring* p_ring, Analyzer::Stream* p_stream) {
+    if (!p_ring) return;
+    const auto deadline = std::chrono::steady_clock::now() + drain_time;
+    while (std::chrono::steady_clock::now() < deadline) {
+        p_ring->poll([&](const Capture::Record& r) {
+            if (p_stream) p_stream->add(r);
+        }, std::chrono::milliseconds(10));
+    }
+}
+
+// ########################################################################################
+// # Region: Main
+// ########################################################################################
+
+int main(int argc, char** argv) {
+    Spec spec;
+    const std::string spec_path = argc > 1 ? argv[1] : default_spec_path;
+    if ((argc > 1 || std::ifstream(spec_path).good()) && !load_spec(spec_path, spec)) return 1;
+
+    const auto server_ip = PacketBuilder::parse_ipv4(spec.server_ip);
+    const auto client_ip = PacketBuilder::parse_ipv4(spec.client_ip);
+    const auto attacker_ip = PacketBuilder::parse_ipv4(spec.attacker_ip);
+    if (!server_ip || !client_ip || !attacker_ip) {
+        std::cerr << "Invalid address in sweep spec\n";
+        return 1;
+    }
+
+    // ####################################################################################
+    // # Region: Initialize Client (Optional)
+    // ####################################################################################
+
+    std::optional<Connection::TCPClient> client;
+    std::unique_ptr<Connection::ConnectionPool> pool;
+    uint32_t base_seq = PacketBuilder::Defaults::base_seq;
+    uint32_t base_ack = PacketBuilder::Defaults::base_ack;
+    std::vector<Flow> flows;
+
+    if (spec.connect && spec.flows > 1) {
+        pool = std::make_unique<Connection::ConnectionPool>(spec.client_ip, spec.client_port, spec.flows, spec.iface);
+        if (pool->connect(spec.server_ip, spec.dst_port) == 0) {
+            std::cerr << "Failed to connect any flow to server." << std::endl;
+            return 1;
+        }
+        for (size_t i = 0; i < pool->size(); ++i) {
+            if (!pool->connected(i)) continue;
+            auto [seq, ack] = pool->server_state(i);
+            flows.push_back({ pool->src_port(i), i, seq, ack });
+        }
+        base_seq = flows.front().seq;
+        base_ack = flows.front().ack;
+        if (!pool->start_tracking()) {
+            std::cerr << "Failed to track flow states, extrapolating seq instead." << std::endl;
+        }
+    } else if (spec.connect) {
+        client.emplace(spec.client_ip, spec.client_port, spec.iface);
+        if (!client->extended_connect(spec.server_ip, spec.dst_port)) {
+            std::cerr << "Failed to connect to server." << std::endl;
+            return 1;
+        }
+        std::tie(base_seq, base_ack) = client->server_state();
+        if (!client->start_tracking()) {
+            std::cerr << "Failed to track connection state, extrapolating seq instead." << std::endl;
+        }
+        flows.push_back({ spec.client_port, 0, base_seq, base_ack });
+    } else {
+        for (size_t i = 0; i < spec.flows; ++i) {
+            flows.push_back({ static_cast<uint16_t>(spec.client_port + i), i, base_seq, base_ack });
+        }
+    }
+
+    // ####################################################################################
+    // # Region: Packet Configuration
+    // ####################################################################################
+
+    auto probe_cfg = [&](int p_id) {
+        auto cfg = PacketBuilder::Defaults::probe_config(p_id);
+        cfg.src_ip = *attacker_ip;
+        cfg.dst_ip = *server_ip;
+        cfg.dst_port = spec.dst_port;
+        return cfg;
+    };
+    const auto probe1 = PacketBuilder::build_packet(probe_cfg(1));
+    const auto probe2 = PacketBuilder::build_packet(probe_cfg(2));
+
+    std::vector<PayloadSet> payloads(spec.payload_sizes.size());
+    for (size_t p = 0; p < payloads.size(); ++p) {
+        auto& set = payloads[p];
+        set.payload.assign(spec.payload_sizes[p], 'A');
+
+        set.non_spoof_cfg = probe_cfg(0);
+        set.spoof_cfg = PacketBuilder::Defaults::spoof_config();
+        set.spoof_cfg.src_ip = *client_ip;
+        set.spoof_cfg.src_port = spec.client_port;
+        set.spoof_cfg.dst_ip = *server_ip;
+        set.spoof_cfg.dst_port = spec.dst_port;
+        set.spoof_cfg.seq = set.non_spoof_cfg.seq = base_seq;
+        set.spoof_cfg.ack = set.non_spoof_cfg.ack = base_ack;
+        set.spoof_cfg.payload = set.non_spoof_cfg.payload = set.payload;
+        set.spoof_cfg.psh = set.non_spoof_cfg.psh = !set.payload.empty();
+        set.delta_seq = set.payload.empty() ? 0 : static_cast<uint32_t>(set.payload.size());
+
+        set.spoof_tmpl = std::make_unique<PacketBuilder::PacketTemplate>(set.spoof_cfg);
+        set.non_spoof_tmpl = std::make_unique<PacketBuilder::PacketTemplate>(set.non_spoof_cfg);
+    }
+
+    // ####################################################################################
+    // # Region: Setup Sender and Capture
+    // ####################################################################################
+
+    sockaddr_in dest_addr{};
+    dest_addr.sin_family = AF_INET;
+    dest_addr.sin_port = htons(spec.dst_port);
+    dest_addr.sin_addr.s_addr = server_ip->network();
+
+    auto sender = Sender::create(backend, spec.iface, dest_addr);
+    if (!sender) return 1;
+
+    const size_t max_length = *std::max_element(spec.batch_lengths.begin(), spec.batch_lengths.end());
+    PacketBuilder::BatchSlab batch(max_length + 2);
+    if (!batch.valid()) return 1;
+    batch.set_destination(dest_addr);
+
+    // Our own egress towards the server, order as handed to the wire
+    std::unique_ptr<Capture::Ring> ring;
+    if (spec.capture) {
+        ring = std::make_unique<Capture::Ring>(Capture::RingConfig{
+            .iface = spec.iface,
+            .filter = {
+                .direction = Capture::Filter::Direction::OUTGOING,
+                .dst_ip = server_ip->network(),
+                .dst_port = spec.dst_port
+            },
+            .block_size = 1U << 20,
+            .block_count = 16,
+            .block_timeout_ms = 1
+        });
+        if (!ring->valid()) {
+            std::cerr << "Capture unavailable, order metrics disabled." << std::endl;
+            ring.reset();
+        }
+    }
+
+    std::ofstream out(spec.output);
+    if (!out) {
+        std::cerr << "Failed to open " << spec.output << "\n";
+        return 1;
+    }
+    out << "payload,batch_length,rate,in_connection_ratio,iterations,sent,errors,duration_s,achieved_rate,"
+           "mean_late_ns,max_late_ns,captured,lost,reorder_ratio,max_extent,probe2_overtook\n";
+
+    // ####################################################################################
+    // # Region: Sweep
+    // ####################################################################################
+
+    const size_t cells = payloads.size() * spec.batch_lengths.size() * spec.rates.size() *
+                         spec.in_connection_ratios.size();
+    std::cout << "Sweeping " << cells << " cells of " << spec.iterations << " batches\n";
+
+    // The same connections for the whole sweep, their seqs keep advancing across cells
+    // Same generator as SingleQTrafficGen and PlanRunner, so a seed draws the same scenarios everywhere
+    Plan::Xoshiro256 rng(spec.seed);
+    size_t next_flow = 0;
+    size_t cell = 0;
+
+    for (auto& set : payloads) {
+        for (size_t length : spec.batch_lengths) {
+            for (double rate : spec.rates) {
+                for (double ratio : spec.in_connection_ratios) {
+                    batch.resize(length + 2);
+                    batch.put(0, probe1);
+                    batch.put(length + 1, probe2);
+
+                    std::optional<Analyzer::Stream> analyzer;
+                    if (ring) {
+                        drain(ring.get(), nullptr);
+                        analyzer.emplace(Analyzer::BurstLayout{
+                            .spoof_port = spec.client_port,
+                            .spoof_ports = static_cast<uint16_t>(spec.flows),
+                            .spoofed = length,
+                            .delta_seq = set.delta_seq,
+                            .attacker_seq = set.non_spoof_cfg.seq,
+                            // Bursts must stay separable at high rates
+                            .burst_gap_ns = std::min<uint64_t>(1000000, static_cast<uint64_t>(0.5e9 / rate))
+                        });
+                    }
+
+                    CellResult result;
+                    auto pacer = Timing::Pacer::from_rate(rate);
+                    const auto start = std::chrono::steady_clock::now();
+                    pacer.start();
+
+                    for (size_t i = 0; i < spec.iterations; ++i) {
+                        pacer.wait();
+
+                        const bool in_conn = rng.bernoulli(ratio);
+                        Flow& flow = flows[next_flow];
+                        if (in_conn) {
+                            next_flow = (next_flow + 1) % flows.size();
+                            if (client || pool) {
+                                auto [live_seq, live_ack] = client ? client->server_state()
+                                                                   : pool->server_state(flow.pool_index);
+                                flow.seq = Connection::seq_max(flow.seq, live_seq);
+                                flow.ack = live_ack;
+                            }
+                            if (set.spoof_cfg.src_port != flow.port) {
+                                set.spoof_cfg.src_port = flow.port;
+                                set.spoof_tmpl->set_src_port(flow.port);
+                            }
+                            if (set.spoof_cfg.ack != flow.ack) {
+                                set.spoof_cfg.ack = flow.ack;
+                                set.spoof_tmpl->set_ack(flow.ack);
+                            }
+                        }
+
+                        auto& tmpl = in_conn ? *set.spoof_tmpl : *set.non_spoof_tmpl;
+                        const uint32_t seq = in_conn ? flow.seq : set.non_spoof_cfg.seq;
+                        batch.put_sequence(1, tmpl, seq, set.delta_seq, length);
+
+                        int sent = sender->send(batch);
+                        if (sent < 0) {
+                            result.errors++;
+                        } else {
+                            result.sent += static_cast<size_t>(sent);
+                        }
+                        if (in_conn) flow.seq += set.delta_seq * static_cast<uint32_t>(length);
+
+                        if (analyzer) {
+                            if (sent > 0) analyzer->expect(seq);
+                            ring->poll([&](const Capture::Record& r) { analyzer->add(r); },
+                                       std::chrono::milliseconds(0));
+                        }
+                    }
+
+                    result.duration_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                    result.pacing = pacer.report();
+                    if (analyzer) {
+                        drain(ring.get(), &*analyzer);
+                        analyzer->flush();
+                        result.order = analyzer->totals();
+                    }
+
+                    // ########################################################################
+                    // # Region: Results
+                    // ########################################################################
+
+                    out << set.payload.size() << ',' << length << ',' << rate << ',' << ratio << ','
+                        << spec.iterations << ',' << result.sent << ',' << result.errors << ','
+                        << result.duration_s << ',' << result.pacing.achieved_rate << ','
+                        << result.pacing.mean_late_ns << ',' << result.pacing.max_late_ns << ',';
+                    if (result.order) {
+                        out << result.order->received << ',' << result.order->lost << ','
+                            << result.order->reorder_ratio() << ',' << result.order->max_extent << ','
+                            << result.order->probe2_overtook << '\n';
+                    } else {
+                        out << ",,,,\n";
+                    }
+                    out.flush();
+
+                    std::cout << "Cell " << ++cell << "/" << cells << ": payload=" << set.payload.size()
+                              << ", length=" << length << ", rate=" << rate << ", ratio=" << ratio << ": sent "
+                              << result.sent << " packets, " << result.errors << " errors, achieved "
+                              << result.pacing.achieved_rate << "/s";
+                    if (result.order) std::cout << ", reorder ratio " << result.order->reorder_ratio();
+                    std::cout << std::endl;
+                }
+            }
+        }
+    }
+
+    std::cout << "Wrote " << spec.output << "\n";
+    return 0;
+}
@@ -0,0 +1,352 @@
+/*######################################################################################################
+# Experiment: Testbed
+# Description: Recreate the lab on one machine: a client and a server network namespace joined by a
+#              multi-queue veth pair carrying the addresses and interface name from default.hpp, the
+#              epoll sink on the server side, and the generators run end to end with rx throughput
+######################################################################################################*/
+
+#include "sink.hpp"
+#include "txtime.hpp"
+#include "default.hpp"
+
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// ########################################################################################
+// # Region: Configuration
+// ########################################################################################
+
+// Usage: Testbed                              run every generator, each on a fresh topology
+//        Testbed run <generator> [args...]    same for one generator from the build directory
+//        Testbed up | down                    only create or remove the topology
+//        Testbed sink [iface]                 run the sink in the current namespace until Ctrl-C
+//
+// client namespace: Connection::Defaults::iface with the client and attacker addresses
+// server namespace: server_iface with the server address, the sink on the default port
+const std::string client_ns = "ra_client";
+const std::string server_ns = "ra_server";
+const std::string server_iface = "ra_server0";
+const uint32_t veth_queues = 4;         // rx and tx queues on both ends
+// Capture log of the sink, one per generator: <prefix><generator>.csv, the sink mode alone
+// writes <prefix>log.csv. Empty disables the logs.
+const std::string sink_log_prefix = "sink_";
+const bool keep_topology = false;       // leave the namespaces in place after a run
+// ETF on every tx queue of the client veth, for generators sending with SO_TXTIME launch times
+const bool etf = false;
+const uint64_t etf_delta_ns = 200000;
+const std::vector<std::vector<std::string>> generators = {
+    { "SingleQTrafficGen" },
+    { "MultiQRSSTrafficGen" },
+    { "PlanRunner", "testbed.plan" }
+};
+
+// ########################################################################################
+// # Region: Topology
+// ########################################################################################
+
+bool sh(const std::string& p_command) {
+    if (std::system(p_command.c_str()) != 0) {
+        std::cerr << "Command failed: " << p_command << "\n";
+        return false;
+    }
+    return true;
+}
+
+void topology_down() {
+    std::system(("ip netns del " + client_ns + " 2>/dev/null").c_str());
+    std::system(("ip netns del " + server_ns + " 2>/dev/null").c_str());
+}
+
+bool topology_up() {
+    topology_down();
+
+    const std::string client_iface(Connection::Defaults::iface);
+    const std::string queues = std::to_string(veth_queues);
+    const std::string in_client = "ip -n " + client_ns + " ";
+    const std::string in_server = "ip -n " + server_ns + " ";
+
+    const bool ok =
+        sh("ip netns add " + client_ns) &&
+        sh("ip netns add " + server_ns) &&
+        sh("ip link add " + client_iface + " numtxqueues " + queues + " numrxqueues " + queues + " netns " +
+           client_ns + " type veth peer name " + server_iface + " numtxqueues " + queues + " numrxqueues " +
+           queues + " netns " + server_ns) &&
+        sh(in_client + "addr add " + std::string(Connection::Defaults::client_ip) + "/24 dev " + client_iface) &&
+        sh(in_client + "addr add " + std::string(SingleQAttacker::Defaults::attacker_ip) + "/24 dev " + client_iface) &&
+        sh(in_server + "addr add " + std::string(Connection::Defaults::server_ip) + "/24 dev " + server_iface) &&
+        sh(in_client + "link set lo up") && sh(in_client + "link set " + client_iface + " up") &&
+        sh(in_server + "link set lo up") && sh(in_server + "link set " + server_iface + " up");
+    if (!ok) {
+        topology_down();
+        return false;
+    }
+
+    if (etf) {
+        for (const auto& command : TxTime::etf_commands(client_iface, veth_queues, etf_delta_ns)) {
+            if (!sh("ip netns exec " + client_ns + " " + command)) {
+                topology_down();
+                return false;
+            }
+        }
+    }
+
+    // veth only spreads received packets over its rx queues with NAPI, which GRO enables
+    if (std::system(("ip netns exec " + server_ns + " ethtool -K " + server_iface + " gro on >/dev/null 2>&1").c_str()) != 0) {
+        std::cerr << "ethtool unavailable, " << server_iface << " receives on a single queue.\n";
+    }
+
+    std::cout << "Topology up: " << client_ns << "/" << client_iface << " <-> " << server_ns << "/" << server_iface
+              << ", " << veth_queues << " queues" << (etf ? ", ETF on the client side" : "") << "\n";
+    return true;
+}
+
+// ########################################################################################
+// # Region: Namespaces and Processes
+// ########################################################################################
+
+bool enter_ns(const std::string& p_ns) {
+    int fd = open(("/var/run/netns/" + p_ns).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "No namespace " << p_ns << ": " << strerror(errno) << "\n";
+        return false;
+    }
+    const bool ok = setns(fd, CLONE_NEWNET) == 0;
+    if (!ok) perror("setns");
+    close(fd);
+    return ok;
+}
+
+struct Counters {
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+};
+
+// Receive counters of p_iface inside p_ns, read through /proc/net which follows the thread's namespace
+std::optional<Counters> rx_counters(const std::string& p_ns, const std::string& p_iface) {
+    int home = open("/proc/thread-self/ns/net", O_RDONLY | O_CLOEXEC);
+    if (home < 0 || !enter_ns(p_ns)) {
+        if (home >= 0) close(home);
+        return std::nullopt;
+    }
+
+    // Format: "  iface: rx_bytes rx_packets rx_errs ..."
+    std::optional<Counters> counters;
+    std::ifstream dev("/proc/thread-self/net/dev");
+    std::string line;
+    while (std::getline(dev, line)) {
+        const size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        std::istringstream name(line.substr(0, colon));
+        std::string iface;
+        name >> iface;
+        if (iface != p_iface) continue;
+
+        std::istringstream fields(line.substr(colon + 1));
+        Counters c;
+        fields >> c.bytes >> c.packets;
+        counters = c;
+        break;
+    }
+
+    if (setns(home, CLONE_NEWNET) < 0) perror("setns(home)");
+    close(home);
+    return counters;
+}
+
+std::string binary_dir() {
+    char path[4096];
+    const ssize_t n = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (n <= 0) return ".";
+    std::string exe(path, static_cast<size_t>(n));
+    return exe.substr(0, exe.find_last_of('/'));
+}
+
+// Run p_args (binary from the build directory) inside p_ns, returns its exit status or -1
+int run_in_ns(const std::string& p_ns, const std::vector<std::string>& p_args) {
+    const std::string path = binary_dir() + "/" + p_args[0];
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        if (!enter_ns(p_ns)) _exit(127);
+        std::vector<char*> argv;
+        for (const auto& arg : p_args) argv.push_back(const_cast<char*>(arg.c_str()));
+        argv.push_back(nullptr);
+        execv(path.c_str(), argv.data());
+        std::cerr << "Cannot run " << path << ": " << strerror(errno) << "\n";
+        _exit(127);
+    }
+
+    int status = 0;
+    if (waitpid(pid, &status, 0) < 0) return -1;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+// ########################################################################################
+// # Region: Sink
+// ########################################################################################
+
+Sink::Server* sink_instance = nullptr;
+
+void on_stop_signal(int) {
+    if (sink_instance) sink_instance->stop();
+}
+
+int run_sink(const std::string& p_iface, const std::string& p_log_path, int p_ready_fd) {
+    Sink::Server server(Sink::Config{
+        .port = Connection::Defaults::dst_port,
+        .iface = p_iface,
+        .log_path = p_log_path
+    });
+    if (!server.valid()) return 1;
+
+    sink_instance = &server;
+    signal(SIGTERM, on_stop_signal);
+    signal(SIGINT, on_stop_signal);
+    if (p_ready_fd >= 0) {
+        const char ready = 1;
+        if (write(p_ready_fd, &ready, 1) != 1) perror("write(ready)");
+        close(p_ready_fd);
+    }
+
+    server.run();
+    std::cout << server.stats();
+    if (!p_log_path.empty()) std::cout << Sink::LOG_TAG << " Wrote " << p_log_path << "\n";
+    return 0;
+}
+
+// Sink in the server namespace as a child process, pid once it listens or -1
+pid_t start_sink(const std::string& p_log_path) {
+    int ready[2];
+    if (pipe(ready) < 0) {
+        perror("pipe");
+        return -1;
+    }
+
+    // Anything still buffered would be printed twice once the child flushes
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        close(ready[0]);
+        if (!enter_ns(server_ns)) _exit(1);
+        const int status = run_sink(server_iface, p_log_path, ready[1]);
+        std::cout.flush();
+        _exit(status);
+    }
+
+    close(ready[1]);
+    char byte = 0;
+    const bool listening = read(ready[0], &byte, 1) == 1;
+    close(ready[0]);
+    if (!listening) {
+        waitpid(pid, nullptr, 0);
+        return -1;
+    }
+    return pid;
+}
+
+// ########################################################################################
+// # Region: Experiments
+// ########################################################################################
+
+struct Result {
+    std::string name;
+    int status;
+    double seconds;
+    Counters rx;
+};
+
+// Each generator gets new namespaces and a new sink: a client port left in TIME_WAIT by the
+// previous run cannot connect again, and counters and log start from zero
+std::optional<Result> run_generator(const std::vector<std::string>& p_args) {
+    if (!topology_up()) return std::nullopt;
+    pid_t sink = start_sink(sink_log_prefix.empty() ? "" : sink_log_prefix + p_args[0] + ".csv");
+    if (sink < 0) {
+        std::cerr << "Sink failed to start.\n";
+        topology_down();
+        return std::nullopt;
+    }
+
+    std::cout << "##### " << p_args[0] << "\n" << std::flush;
+    const auto before = rx_counters(server_ns, server_iface).value_or(Counters{});
+    const auto start = std::chrono::steady_clock::now();
+    const int status = run_in_ns(client_ns, p_args);
+    const auto end = std::chrono::steady_clock::now();
+    const auto after = rx_counters(server_ns, server_iface).value_or(Counters{});
+
+    kill(sink, SIGTERM);
+    waitpid(sink, nullptr, 0);
+    if (!keep_topology) topology_down();
+
+    return Result{ p_args[0], status, std::chrono::duration<double>(end - start).count(),
+                   { after.packets - before.packets, after.bytes - before.bytes } };
+}
+
+bool run_generators(const std::vector<std::vector<std::string>>& p_generators) {
+    std::vector<Result> results;
+    for (const auto& args : p_generators) {
+        auto result = run_generator(args);
+        if (!result) return false;
+        results.push_back(*result);
+    }
+
+    std::cout << "\n" << std::left << std::setw(24) << "generator" << std::right << std::setw(8) << "status"
+              << std::setw(10) << "seconds" << std::setw(12) << "rx packets" << std::setw(14) << "rx bytes"
+              << std::setw(12) << "kpps" << std::setw(10) << "Mbit/s" << "\n";
+    bool ok = true;
+    for (const auto& r : results) {
+        const double seconds = r.seconds > 0 ? r.seconds : 1;
+        std::cout << std::left << std::setw(24) << r.name << std::right << std::setw(8) << r.status
+                  << std::fixed << std::setprecision(2) << std::setw(10) << r.seconds << std::setw(12)
+                  << r.rx.packets << std::setw(14) << r.rx.bytes << std::setw(12)
+                  << static_cast<double>(r.rx.packets) / seconds / 1e3 << std::setw(10)
+                  << static_cast<double>(r.rx.bytes) * 8 / seconds / 1e6 << "\n";
+        ok = ok && r.status == 0;
+    }
+    return ok;
+}
+
+// ########################################################################################
+// # Region: Main
+// ########################################################################################
+
+int main(int argc, char** argv) {
+    const std::string mode = argc > 1 ? argv[1] : "";
+
+    if (mode == "up") return topology_up() ? 0 : 1;
+    if (mode == "down") {
+        topology_down();
+        return 0;
+    }
+    if (mode == "sink") {
+        return run_sink(argc > 2 ? argv[2] : "", sink_log_prefix.empty() ? "" : sink_log_prefix + "log.csv", -1);
+    }
+    if (mode == "run" && argc > 2) {
+        return run_generators({ std::vector<std::string>(argv + 2, argv + argc) }) ? 0 : 1;
+    }
+    if (!mode.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [run <generator> [args...] | up | down | sink [iface]]\n";
+        return 1;
+    }
+    return run_generators(generators) ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+#include "tests.hpp"
+#include "analyzer.hpp"
+
+#include <initializer_list>
+#include <optional>
+#include <string>
+
+namespace Tests {
+
+    namespace {
+        constexpr Analyzer::BurstLayout layout{ .spoofed = 4, .delta_seq = 3 };
+
+        Capture::Record record(uint16_t p_port, uint32_t p_seq, uint64_t p_timestamp_ns) {
+            Capture::Record r{};
+            r.src_port = p_port;
+            r.seq = p_seq;
+            r.timestamp_ns = p_timestamp_ns;
+            return r;
+        }
+
+        // probe1, the spoofed slots listed (seq first_seq + slot * delta_seq), probe2
+        std::optional<Analyzer::BurstResult> burst(Analyzer::Stream& p_stream, uint32_t p_first_seq,
+                                                   std::initializer_list<size_t> p_slots, uint64_t p_start_ns) {
+            uint64_t ts = p_start_ns;
+            p_stream.add(record(layout.probe1_port, 0, ts++));
+            for (size_t slot : p_slots) {
+                p_stream.add(record(layout.spoof_port, p_first_seq + static_cast<uint32_t>(slot) * layout.delta_seq, ts++));
+            }
+            p_stream.add(record(layout.probe2_port, 0, ts++));
+            return p_stream.flush();
+        }
+
+        bool expect_result(const std::optional<Analyzer::BurstResult>& p_result, size_t p_received, size_t p_lost,
+                           size_t p_reordered, const std::string& p_what) {
+            return check(p_result.has_value(), p_what + ", burst closed") &&
+                   check(p_result->received == p_received, p_what + ", received " + std::to_string(p_result->received)) &&
+                   check(p_result->lost == p_lost, p_what + ", lost " + std::to_string(p_result->lost)) &&
+                   check(p_result->reordered == p_reordered, p_what + ", reordered " + std::to_string(p_result->reordered));
+        }
+    }
+
+    bool analyzer() {
+        const uint64_t gap = 10 * layout.burst_gap_ns;
+
+        // A client segment below the burst's seqs must not become the base
+        {
+            Analyzer::Stream stream(layout);
+            stream.expect(5000);
+            stream.add(record(layout.probe1_port, 0, 1));
+            stream.add(record(layout.spoof_port, 5000 - 100, 2));
+            for (uint32_t slot = 0; slot < layout.spoofed; slot++) {
+                stream.add(record(layout.spoof_port, 5000 + slot * layout.delta_seq, 3 + slot));
+            }
+            stream.add(record(layout.probe2_port, 0, 10));
+            if (!expect_result(stream.flush(), layout.size(), 0, 0, "stray client segment")) return false;
+            if (!check(stream.totals().unmatched == 1, "stray client segment, unmatched")) return false;
+        }
+
+        // First spoofed packet lost, the others still map onto their own slots
+        {
+            Analyzer::Stream stream(layout);
+            stream.expect(7000);
+            if (!expect_result(burst(stream, 7000, { 2, 1, 3 }, gap), layout.size() - 1, 1, 1, "first spoofed lost")) return false;
+            if (!check(stream.totals().unmatched == 0, "first spoofed lost, unmatched")) return false;
+        }
+
+        // A burst that never arrived leaves its hint behind, the next one skips over it
+        {
+            Analyzer::Stream stream(layout);
+            stream.expect(1000);
+            stream.expect(2000);
+            stream.expect(3000);
+            if (!expect_result(burst(stream, 2000, { 1, 2, 3 }, gap), layout.size() - 1, 1, 0, "lost burst skipped")) return false;
+            if (!expect_result(burst(stream, 3000, { 0, 1, 2, 3 }, 2 * gap), layout.size(), 0, 0, "after lost burst")) return false;
+            if (!check(stream.totals().unmatched == 0, "lost burst skipped, unmatched")) return false;
+        }
+
+        // Wrap-around between slots
+        {
+            Analyzer::Stream stream(layout);
+            const uint32_t first = UINT32_MAX - 4;
+            stream.expect(first);
+            if (!expect_result(burst(stream, first, { 3, 1, 2 }, gap), layout.size() - 1, 1, 2, "seq wrap")) return false;
+            if (!check(stream.totals().unmatched == 0, "seq wrap, unmatched")) return false;
+        }
+
+        // Out-of-connection bursts without hints start at the attacker seq
+        {
+            Analyzer::BurstLayout known = layout;
+            known.attacker_seq = 9000;
+            Analyzer::Stream stream(known);
+            stream.add(record(known.probe1_port, 0, 1));
+            stream.add(record(known.attacker_port, 9000 - 100, 2));
+            stream.add(record(known.attacker_port, 9000 + known.delta_seq, 3));
+            stream.add(record(known.probe2_port, 0, 4));
+            if (!expect_result(stream.flush(), 3, known.spoofed - 1, 0, "known attacker seq")) return false;
+            if (!check(stream.totals().unmatched == 1, "known attacker seq, unmatched")) return false;
+        }
+
+        return true;
+    }
+
+} // namespace Tests
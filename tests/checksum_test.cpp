@@ -0,0 +1,80 @@
+#include "tests.hpp"
+#include "checksum.hpp"
+#include "packetlayout.hpp"
+
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace Tests {
+
+    namespace {
+        constexpr Checksum::Kernel kernels[] = {
+            Checksum::Kernel::SCALAR, Checksum::Kernel::SSE2, Checksum::Kernel::AVX2
+        };
+
+        uint16_t reference(std::span<const char> p_data, uint32_t p_initial = 0) {
+            return PacketBuilder::checksum_fold(PacketBuilder::checksum_partial(p_data, p_initial));
+        }
+
+        // Every supported kernel, and the dispatching entry point, against the constexpr reference
+        bool matches(std::span<const char> p_data, uint32_t p_initial, std::string_view p_what) {
+            const uint16_t expected = reference(p_data, p_initial);
+            for (auto kernel : kernels) {
+                if (!Checksum::supported(kernel)) continue;
+                const uint16_t got = Checksum::finish(Checksum::partial(kernel, p_data.data(), p_data.size(), p_initial));
+                if (!check(got == expected, std::string(p_what) + ", " + std::string(Checksum::name(kernel)) + ", " +
+                                            std::to_string(p_data.size()) + " bytes")) {
+                    return false;
+                }
+            }
+            return check(Checksum::compute(p_data.data(), p_data.size(), p_initial) == expected,
+                         std::string(p_what) + ", compute");
+        }
+    }
+
+    bool checksum() {
+        std::mt19937_64 rng(1);
+        std::vector<char> buffer(9000 + 64);
+        for (auto& c : buffer) c = static_cast<char>(rng());
+
+        // Random lengths at unaligned offsets, with and without a carried-in sum
+        for (int i = 0; i < 20000; i++) {
+            const size_t offset = rng() % 64;
+            const size_t len = i < 256 ? static_cast<size_t>(i) : rng() % 9000;
+            const uint32_t initial = rng() & 1 ? static_cast<uint32_t>(rng() % 0x40000) : 0;
+            if (!matches({ buffer.data() + offset, len }, initial, "random")) return false;
+        }
+
+        // Saturated and empty words: the folds and carries at the extremes
+        for (char fill : { static_cast<char>(0xFF), static_cast<char>(0x00) }) {
+            std::vector<char> flat(9000 + 64, fill);
+            for (size_t len : { 0, 1, 2, 3, 15, 16, 17, 31, 32, 33, 63, 64, 65, 1500, 1501, 9000 }) {
+                for (size_t offset : { 0, 1, 3, 7 }) {
+                    if (!matches({ flat.data() + offset, len }, 0, fill ? "all 0xFF" : "all zero")) return false;
+                }
+            }
+        }
+
+        // Even-length pieces chained through p_initial sum to the whole buffer
+        for (int i = 0; i < 2000; i++) {
+            const size_t offset = rng() % 64;
+            const size_t len = rng() % 4000;
+            const size_t split = (rng() % (len + 1)) & ~size_t(1);
+            const char* data = buffer.data() + offset;
+            const uint16_t whole = reference({ data, len });
+            for (auto kernel : kernels) {
+                if (!Checksum::supported(kernel)) continue;
+                const uint32_t head = Checksum::partial(kernel, data, split);
+                const uint32_t sum = Checksum::partial(kernel, data + split, len - split, head);
+                if (!check(Checksum::finish(sum) == whole, std::string("split partial sums, ") +
+                           std::string(Checksum::name(kernel)))) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+} // namespace Tests
@@ -0,0 +1,21 @@
+#include "tests.hpp"
+
+#include <iostream>
+#include <string_view>
+#include <utility>
+
+int main() {
+    const std::pair<std::string_view, bool (*)()> suites[] = {
+        { "packet_template", Tests::packet_template },
+        { "checksum", Tests::checksum },
+        { "analyzer", Tests::analyzer },
+    };
+
+    int failed = 0;
+    for (const auto& [name, run] : suites) {
+        const bool ok = run();
+        std::cout << Tests::LOG_TAG << " " << name << ": " << (ok ? "ok" : "FAILED") << "\n";
+        failed += ok ? 0 : 1;
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,176 @@
+#include "tests.hpp"
+#include "packetbuilder.hpp"
+#include "checksum.hpp"
+
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <netinet/ip.h>
+
+namespace Tests {
+
+    namespace {
+        using PacketBuilder::Config;
+        using PacketBuilder::PacketTemplate;
+
+        const PacketBuilder::MacAddress src_mac = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+        const PacketBuilder::MacAddress dst_mac = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 };
+
+        // build_packet always writes IP id 0, so the reference for set_ip_id patches it in
+        // and recomputes the header checksum from scratch
+        std::vector<char> with_ip_id(std::vector<char> p_packet, size_t p_l3_offset, uint16_t p_id) {
+            auto* iph = reinterpret_cast<iphdr*>(p_packet.data() + p_l3_offset);
+            iph->id = htons(p_id);
+            iph->check = 0;
+            iph->check = htons(Checksum::compute(iph, sizeof(iphdr)));
+            return p_packet;
+        }
+
+        Config random_config(std::mt19937_64& p_rng, const std::string& p_payload) {
+            Config cfg{};
+            cfg.src_ip = { static_cast<uint32_t>(p_rng()) };
+            cfg.dst_ip = { static_cast<uint32_t>(p_rng()) };
+            cfg.src_port = static_cast<uint16_t>(p_rng());
+            cfg.dst_port = static_cast<uint16_t>(p_rng());
+            cfg.seq = static_cast<uint32_t>(p_rng());
+            cfg.ack = static_cast<uint32_t>(p_rng());
+            cfg.window = static_cast<uint16_t>(p_rng());
+            cfg.ack_flag = p_rng() & 1;
+            cfg.psh = p_rng() & 1;
+            cfg.payload = p_payload;
+            return cfg;
+        }
+
+        // Apply one random setter to both the template and the config, then compare against a
+        // fresh build. Plain IP packets when p_framed is false, Ethernet frames otherwise.
+        bool random_walk(std::mt19937_64& p_rng, bool p_framed) {
+            const std::string payload(p_rng() % 64, 'p');
+            Config cfg = random_config(p_rng, payload);
+            PacketTemplate tmpl = p_framed ? PacketTemplate(cfg, src_mac, dst_mac) : PacketTemplate(cfg);
+            const size_t l3_offset = p_framed ? 14 : 0;
+            uint16_t ip_id = 0;
+
+            auto reference = [&] {
+                auto packet = p_framed ? PacketBuilder::build_frame(cfg, src_mac, dst_mac)
+                                       : PacketBuilder::build_packet(cfg);
+                return ip_id ? with_ip_id(std::move(packet), l3_offset, ip_id) : packet;
+            };
+            if (!check(tmpl.valid() && tmpl.packet() == reference(), "template equals build after construction")) {
+                return false;
+            }
+
+            for (int step = 0; step < 200; step++) {
+                const char* what = "";
+                switch (p_rng() % 7) {
+                    case 0:
+                        // Near the top of the sequence space half the time, so seq wraps
+                        cfg.seq = p_rng() & 1 ? 0xFFFFFFFFU - static_cast<uint32_t>(p_rng() % 4)
+                                              : static_cast<uint32_t>(p_rng());
+                        tmpl.set_seq(cfg.seq);
+                        what = "set_seq";
+                        break;
+                    case 1:
+                        cfg.ack = static_cast<uint32_t>(p_rng());
+                        tmpl.set_ack(cfg.ack);
+                        what = "set_ack";
+                        break;
+                    case 2:
+                        cfg.src_port = static_cast<uint16_t>(p_rng());
+                        tmpl.set_src_port(cfg.src_port);
+                        what = "set_src_port";
+                        break;
+                    case 3:
+                        cfg.dst_port = static_cast<uint16_t>(p_rng());
+                        tmpl.set_dst_port(cfg.dst_port);
+                        what = "set_dst_port";
+                        break;
+                    case 4:
+                        cfg.syn = p_rng() & 1;
+                        cfg.ack_flag = p_rng() & 1;
+                        cfg.rst = p_rng() & 1;
+                        cfg.psh = p_rng() & 1;
+                        tmpl.set_flags(cfg.syn, cfg.ack_flag, cfg.rst, cfg.psh);
+                        what = "set_flags";
+                        break;
+                    case 5:
+                        cfg.window = static_cast<uint16_t>(p_rng());
+                        tmpl.set_window(cfg.window);
+                        what = "set_window";
+                        break;
+                    case 6:
+                        // 0 half the time: setting it back must restore the build_packet bytes
+                        ip_id = p_rng() & 1 ? static_cast<uint16_t>(p_rng()) : 0;
+                        tmpl.set_ip_id(ip_id);
+                        what = "set_ip_id";
+                        break;
+                }
+                if (!check(tmpl.packet() == reference(), std::string(what) + (p_framed ? " (framed)" : ""))) {
+                    return false;
+                }
+                if (!check(tmpl.seq() == cfg.seq, "seq() reads back the patched seq")) return false;
+
+                std::vector<char> rendered(tmpl.size());
+                if (!check(tmpl.render(rendered.data()) == tmpl.size() && rendered == tmpl.packet(),
+                           "render() copies the packet")) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool batch(std::mt19937_64& p_rng) {
+            const std::string payload(1 + p_rng() % 100, 'b');
+            Config cfg = random_config(p_rng, payload);
+            // Start a few segments below the top half the time, so the batch wraps
+            if (p_rng() & 1) cfg.seq = 0xFFFFFFFFU - static_cast<uint32_t>(payload.size() * 3);
+
+            const size_t count = 1 + p_rng() % 16;
+            const auto packets = PacketBuilder::build_packet_batch(cfg, count);
+            if (!check(packets.size() == count, "build_packet_batch count")) return false;
+
+            Config expected = cfg;
+            for (size_t i = 0; i < count; i++) {
+                expected.seq = cfg.seq + static_cast<uint32_t>(i * payload.size());
+                if (!check(packets[i] == PacketBuilder::build_packet(expected), "build_packet_batch packet")) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    bool packet_template() {
+        std::mt19937_64 rng(1);
+        for (int round = 0; round < 200; round++) {
+            if (!random_walk(rng, false) || !random_walk(rng, true) || !batch(rng)) return false;
+        }
+
+        // Config owns its payload: a temporary assigned to it must outlive the temporary
+        Config cfg = random_config(rng, "");
+        cfg.payload = std::string(40, 'o');
+        const auto packet = PacketBuilder::build_packet(cfg);
+        if (!check(packet.size() == 80 && std::string(packet.end() - 40, packet.end()) == std::string(40, 'o'),
+                   "payload assigned from a temporary")) {
+            return false;
+        }
+
+        // The compile-time layout matches the runtime builder, payload included
+        constexpr auto fields = PacketBuilder::Fields{ PacketBuilder::ipv4("10.0.0.1"), PacketBuilder::ipv4("10.0.0.2"),
+                                                       1234, 80, 0xFFFFFFF0U, 42, 512 };
+        PacketBuilder::StaticPacket<PacketBuilder::TcpFlags::ACK | PacketBuilder::TcpFlags::PSH, 3> fixed(fields, "ABC");
+        Config fixed_cfg{ fields.src_ip, fields.dst_ip, fields.src_port, fields.dst_port, fields.seq, fields.ack,
+                          false, true, false, true, fields.window, "ABC" };
+        for (uint32_t seq : { 0xFFFFFFF0U, 0xFFFFFFFFU, 7U }) {
+            fixed.set_seq(seq);
+            fixed_cfg.seq = seq;
+            const auto view = fixed.view();
+            if (!check(std::vector<char>(view.begin(), view.end()) == PacketBuilder::build_packet(fixed_cfg),
+                       "StaticPacket equals build_packet")) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+} // namespace Tests
@@ -0,0 +1,25 @@
+/*######################################################################################################
+# Experiment: General
+# Description: Self-contained unit tests, run by ctest through the UnitTests target
+# #####################################################################################################*/
+
+#pragma once
+
+#include <iostream>
+#include <string_view>
+
+namespace Tests {
+    inline constexpr std::string_view LOG_TAG = "[Tests]";
+
+    // Report a failed expectation, returns p_ok so callers can bail out on the first failure
+    inline bool check(bool p_ok, std::string_view p_what) {
+        if (!p_ok) std::cerr << LOG_TAG << " FAILED: " << p_what << "\n";
+        return p_ok;
+    }
+
+    // One function per test file, true when every check passed
+    bool packet_template();
+    bool checksum();
+    bool analyzer();
+
+} // namespace Tests